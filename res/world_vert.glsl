@@ -3,12 +3,17 @@
 layout(location = 0) in vec2 position;
 
 uniform usamplerBuffer world_texture_buffer;
+uniform usamplerBuffer decay_texture_buffer;
 uniform vec4 colors[5];
 uniform mat4 MVP;
 uniform uint inv_state;
+uniform int decay_planes;
+uniform int decay_stride;
+uniform uint dying_states;
 out vec4 vert_color;
 int cell_id, shift, data_offset;
 int cell_val;
+uint age;
 
 void main()
 {
@@ -19,4 +24,14 @@ void main()
     cell_val = int(texelFetch(world_texture_buffer, data_offset).r);
     cell_val = (cell_val >> (shift*2)) & (3 << inv_state) & 3;
     vert_color = colors[cell_val << inv_state];
+
+    // Dying cells of Generations rules fade from the dying colour to dead
+    // as they age
+    age = 0u;
+    for (int p = 0; p < decay_planes; ++p) {
+        age |= ((texelFetch(decay_texture_buffer, p * decay_stride + data_offset).r >> (shift*2)) & 1u) << p;
+    }
+    if (cell_val == 0 && age > 0u) {
+        vert_color = mix(colors[2], colors[0], float(age - 1u) / float(dying_states));
+    }
 }
@@ -48,10 +48,11 @@ void _b64seg_enc(const char *seg, char *b64seg, size_t to_end) {
 }
 
 /*
- * Decode a segment of 4 Base64-encoded chars into a segment of 3 chars
+ * Decode a segment of 4 Base64-encoded chars into a segment of up to 3
+ * chars, to_end being room left for them
  * returns -1 if a segment could not be decoded
  */
-int _b64seg_dec(const char *b64, char *plain_seg) {
+int _b64seg_dec(const char *b64, char *plain_seg, size_t to_end) {
     uint32_t seg_temp = 0;
     uint32_t seg_mask = 0xff; // 8 bits
     int char_ind;
@@ -68,7 +69,7 @@ int _b64seg_dec(const char *b64, char *plain_seg) {
         seg_temp = (seg_temp << 6) | ((uint8_t) char_ind & 0x3f);
     }
 
-    for (int i = SEG_IN_LEN-1, j=0; i >= 0; i--, j++) {
+    for (int i = SEG_IN_LEN-1, j=0; i >= 0 && (size_t) j < to_end; i--, j++) {
         plain_seg[j] = (seg_temp >> 8*i) & seg_mask;
     }
     return 0;
@@ -107,13 +108,13 @@ char *b64_enc(const char *bytes, size_t in_len, size_t *out_len) {
  *          fails
  */
 char *b64_dec(const char *b64_bytes, size_t in_len, size_t *out_len) {
-    if (in_len % 4 != 0) {
+    if (in_len % 4 != 0 || in_len == 0) {
         if (out_len != NULL) {
             *out_len = 0;
         }
         return NULL;
     }
-    size_t plain_len = (size_t) (in_len / 4.0 + .75) * 3;
+    size_t plain_len = in_len / 4 * 3;
     for (size_t i = in_len - 1; i >= in_len - 2; i--) {
         if (b64_bytes[i] == '=') {
             plain_len--;
@@ -124,11 +125,12 @@ char *b64_dec(const char *b64_bytes, size_t in_len, size_t *out_len) {
     int dec_error;
 
     for (size_t i = 0, j = 0; j < plain_len; i+=4, j+=3) {
-        dec_error = _b64seg_dec(&b64_bytes[i], &plain[j]);
+        dec_error = _b64seg_dec(&b64_bytes[i], &plain[j], plain_len - j);
         if (dec_error != 0) {
             if (out_len != NULL) {
                 *out_len = 0;
             }
+            free(plain);
             return NULL;
         }
     }
@@ -0,0 +1,330 @@
+#include <string.h>
+#ifdef _MSC_VER
+#include <malloc.h>
+#endif
+#include "batch.h"
+#include "bitwise.h"
+#include "cycle.h"
+#include "pool.h"
+
+/*
+ * Batches of small worlds
+ *
+ * A small world stepped on its own costs more in calls, allocation and
+ * thread wakeups than in calculation. A batch keeps all of its worlds as
+ * packed board rows in one aligned allocation, and one batch_step runs
+ * each thread over its share of them, every bands-th world so the ones
+ * that end early are spread out, each world for all the generations
+ * while it is in cache.
+ *
+ * Every generation of a world is hashed, and periods up to BATCH_HISTORY
+ * are found and confirmed like in cycle.c. A world with no live cells
+ * whose rule can't give birth from nothing is extinct. Worlds that ended
+ * aren't stepped again until they are cleared or loaded.
+ */
+
+static inline board_word *_buffer(world_batch *b, size_t k, uint32_t generation) {
+    return b->cells + k * b->world_words + (generation & 1) * b->buffer_words;
+}
+
+/*
+ * The worlds' buffers, aligned so that each starts on a cache line
+ */
+static board_word *_alloc_cells(size_t size) {
+#ifdef _MSC_VER
+    return _aligned_malloc(size, BATCH_ALIGN);
+#else
+    return aligned_alloc(BATCH_ALIGN, size);
+#endif
+}
+
+static void _free_cells(board_word *cells) {
+#ifdef _MSC_VER
+    _aligned_free(cells);
+#else
+    free(cells);
+#endif
+}
+
+static inline unsigned int _popcount(board_word v) {
+    v = v - ((v >> 1) & 0x5555555555555555ull);
+    v = (v & 0x3333333333333333ull) + ((v >> 2) & 0x3333333333333333ull);
+    v = (v + (v >> 4)) & 0x0f0f0f0f0f0f0f0full;
+    return (v * 0x0101010101010101ull) >> 56;
+}
+
+static uint64_t _population(world_batch *b, const board_word *cells) {
+    board_word tail = b->xlim % BOARD_BITS ? ((board_word) 1 << (b->xlim % BOARD_BITS)) - 1 : ~(board_word) 0;
+    uint64_t population = 0;
+
+    // The cells past the end of a row can be ghost cells
+    for (size_t y = 1; y <= b->ylim; ++y) {
+        const board_word *row = cells + y * b->stride;
+        for (size_t i = 1; i < b->words; ++i) {
+            population += _popcount(row[i]);
+        }
+        population += _popcount(row[b->words] & tail);
+    }
+    return population;
+}
+
+world_batch *init_batch(size_t count, uint32_t xlim, uint32_t ylim, world_topology topology,
+        const life_rule *rule, unsigned int threads) {
+    size_t align = BATCH_ALIGN / sizeof(board_word);
+    world_batch *b;
+
+    // Only rules the bitwise kernels step by themselves
+    if (count == 0 || xlim == 0 || ylim == 0 || rule->range > 1 || rule->states > 2) {
+        return NULL;
+    }
+
+    b = calloc(1, sizeof(world_batch));
+    if (b == NULL) {
+        return NULL;
+    }
+    b->count = count;
+    b->xlim = xlim;
+    b->ylim = ylim;
+    b->topology = topology;
+    b->rule = *rule;
+
+    b->words = (xlim + BOARD_BITS - 1) / BOARD_BITS;
+    b->stride = b->words + 2;
+    b->buffer_words = ((size_t) ylim + 2) * b->stride;
+    b->world_words = (2 * b->buffer_words + align - 1) / align * align;
+    if (count > SIZE_MAX / sizeof(board_word) / b->world_words ||
+            count > SIZE_MAX / sizeof(batch_history)) {
+        free(b);
+        return NULL;
+    }
+    b->cells = _alloc_cells(count * b->world_words * sizeof(board_word));
+    b->results = malloc(count * sizeof(batch_result));
+    b->history = malloc(count * sizeof(batch_history));
+
+    b->bands = threads > 0 ? threads : 1;
+    if (b->bands > count) {
+        b->bands = count;
+    }
+    b->sums = malloc(b->bands * BOARD_SLOTS * 2 * b->words * sizeof(board_word));
+    b->running = calloc(b->bands, sizeof(size_t));
+
+    if (b->cells == NULL || b->results == NULL || b->history == NULL ||
+            b->sums == NULL || b->running == NULL) {
+        destroy_batch(b);
+        return NULL;
+    }
+
+    for (size_t k = 0; k < count; ++k) {
+        batch_clear(b, k);
+    }
+
+    // Pick the SIMD kernel before any worker needs it
+    get_kernel();
+    b->pool = b->bands > 1 ? init_pool(b->bands) : NULL;
+
+    return b;
+}
+
+void destroy_batch(world_batch *b) {
+    if (b->pool != NULL) {
+        destroy_pool(b->pool);
+    }
+    _free_cells(b->cells);
+    free(b->results);
+    free(b->history);
+    free(b->sums);
+    free(b->running);
+    free(b);
+}
+
+/*
+ * Kill every cell of a world and start it again from generation 0
+ */
+void batch_clear(world_batch *b, size_t k) {
+    memset(b->cells + k * b->world_words, 0, b->world_words * sizeof(board_word));
+    memset(&b->results[k], 0, sizeof(batch_result));
+}
+
+int batch_cell(world_batch *b, size_t k, uint32_t x, uint32_t y) {
+    const board_word *row = _buffer(b, k, b->results[k].generation) + (y + 1) * b->stride;
+    return (row[x / BOARD_BITS + 1] >> (x % BOARD_BITS)) & 1;
+}
+
+/*
+ * Set a cell of a world that was just cleared
+ */
+void batch_set_cell(world_batch *b, size_t k, uint32_t x, uint32_t y, int alive) {
+    board_word *row = _buffer(b, k, b->results[k].generation) + (y + 1) * b->stride;
+    board_word bit = (board_word) 1 << (x % BOARD_BITS);
+    int was = batch_cell(b, k, x, y);
+
+    row[x / BOARD_BITS + 1] = alive ? row[x / BOARD_BITS + 1] | bit : row[x / BOARD_BITS + 1] & ~bit;
+    b->results[k].population += (alive != 0) - was;
+    bitwise_guard_rows(b->xlim, b->topology, row, 1);
+}
+
+/*
+ * Copy the current states of a world the size of the batch into world
+ * k, which is then stepped by the batch's rule and topology. Returns 0
+ * if the sizes differ.
+ */
+int batch_load(world_batch *b, size_t k, world *w) {
+    if (w->xlim != b->xlim || w->ylim != b->ylim) {
+        return 0;
+    }
+    batch_clear(b, k);
+    for (uint32_t y = 0; y < w->ylim; ++y) {
+        for (uint32_t x = 0; x < w->xlim; ++x) {
+            size_t c = (size_t) y * w->xlim + x;
+            if ((w->data[c >> IDX_DIV] >> ((c & OFFSET_MASK) * BITS_PER_CELL + 1)) & 1) {
+                batch_set_cell(b, k, x, y, 1);
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * Copy world k into a world the size of the batch, as its current and
+ * next states, at the generation the batch world has reached. Returns 0
+ * if the sizes differ.
+ */
+int batch_store(world_batch *b, size_t k, world *w) {
+    if (w->xlim != b->xlim || w->ylim != b->ylim) {
+        return 0;
+    }
+    for (size_t i = 0; i < w->data_size; ++i) {
+        world_store v = 0;
+        for (size_t j = 0; j < CELLS_PER_ELEM && (i << IDX_DIV) + j < w->cell_count; ++j) {
+            size_t c = (i << IDX_DIV) + j;
+            if (batch_cell(b, k, c % w->xlim, c / w->xlim)) {
+                v |= (world_store) SINGLE_CELL_MASK << (j * BITS_PER_CELL);
+            }
+        }
+        w->data[i] = v;
+    }
+    w->generation = b->results[k].generation;
+    w->state = CALC;
+    world_clear_dying(w);
+    world_invalidate(w);
+    return 1;
+}
+
+/*
+ * Hash a world at its current generation, and end it if it repeats
+ */
+static void _record(world_batch *b, size_t k, batch_result *r, const board_word *cells) {
+    batch_history *h = &b->history[k];
+    uint64_t hash = 0;
+
+    // Guard words only hold copies
+    for (size_t y = 1; y <= b->ylim; ++y) {
+        for (size_t i = y * b->stride + 1; i <= y * b->stride + b->words; ++i) {
+            hash ^= cycle_hash(i, cells[i]);
+        }
+    }
+
+    if (hash == 0 && !(b->rule.birth & 1) && _population(b, cells) == 0) {
+        r->flags |= BATCH_EXTINCT;
+        r->period = 1;
+        r->first = r->generation;
+    }
+    if (r->candidate && !r->flags) {
+        if (h->hash[(r->generation - r->candidate) % BATCH_HISTORY] != hash) {
+            r->candidate = 0;
+        } else if (r->generation - r->candidate_since >= r->candidate) {
+            r->flags |= BATCH_PERIODIC;
+            r->period = r->candidate;
+            r->first = r->candidate_since - r->candidate;
+        }
+    }
+    for (uint32_t p = 1; p <= BATCH_HISTORY && p <= r->generation && !r->candidate && !r->flags; ++p) {
+        if (h->hash[(r->generation - p) % BATCH_HISTORY] == hash) {
+            r->candidate = p;
+            r->candidate_since = r->generation;
+        }
+    }
+    h->hash[r->generation % BATCH_HISTORY] = hash;
+}
+
+/*
+ * Step world k from generation to the next
+ */
+static void _generation(world_batch *b, size_t k, uint32_t generation, board_word *sums) {
+    board_word *curr = _buffer(b, k, generation),
+               *next = _buffer(b, k, generation + 1);
+
+    if (b->topology == TORUS) {
+        memcpy(curr, curr + b->ylim * b->stride, b->stride * sizeof(board_word));
+        memcpy(curr + (b->ylim + 1) * b->stride, curr + b->stride, b->stride * sizeof(board_word));
+    }
+    bitwise_generation(&b->rule, b->xlim, b->topology, curr, next, sums, 1, b->ylim + 1);
+}
+
+/*
+ * Step a world up to gens generations, until it ends
+ */
+static void _step_world(world_batch *b, size_t k, board_word *sums) {
+    // Kept here while stepping, other threads use the results next to it
+    batch_result r = b->results[k];
+
+    if (r.generation == 0) {
+        _record(b, k, &r, _buffer(b, k, 0));
+    }
+    for (uint32_t g = 0; g < b->gens && !r.flags; ++g) {
+        _generation(b, k, r.generation, sums);
+        r.generation++;
+        _record(b, k, &r, _buffer(b, k, r.generation));
+    }
+
+    r.population = _population(b, _buffer(b, k, r.generation));
+    b->results[k] = r;
+}
+
+/*
+ * Step world k by gens generations whether or not it has ended, without
+ * looking for cycles, e.g. to go through the phases of its period. Uses
+ * the scratch space of the first band, so not while batch_step runs.
+ */
+void batch_advance(world_batch *b, size_t k, uint32_t gens) {
+    batch_result *r = &b->results[k];
+
+    for (uint32_t g = 0; g < gens; ++g) {
+        _generation(b, k, r->generation, b->sums);
+        r->generation++;
+    }
+    r->population = _population(b, _buffer(b, k, r->generation));
+}
+
+static void _step_band(void *arg, unsigned int band, unsigned int bands) {
+    world_batch *b = arg;
+    board_word *sums = b->sums + band * BOARD_SLOTS * 2 * b->words;
+    size_t running = 0;
+
+    for (size_t k = band; k < b->count; k += bands) {
+        if (!b->results[k].flags) {
+            _step_world(b, k, sums);
+            running += !b->results[k].flags;
+        }
+    }
+    b->running[band] = running;
+}
+
+/*
+ * Step every world that hasn't ended by gens generations, or until it
+ * ends. Returns the number of worlds still running.
+ */
+size_t batch_step(world_batch *b, uint32_t gens) {
+    size_t running = 0;
+
+    b->gens = gens;
+    if (b->pool != NULL) {
+        pool_run(b->pool, _step_band, b);
+    } else {
+        _step_band(b, 0, 1);
+    }
+    for (unsigned int band = 0; band < b->bands; ++band) {
+        running += b->running[band];
+    }
+    return running;
+}
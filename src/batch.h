@@ -0,0 +1,89 @@
+#ifndef _BATCH_H
+#define _BATCH_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+#include "kernels.h"
+
+// Worlds start on a cache line, so threads never share one
+#define BATCH_ALIGN 64
+// Generations of hashes kept per world, the longest period found
+#define BATCH_HISTORY 64
+
+// Termination flags of a world in a batch
+#define BATCH_EXTINCT 0x1
+#define BATCH_PERIODIC 0x2 // still lifes have a period of 1
+
+/*** TYPES ***/
+
+/*
+ * Outcome of one world of a batch, counted from when it was loaded
+ */
+struct batch_result {
+    uint32_t generation;
+    uint64_t population;
+    int flags;
+    uint32_t period;
+    uint32_t first; // first generation of the cycle
+
+    // Period being confirmed, and since when
+    uint32_t candidate;
+    uint32_t candidate_since;
+};
+typedef struct batch_result batch_result;
+
+/*
+ * Hashes of the last BATCH_HISTORY generations of a world, generation g
+ * in hash[g % BATCH_HISTORY]
+ */
+struct batch_history {
+    uint64_t hash[BATCH_HISTORY];
+};
+typedef struct batch_history batch_history;
+
+/*
+ * Many small worlds of the same size, topology and rule, stepped
+ * together by the bitwise kernels. Each world is two buffers of guarded
+ * board rows, with a dead (or wrapped) row above and below, and all of
+ * them are in one allocation.
+ */
+struct world_batch {
+    size_t count;
+    uint32_t xlim;
+    uint32_t ylim;
+    world_topology topology;
+    life_rule rule;
+
+    size_t words;
+    size_t stride; // board words per row, words + 2
+    size_t buffer_words; // per buffer, (ylim + 2) rows
+    size_t world_words; // per world, both buffers rounded up to BATCH_ALIGN
+    board_word *cells;
+
+    batch_result *results;
+    batch_history *history;
+
+    unsigned int bands;
+    struct pool *pool;
+    board_word *sums; // count planes per band
+    uint32_t gens; // generations in the current batch_step
+    size_t *running; // worlds still running per band
+};
+typedef struct world_batch world_batch;
+
+/*** FUNCTIONS ***/
+
+world_batch *init_batch(size_t count, uint32_t xlim, uint32_t ylim, world_topology topology,
+        const life_rule *rule, unsigned int threads);
+void destroy_batch(world_batch *b);
+void batch_clear(world_batch *b, size_t k);
+int batch_cell(world_batch *b, size_t k, uint32_t x, uint32_t y);
+void batch_set_cell(world_batch *b, size_t k, uint32_t x, uint32_t y, int alive);
+int batch_load(world_batch *b, size_t k, world *w);
+int batch_store(world_batch *b, size_t k, world *w);
+size_t batch_step(world_batch *b, uint32_t gens);
+void batch_advance(world_batch *b, size_t k, uint32_t gens);
+
+#endif
+/* vim: set ft=c : */
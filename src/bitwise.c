@@ -0,0 +1,549 @@
+#include <string.h>
+#include "bitwise.h"
+
+/*
+ * Bit-parallel stepping engine
+ *
+ * Rows of the world are packed into boards of one bit per cell, 64 cells
+ * per board_word, with a zero guard word on each side of the row. Each
+ * row is reduced to a bit-sliced three-cell count (s0, s1) with a full
+ * adder, the same value the cellwise engine keeps in temp_calc. Three of
+ * those counts are added to get the 9-cell sum, and the rule is applied
+ * to all 64 cells of a word at once, with a network of its own for
+ * Conway's Life and a generic one for other rules. Rules that aren't
+ * totalistic skip the counts and look each cell's neighbourhood up in
+ * the rule's table instead (table_row).
+ *
+ * Only a ring of BOARD_SLOTS rows is kept, so the board stays in cache
+ * and world data is streamed through exactly once per half-step.
+ *
+ * On a torus the guard words hold ghost cells from the other end of the
+ * row instead of zeros, and the rows above the first and below the last
+ * are the last and first, so the kernels never see an edge.
+ *
+ * When the world is stepped in bands, a band never reads another band's
+ * rows from world data while it is being written. Each band instead
+ * keeps packed copies of its first and last rows (its edges), taken
+ * after the shift, and neighbours read their halo rows from those.
+ */
+
+static inline size_t _board_words(uint32_t xlim) {
+    return (xlim + BOARD_BITS - 1) / BOARD_BITS;
+}
+
+static inline board_word _tail_mask(uint32_t xlim) {
+    unsigned int rem = xlim % BOARD_BITS;
+    return rem ? ((board_word) 1 << rem) - 1 : ~(board_word) 0;
+}
+
+static inline board_word _curr_cell(world *w, size_t c) {
+    return (w->data[c >> IDX_DIV] >> ((c & OFFSET_MASK) * BITS_PER_CELL + 1)) & 1;
+}
+
+/*
+ * Row above or below the world: none (ylim) or the opposite one
+ */
+static inline uint32_t _wrap_row(world *w, int64_t y) {
+    if (w->topology != TORUS) {
+        return y < 0 ? w->ylim : (uint32_t) y;
+    }
+    return y < 0 ? w->ylim - 1 : (y >= w->ylim ? 0 : (uint32_t) y);
+}
+
+size_t bitwise_board_size(uint32_t xlim) {
+    size_t words = _board_words(xlim);
+    // Each slot is a guarded row plus two count planes, then the output
+    // row, a row lined up with world data for packing and unpacking, and
+    // the two guarded edge rows
+    return BOARD_SLOTS * ((words + 2) + 2 * words) + words + (words + 1) + 2 * (words + 2);
+}
+
+board_word *bitwise_edge_row(world *w, board_word *board, int bottom) {
+    size_t words = _board_words(w->xlim);
+    return board + bitwise_board_size(w->xlim) - (bottom ? 1 : 2) * (words + 2);
+}
+
+/*
+ * Pack words [p, q) of row y of world data into a guarded board row,
+ * clearing the guard words if the range reaches them. lin is scratch
+ * space of words + 1 board words.
+ */
+static void _pack_row(world *w, const bitwise_kernel *kn, uint32_t y,
+        board_word *row, board_word *lin, size_t p, size_t q, size_t words) {
+    size_t c = (size_t) y * w->xlim + p * BOARD_BITS;
+    size_t m = (q < words ? q * BOARD_BITS : w->xlim) - p * BOARD_BITS;
+    size_t i = c >> IDX_DIV;
+    size_t n = ((c + m - 1) >> IDX_DIV) - i + 1;
+    unsigned int s = c & OFFSET_MASK;
+
+    kn->gather(w->data + i, lin, n);
+    for (size_t k = (n + STORE_CELLS_PER_WORD - 1) / STORE_CELLS_PER_WORD; k <= q - p; ++k) {
+        lin[k] = 0;
+    }
+
+    // The range starts s cells into the first store
+    for (size_t k = 0; k < q - p; ++k) {
+        row[p+k+1] = s ? (lin[k] >> s) | (lin[k+1] << (BOARD_BITS - s)) : lin[k];
+    }
+    if (p == 0) {
+        row[0] = 0;
+    }
+    if (q == words) {
+        row[words] &= _tail_mask(w->xlim);
+        row[words + 1] = 0;
+    }
+
+    // Ghost cells go right next to the ends of the row, which for the
+    // right one is inside the last word unless the row fills it
+    if (w->topology == TORUS) {
+        size_t first = (size_t) y * w->xlim;
+        unsigned int rem = w->xlim % BOARD_BITS;
+        if (p == 0) {
+            row[0] = _curr_cell(w, first + w->xlim - 1) << (BOARD_BITS - 1);
+        }
+        if (q == words) {
+            row[rem ? words : words + 1] |= _curr_cell(w, first) << rem;
+        }
+    }
+}
+
+/*
+ * Store words [p, q) of a row of next states into the next state bits of
+ * row y. Other cells that share the first and last store keep their next
+ * states.
+ */
+static void _unpack_row(world *w, const bitwise_kernel *kn, uint32_t y,
+        const board_word *out, board_word *lin, size_t p, size_t q, size_t words) {
+    size_t c = (size_t) y * w->xlim + p * BOARD_BITS;
+    size_t m = (q < words ? q * BOARD_BITS : w->xlim) - p * BOARD_BITS;
+    size_t i = c >> IDX_DIV;
+    size_t n = ((c + m - 1) >> IDX_DIV) - i + 1;
+    size_t nw = q - p;
+    unsigned int s = c & OFFSET_MASK;
+    unsigned int e = (s + m) & OFFSET_MASK;
+
+    out += p;
+    lin[0] = out[0] << s;
+    for (size_t k = 1; k < nw; ++k) {
+        lin[k] = (out[k] << s) | (s ? out[k-1] >> (BOARD_BITS - s) : 0);
+    }
+    lin[nw] = s ? out[nw-1] >> (BOARD_BITS - s) : 0;
+
+    if (s) {
+        lin[0] |= _gather_next(w->data[i]) & ((1u << s) - 1);
+    }
+    if (e) {
+        uint32_t keep = _gather_next(w->data[i + n - 1]) & ~((1u << e) - 1) & 0xffff;
+        lin[(n - 1) / STORE_CELLS_PER_WORD] |=
+            (board_word) keep << (((n - 1) % STORE_CELLS_PER_WORD) * CELLS_PER_ELEM);
+    }
+
+    kn->scatter(lin, w->data + i, n);
+}
+
+/*
+ * Fill words [p, q) of a slot with row y and, if the rule is totalistic,
+ * its counts, plus the words either side that the counts read
+ */
+static void _load_slot(world *w, const bitwise_kernel *kn, uint32_t y, const board_word *halo,
+        board_slot *slot, board_word *lin, size_t p, size_t q, size_t words) {
+    if (halo != NULL) {
+        memcpy(slot->row + p, halo + p, (q - p + 2) * sizeof(board_word));
+    } else if (y >= w->ylim) {
+        // Rows outside the world are dead
+        memset(slot->row + p, 0, (q - p + 2) * sizeof(board_word));
+    } else {
+        _pack_row(w, kn, y, slot->row, lin, p > 0 ? p - 1 : 0, q < words ? q + 1 : words, words);
+    }
+    if (w->rule.totalistic) {
+        kn->row_sums(slot->row + p, slot->s0 + p, slot->s1 + p, q - p);
+    }
+}
+
+static inline board_slot _slot_from(const board_slot *slot, size_t p) {
+    board_slot r = { slot->row + p, slot->s0 + p, slot->s1 + p };
+    return r;
+}
+
+/*
+ * Pack the first and last rows of [y0, y1) into the board's edge rows
+ */
+void bitwise_pack_edges(world *w, board_word *board, uint32_t y0, uint32_t y1) {
+    const bitwise_kernel *kn = get_kernel();
+    size_t words = _board_words(w->xlim);
+    board_word *lin = bitwise_edge_row(w, board, 0) - (words + 1);
+
+    if (y0 >= y1) {
+        return;
+    }
+    _pack_row(w, kn, y0, bitwise_edge_row(w, board, 0), lin, 0, words, words);
+    _pack_row(w, kn, y1 - 1, bitwise_edge_row(w, board, 1), lin, 0, words, words);
+}
+
+/*
+ * Calculate words [p, q) of rows [y0, y1), all in one tile row, and flag
+ * the tiles where any cell changed
+ */
+static void _calc_tiles(world *w, const bitwise_kernel *kn, board_slot *slots,
+        board_word *out, board_word *lin, uint32_t y0, uint32_t y1, size_t p, size_t q,
+        const board_word *halo_top, const board_word *halo_bottom, uint8_t *changed, size_t words) {
+    board_word tail = _tail_mask(w->xlim);
+    int life = rule_is_conway(&w->rule);
+
+    // Row y lives in slot (y - y0 + 1) % BOARD_SLOTS
+    _load_slot(w, kn, _wrap_row(w, (int64_t) y0 - 1), halo_top, &slots[0], lin, p, q, words);
+    _load_slot(w, kn, y0, NULL, &slots[1], lin, p, q, words);
+
+    for (uint32_t y = y0, s = 1; y < y1; ++y) {
+        board_slot up = _slot_from(&slots[(s + BOARD_SLOTS - 1) % BOARD_SLOTS], p),
+                   mid = _slot_from(&slots[s], p),
+                   down = _slot_from(&slots[(s + 1) % BOARD_SLOTS], p);
+
+        _load_slot(w, kn, _wrap_row(w, (int64_t) y + 1), y + 1 == y1 ? halo_bottom : NULL,
+                &slots[(s + 1) % BOARD_SLOTS], lin, p, q, words);
+        if (life) {
+            kn->life_row(&up, &mid, &down, out + p, q - p);
+        } else if (w->rule.totalistic) {
+            kn->rule_row(&up, &mid, &down, &w->rule, out + p, q - p);
+        } else {
+            kn->table_row(&up, &mid, &down, &w->rule, out + p, q - p);
+        }
+        if (q == words) {
+            out[words-1] &= tail;
+        }
+        for (size_t k = p; k < q; ++k) {
+            board_word curr = mid.row[k-p+1] & (k == words - 1 ? tail : ~(board_word) 0);
+            changed[k / TILE_WORDS] |= (out[k] ^ curr) != 0;
+        }
+        _unpack_row(w, kn, y, out, lin, p, q, words);
+
+        s = (s + 1) % BOARD_SLOTS;
+    }
+}
+
+/*
+ * Calculate the next state for rows [y0, y1) and store it in the next
+ * state bits of world data. Rows y0-1 and y1 are read but not written,
+ * from the packed halo rows if given, else from world data.
+ *
+ * Only tiles flagged in w->tile_active are calculated. Their next states
+ * are the only ones written, and every tile of the rows gets its flag in
+ * w->tile_changed set. y0 must start a tile row.
+ * board must hold at least bitwise_board_size(w->xlim) words.
+ */
+void bitwise_calc_rows(world *w, board_word *board, uint32_t y0, uint32_t y1,
+        const board_word *halo_top, const board_word *halo_bottom) {
+    const bitwise_kernel *kn = get_kernel();
+    size_t words = _board_words(w->xlim);
+    board_slot slots[BOARD_SLOTS];
+    board_word *out, *lin;
+
+    for (int s = 0; s < BOARD_SLOTS; ++s) {
+        slots[s].row = board;
+        board += words + 2;
+        slots[s].s0 = board;
+        board += words;
+        slots[s].s1 = board;
+        board += words;
+    }
+    out = board;
+    lin = out + words;
+
+    for (uint32_t ty = y0; ty < y1; ty += TILE_ROWS) {
+        uint32_t ty1 = ty + TILE_ROWS < y1 ? ty + TILE_ROWS : y1;
+        size_t t = (size_t) (ty / TILE_ROWS) * w->tile_cols;
+        const uint8_t *active = w->tile_active + t;
+        uint8_t *changed = w->tile_changed + t;
+
+        memset(changed, 0, w->tile_cols);
+
+        // Each run of active tiles is calculated on its own
+        for (size_t p = 0, q; p < words; p = q) {
+            if (!active[p / TILE_WORDS]) {
+                q = p + TILE_WORDS;
+                continue;
+            }
+            for (q = p; q < words && active[q / TILE_WORDS]; q += TILE_WORDS);
+            if (q > words) {
+                q = words;
+            }
+            _calc_tiles(w, kn, slots, out, lin, ty, ty1, p, q,
+                    ty == y0 ? halo_top : NULL, ty1 == y1 ? halo_bottom : NULL, changed, words);
+        }
+    }
+}
+
+/*
+ * Temporal blocking
+ *
+ * world_step_n advances a band by several generations in strips of rows
+ * small enough to stay in cache. A strip of h rows is packed together
+ * with the depth rows either side of it, and stepped depth times in a
+ * pair of packed buffers, the rows that are still exact shrinking by
+ * one at each side every generation (a trapezoid), except at the edges
+ * of a bounded world, where the rows outside are always dead. What is
+ * left is the strip itself, depth generations on, which is stored back
+ * into world data. World data is read and written once per depth
+ * generations instead of twice per generation.
+ *
+ * Strips go down the band in order, so the rows above a strip have
+ * already been overwritten when it is packed. The previous strip keeps
+ * its last depth rows as they were (carry), and each band keeps its
+ * first and last depth rows (halos) for its neighbours, saved before any
+ * band is stepped.
+ */
+
+static inline size_t _block_rows(size_t words, unsigned int depth) {
+    size_t rows = BLOCK_BYTES / (2 * (words + 2) * sizeof(board_word));
+    return rows > 4 * depth + 2 ? rows : 4 * depth + 2;
+}
+
+/*
+ * Rows in a strip, so both buffers of a strip with its trapezoid fit in
+ * BLOCK_BYTES, unless the rows are so long that only about twice the
+ * depth fits
+ */
+static inline uint32_t _strip_rows(size_t words, unsigned int depth) {
+    return _block_rows(words, depth) - 2 * depth - 2;
+}
+
+size_t bitwise_block_size(uint32_t xlim) {
+    size_t words = _board_words(xlim);
+    // Two halos of BLOCK_DEPTH_MAX rows, the carry rows, two buffers of
+    // guarded rows, three slots of count planes and a linear row
+    return (3 * BLOCK_DEPTH_MAX + 2 * _block_rows(words, BLOCK_DEPTH_MAX)) * (words + 2) +
+        BOARD_SLOTS * 2 * words + words + 1;
+}
+
+/*
+ * First (or last) depth rows of a band, as saved by bitwise_save_halos
+ */
+const board_word *bitwise_halo_rows(world *w, const board_word *block, int bottom) {
+    return block + (bottom ? BLOCK_DEPTH_MAX * (_board_words(w->xlim) + 2) : 0);
+}
+
+/*
+ * Pack the first and last depth rows of [y0, y1) into the block's halos.
+ * There must be at least depth rows.
+ */
+void bitwise_save_halos(world *w, board_word *block, uint32_t y0, uint32_t y1, unsigned int depth) {
+    const bitwise_kernel *kn = get_kernel();
+    size_t words = _board_words(w->xlim), stride = words + 2;
+    board_word *lin = block + bitwise_block_size(w->xlim) - (words + 1);
+
+    for (unsigned int j = 0; j < depth; ++j) {
+        _pack_row(w, kn, y0 + j, block + j * stride, lin, 0, words, words);
+        _pack_row(w, kn, y1 - depth + j, block + (BLOCK_DEPTH_MAX + j) * stride, lin, 0, words, words);
+    }
+}
+
+/*
+ * Clear the cells past the end of a full guarded row, and set its guard
+ * words: dead, or ghost cells from the other end on a torus
+ */
+static inline void _guard_row(uint32_t xlim, world_topology topology, board_word *row, size_t words) {
+    unsigned int rem = xlim % BOARD_BITS;
+
+    row[words] &= _tail_mask(xlim);
+    row[0] = 0;
+    row[words + 1] = 0;
+    if (topology == TORUS) {
+        board_word first = row[1] & 1,
+                   last = (row[(xlim - 1) / BOARD_BITS + 1] >> ((xlim - 1) % BOARD_BITS)) & 1;
+        row[0] = last << (BOARD_BITS - 1);
+        row[rem ? words : words + 1] |= first << rem;
+    }
+}
+
+/*
+ * Guard n consecutive guarded rows of xlim cells
+ */
+void bitwise_guard_rows(uint32_t xlim, world_topology topology, board_word *rows, size_t n) {
+    size_t words = _board_words(xlim);
+
+    for (size_t r = 0; r < n; ++r) {
+        _guard_row(xlim, topology, rows + r * (words + 2), words);
+    }
+}
+
+/*
+ * Store a row of states as both the current and next states of row y.
+ * Cells of other rows that share its first and last store are kept.
+ */
+static void _store_row(world *w, uint32_t y, const board_word *bits, board_word *lin, size_t words) {
+    size_t c = (size_t) y * w->xlim;
+    size_t i = c >> IDX_DIV;
+    size_t n = ((c + w->xlim - 1) >> IDX_DIV) - i + 1;
+    unsigned int s = c & OFFSET_MASK;
+    unsigned int e = (s + w->xlim) & OFFSET_MASK;
+
+    lin[0] = bits[0] << s;
+    for (size_t k = 1; k < words; ++k) {
+        lin[k] = (bits[k] << s) | (s ? bits[k-1] >> (BOARD_BITS - s) : 0);
+    }
+    lin[words] = s ? bits[words-1] >> (BOARD_BITS - s) : 0;
+
+    for (size_t j = 0; j < n; ++j) {
+        uint32_t v = lin[j / STORE_CELLS_PER_WORD] >> ((j % STORE_CELLS_PER_WORD) * CELLS_PER_ELEM);
+        uint32_t m = 0xffff;
+        if (j == 0) {
+            m &= ~((1u << s) - 1);
+        }
+        if (j == n - 1 && e) {
+            m &= (1u << e) - 1;
+        }
+        world_store sv = _scatter_next(v & m), sm = _scatter_next(m);
+        w->data[i+j] = (w->data[i+j] & ~(sm | sm << 1)) | sv | sv << 1;
+    }
+}
+
+/*
+ * bitwise_generation by a kernel, or by the scalar helpers inlined if kn
+ * is NULL
+ */
+static inline void _generation(const bitwise_kernel *kn, const life_rule *rule, uint32_t xlim,
+        world_topology topology, board_word *curr, board_word *next, board_word *sums,
+        size_t lo, size_t hi) {
+    size_t words = _board_words(xlim), stride = words + 2;
+    int life = rule_is_conway(rule);
+    board_slot slots[BOARD_SLOTS];
+
+    for (int s = 0; s < BOARD_SLOTS; ++s) {
+        slots[s].s0 = sums + 2 * s * words;
+        slots[s].s1 = slots[s].s0 + words;
+    }
+    for (size_t r = lo - 1; r <= lo; ++r) {
+        board_slot *slot = &slots[r % BOARD_SLOTS];
+        slot->row = curr + r * stride;
+        if (rule->totalistic && kn != NULL) {
+            kn->row_sums(slot->row, slot->s0, slot->s1, words);
+        } else if (rule->totalistic) {
+            _row_sums_from(slot->row, slot->s0, slot->s1, 0, words);
+        }
+    }
+
+    for (size_t r = lo; r < hi; ++r) {
+        board_slot *up = &slots[(r - 1) % BOARD_SLOTS],
+                   *mid = &slots[r % BOARD_SLOTS],
+                   *down = &slots[(r + 1) % BOARD_SLOTS];
+        board_word *out = next + r * stride;
+
+        down->row = curr + (r + 1) * stride;
+        if (kn != NULL) {
+            if (rule->totalistic) {
+                kn->row_sums(down->row, down->s0, down->s1, words);
+            }
+            if (life) {
+                kn->life_row(up, mid, down, out + 1, words);
+            } else if (rule->totalistic) {
+                kn->rule_row(up, mid, down, rule, out + 1, words);
+            } else {
+                kn->table_row(up, mid, down, rule, out + 1, words);
+            }
+        } else {
+            if (rule->totalistic) {
+                _row_sums_from(down->row, down->s0, down->s1, 0, words);
+            }
+            if (life) {
+                _life_row_from(up, mid, down, out + 1, 0, words);
+            } else if (rule->totalistic) {
+                _rule_row_from(up, mid, down, rule, out + 1, 0, words);
+            } else {
+                _table_row_from(up, mid, down, rule, out + 1, 0, words);
+            }
+        }
+        _guard_row(xlim, topology, out, words);
+    }
+}
+
+/*
+ * One generation of guarded rows [lo, hi) of next from rows [lo - 1, hi]
+ * of curr, rows of xlim cells. sums is scratch space for the counts of
+ * BOARD_SLOTS rows, 2 * words board words each.
+ */
+void bitwise_generation(const life_rule *rule, uint32_t xlim, world_topology topology,
+        board_word *curr, board_word *next, board_word *sums, size_t lo, size_t hi) {
+    // Rows this short cost more in kernel calls than in work
+    if (_board_words(xlim) <= NARROW_WORDS) {
+        _generation(NULL, rule, xlim, topology, curr, next, sums, lo, hi);
+    } else {
+        _generation(get_kernel(), rule, xlim, topology, curr, next, sums, lo, hi);
+    }
+}
+
+/*
+ * Advance rows [y0, y1) by depth generations, up to BLOCK_DEPTH_MAX and
+ * no more than the rows of any band. The depth rows either side are read
+ * from the halos of the neighbouring bands (the band itself, if it is the
+ * only one on a torus), which can only be NULL at the edges of a bounded
+ * world. Only the band's own rows are read from world data and written,
+ * so bands can be stepped at the same time once every band's halos are
+ * saved.
+ */
+void bitwise_step_block(world *w, board_word *block, uint32_t y0, uint32_t y1, unsigned int depth,
+        const board_word *halo_top, const board_word *halo_bottom) {
+    const bitwise_kernel *kn = get_kernel();
+    size_t words = _board_words(w->xlim), stride = words + 2;
+    size_t rows = _block_rows(words, BLOCK_DEPTH_MAX);
+    uint32_t h = _strip_rows(words, depth);
+    int torus = w->topology == TORUS;
+    board_word *carry = block + 2 * BLOCK_DEPTH_MAX * stride,
+               *bufs[2] = { carry + BLOCK_DEPTH_MAX * stride, carry + (BLOCK_DEPTH_MAX + rows) * stride },
+               *sums = bufs[1] + rows * stride,
+               *lin = sums + BOARD_SLOTS * 2 * words;
+
+    for (uint32_t sy = y0; sy < y1; sy += h) {
+        uint32_t sy1 = sy + h < y1 ? sy + h : y1;
+        // Rows [ys, ye) of the strip and its trapezoid, as buffer rows
+        // 1 to ye - ys, with a dead row either side for world edges
+        int64_t ys = (int64_t) sy - depth, ye = (int64_t) sy1 + depth;
+        int top = 0, bottom = 0;
+        if (!torus && ys <= 0) {
+            ys = 0;
+            top = 1;
+        }
+        if (!torus && ye >= w->ylim) {
+            ye = w->ylim;
+            bottom = 1;
+        }
+        size_t n = ye - ys;
+
+        for (int b = 0; b < 2; ++b) {
+            memset(bufs[b], 0, stride * sizeof(board_word));
+            memset(bufs[b] + (n + 1) * stride, 0, stride * sizeof(board_word));
+        }
+
+        for (int64_t y = ys; y < ye; ++y) {
+            board_word *row = bufs[0] + (y - ys + 1) * stride;
+            if (y < y0) {
+                memcpy(row, halo_top + (y - ((int64_t) y0 - depth)) * stride, stride * sizeof(board_word));
+            } else if (y < sy) {
+                memcpy(row, carry + (y - ((int64_t) sy - depth)) * stride, stride * sizeof(board_word));
+            } else if (y >= y1) {
+                memcpy(row, halo_bottom + (y - y1) * stride, stride * sizeof(board_word));
+            } else {
+                _pack_row(w, kn, (uint32_t) y, row, lin, 0, words, words);
+            }
+        }
+
+        // The next strip starts where this one ends
+        for (unsigned int j = 0; j < depth; ++j) {
+            int64_t y = (int64_t) sy1 - depth + j;
+            if (y >= ys) {
+                memcpy(carry + j * stride, bufs[0] + (y - ys + 1) * stride, stride * sizeof(board_word));
+            }
+        }
+
+        size_t lo = 1, hi = n + 1;
+        for (unsigned int g = 0; g < depth; ++g) {
+            lo += !top;
+            hi -= !bottom;
+            bitwise_generation(&w->rule, w->xlim, w->topology, bufs[g & 1], bufs[(g + 1) & 1],
+                    sums, lo, hi);
+        }
+
+        for (uint32_t y = sy; y < sy1; ++y) {
+            _store_row(w, y, bufs[depth & 1] + (y - ys + 1) * stride + 1, lin, words);
+        }
+    }
+}
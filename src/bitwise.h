@@ -0,0 +1,37 @@
+#ifndef _BITWISE_H
+#define _BITWISE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+#include "kernels.h"
+
+#define BOARD_SLOTS 3
+#define TILE_WORDS (TILE_COLS / BOARD_BITS)
+
+// Temporal blocking: most generations per pass, and the bytes a strip
+// and its trapezoid should take, for both buffers
+#define BLOCK_DEPTH_MAX 16
+#define BLOCK_BYTES (512 * 1024)
+
+// Rows of up to this many words are stepped without the vector kernels
+#define NARROW_WORDS 2
+
+/*** FUNCTIONS ***/
+
+size_t bitwise_board_size(uint32_t xlim);
+board_word *bitwise_edge_row(world *w, board_word *board, int bottom);
+void bitwise_pack_edges(world *w, board_word *board, uint32_t y0, uint32_t y1);
+void bitwise_calc_rows(world *w, board_word *board, uint32_t y0, uint32_t y1,
+        const board_word *halo_top, const board_word *halo_bottom);
+size_t bitwise_block_size(uint32_t xlim);
+const board_word *bitwise_halo_rows(world *w, const board_word *block, int bottom);
+void bitwise_save_halos(world *w, board_word *block, uint32_t y0, uint32_t y1, unsigned int depth);
+void bitwise_step_block(world *w, board_word *block, uint32_t y0, uint32_t y1, unsigned int depth,
+        const board_word *halo_top, const board_word *halo_bottom);
+void bitwise_guard_rows(uint32_t xlim, world_topology topology, board_word *rows, size_t n);
+void bitwise_generation(const life_rule *rule, uint32_t xlim, world_topology topology,
+        board_word *curr, board_word *next, board_word *sums, size_t lo, size_t hi);
+
+#endif
+/* vim: set ft=c : */
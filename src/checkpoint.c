@@ -0,0 +1,186 @@
+#include <string.h>
+#include "checkpoint.h"
+
+/*
+ * Checkpoints
+ *
+ * Saving a big world takes a while: it is serialized, base64 encoded and
+ * written out. The checkpoint thread does all of that, from a snapshot of
+ * the world as it was when the save was asked for, so neither drawing nor
+ * stepping waits for it. In graphical mode the snapshots are the
+ * simulation's own (see sim.h), held while they are written; otherwise
+ * the world is copied into one of two snapshots of the checkpointer's,
+ * one being written and the other waiting.
+ *
+ * Files are written whole under a temporary name and renamed over the
+ * last save (see write_file), so a crash, even halfway through a save,
+ * leaves the last save as it was and loses at most an interval of work.
+ * The world file format has no way of updating part of a world, so
+ * rather than only what changed, a world is saved whole, and only if it
+ * was stepped since the last save.
+ */
+
+/*
+ * Intervals are a number of generations, or of seconds with an 's'
+ * after it. Returns 0 if str isn't an interval.
+ */
+int parse_checkpoint_interval(const char *str, checkpoint_interval *interval) {
+    char *end;
+    long int every = strtol(str, &end, 10);
+
+    if (end == str || every <= 0) {
+        return 0;
+    }
+    if (*end == 's' && end[1] == '\0') {
+        interval->mode = CHECKPOINT_SECONDS;
+    } else if (*end == '\0') {
+        interval->mode = CHECKPOINT_GENERATIONS;
+    } else {
+        return 0;
+    }
+    interval->every = every;
+    return 1;
+}
+
+static int _run(void *arg) {
+    checkpointer *cp = arg;
+
+    SDL_LockMutex(cp->lock);
+    for (;;) {
+        sim_snapshot *snap;
+        Uint32 start;
+
+        while (cp->pending == NULL && !cp->quit) {
+            SDL_CondWait(cp->wake, cp->lock);
+        }
+        // Anything still waiting is written before quitting
+        if (cp->pending == NULL) {
+            break;
+        }
+        snap = cp->pending;
+        cp->pending = NULL;
+        SDL_UnlockMutex(cp->lock);
+
+        start = SDL_GetTicks();
+        if (write_to_file(cp->filename, &snap->w, BASE64) > 0) {
+            printf("Saved generation %lu to %s in %.3fs\n", (unsigned long) snap->w.generation,
+                    cp->filename, (SDL_GetTicks() - start) / 1000.0);
+        } else {
+            fprintf(stderr, "Couldn't write %s\n", cp->filename);
+        }
+
+        SDL_LockMutex(cp->lock);
+        sim_snapshot_release(snap);
+    }
+    SDL_UnlockMutex(cp->lock);
+
+    return 0;
+}
+
+/*
+ * Save worlds to filename, automatically every interval from generation
+ * on (see checkpoint_due)
+ */
+checkpointer *init_checkpointer(const char *filename, checkpoint_interval interval,
+        uint32_t generation) {
+    checkpointer *cp = calloc(1, sizeof(checkpointer));
+
+    if (cp == NULL) {
+        fprintf(stderr, "Could not allocate %lu bytes\n", (unsigned long) sizeof(checkpointer));
+        exit(EXIT_FAILURE);
+    }
+    cp->filename = filename;
+    cp->interval = interval;
+    cp->generation = generation;
+    cp->ticks = SDL_GetTicks();
+
+    cp->lock = SDL_CreateMutex();
+    cp->wake = SDL_CreateCond();
+    cp->thread = SDL_CreateThread(_run, "checkpoint", cp);
+    if (cp->thread == NULL) {
+        printf("Could not create checkpoint thread: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    return cp;
+}
+
+/*
+ * Waits for every save asked for to be written
+ */
+void destroy_checkpointer(checkpointer *cp) {
+    SDL_LockMutex(cp->lock);
+    cp->quit = 1;
+    SDL_CondSignal(cp->wake);
+    SDL_UnlockMutex(cp->lock);
+    SDL_WaitThread(cp->thread, NULL);
+
+    SDL_DestroyCond(cp->wake);
+    SDL_DestroyMutex(cp->lock);
+    for (int i = 0; i < 2; ++i) {
+        sim_snapshot_free(&cp->copies[i]);
+    }
+    free(cp);
+}
+
+/*
+ * Whether a world at generation should be saved automatically: an
+ * interval has passed since the last save, and it has been stepped since
+ */
+int checkpoint_due(checkpointer *cp, uint32_t generation) {
+    if (cp->interval.every == 0 || generation == cp->generation) {
+        return 0;
+    }
+    if (cp->interval.mode == CHECKPOINT_SECONDS) {
+        return SDL_GetTicks() - cp->ticks >= cp->interval.every * 1000;
+    }
+    // Going back counts as far from the last save
+    return (uint32_t) (generation - cp->generation) >= cp->interval.every;
+}
+
+static void _queue(checkpointer *cp, sim_snapshot *snap) {
+    if (cp->pending != NULL) {
+        sim_snapshot_release(cp->pending);
+    }
+    cp->pending = snap;
+    cp->generation = snap->w.generation;
+    cp->ticks = SDL_GetTicks();
+    SDL_CondSignal(cp->wake);
+}
+
+/*
+ * Save a snapshot, which the checkpointer releases once it is written
+ */
+void checkpoint_snapshot(checkpointer *cp, sim_snapshot *snap) {
+    SDL_LockMutex(cp->lock);
+    _queue(cp, snap);
+    SDL_UnlockMutex(cp->lock);
+}
+
+/*
+ * Save a copy of w as it is now, which only takes as long as copying it.
+ * Returns 0 if there isn't the memory for the copy, and nothing is saved.
+ */
+int checkpoint_world(checkpointer *cp, world *w) {
+    sim_snapshot *copy;
+
+    SDL_LockMutex(cp->lock);
+    if (cp->pending != NULL) {
+        sim_snapshot_release(cp->pending);
+        cp->pending = NULL;
+    }
+    // The other one can be being written
+    copy = SDL_AtomicGet(&cp->copies[0].refs) == 0 ? &cp->copies[0] : &cp->copies[1];
+    if (!sim_snapshot_copy(copy, w)) {
+        // Tried again an interval later
+        cp->generation = w->generation;
+        cp->ticks = SDL_GetTicks();
+        SDL_UnlockMutex(cp->lock);
+        fprintf(stderr, "Couldn't copy generation %lu to save it\n", (unsigned long) w->generation);
+        return 0;
+    }
+    SDL_AtomicSet(&copy->refs, 1);
+    _queue(cp, copy);
+    SDL_UnlockMutex(cp->lock);
+    return 1;
+}
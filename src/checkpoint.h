@@ -0,0 +1,63 @@
+#ifndef _CHECKPOINT_H
+#define _CHECKPOINT_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+#include "world.h"
+#include "sim.h"
+
+/*** TYPES ***/
+
+/*
+ * How often a running world is saved: every number of generations, or
+ * of seconds, or never if every is 0
+ */
+enum checkpoint_mode { CHECKPOINT_GENERATIONS=0, CHECKPOINT_SECONDS=1 };
+typedef enum checkpoint_mode checkpoint_mode;
+
+struct checkpoint_interval {
+    checkpoint_mode mode;
+    unsigned long int every;
+};
+typedef struct checkpoint_interval checkpoint_interval;
+
+/*
+ * Saves worlds to a file on its own thread. A save is a snapshot, held
+ * until it has been written, so the world goes on meanwhile. A save
+ * waiting to be written is replaced by a newer one.
+ */
+struct checkpointer {
+    const char *filename;
+    checkpoint_interval interval;
+
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *wake;
+
+    sim_snapshot *pending;
+    sim_snapshot copies[2]; // of worlds that aren't simulated
+    int quit;
+
+    uint32_t generation; // of the last save
+    Uint32 ticks; // when the last save was made
+};
+typedef struct checkpointer checkpointer;
+
+/*** FUNCTIONS ***/
+
+int parse_checkpoint_interval(const char *str, checkpoint_interval *interval);
+checkpointer *init_checkpointer(const char *filename, checkpoint_interval interval,
+        uint32_t generation);
+void destroy_checkpointer(checkpointer *cp);
+int checkpoint_due(checkpointer *cp, uint32_t generation);
+void checkpoint_snapshot(checkpointer *cp, sim_snapshot *snap);
+int checkpoint_world(checkpointer *cp, world *w);
+
+#endif
+/* vim: set ft=c : */
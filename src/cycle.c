@@ -0,0 +1,108 @@
+#include "cycle.h"
+
+/*
+ * Cycle detection
+ *
+ * Every generation's hash (see cycle_hash) is recorded with its
+ * generation number. A hash seen before, newest first so the period is
+ * the shortest one, makes the distance between them a candidate period.
+ * It is confirmed once every generation for another whole period has
+ * matched the one a period before it, and the generation first matched
+ * is where the cycle was first reached. Hashes are 64 bits, so a false
+ * match would have to happen a period's worth of times in a row.
+ *
+ * Generations stepped in blocks (world_step_n) aren't all recorded, so
+ * a candidate can be a multiple of the period, and its matches can't
+ * always be checked. A shorter one found later replaces it, which is
+ * why world_step_n steps one generation at a time while there is one.
+ *
+ * A world with no live or dying cells whose rule can't give birth from
+ * nothing is extinct, a cycle of period 1 that is known at once.
+ */
+
+void cycle_reset(world *w) {
+    w->history->count = 0;
+    w->history->next = 0;
+    w->history->candidate = 0;
+    w->cycle.period = 0;
+    w->cycle.first = 0;
+    w->cycle.extinct = 0;
+}
+
+/*
+ * Hash recorded for a generation, returns 0 if it isn't in the history
+ */
+static int _recorded(const cycle_history *h, uint32_t generation, uint64_t *hash) {
+    for (unsigned int k = 1; k <= h->count; ++k) {
+        unsigned int idx = (h->next + CYCLE_HISTORY - k) % CYCLE_HISTORY;
+        if (h->generation[idx] == generation) {
+            *hash = h->hash[idx];
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static inline int _stays_empty(const life_rule *rule) {
+    return rule->range > 1 ? rule->birth_min > 0 : !(rule->birth & 1);
+}
+
+/*
+ * No live or dying cells, only checked when the hash is 0 like an empty
+ * world's is
+ */
+static int _empty(const world *w) {
+    for (size_t i = 0; i < w->data_size; ++i) {
+        if (w->data[i] & CURR_CELL_MASK) {
+            return 0;
+        }
+    }
+    for (size_t i = 0; w->decay != NULL && i < (w->data_size + 1) * w->decay_planes; ++i) {
+        if (w->decay[i]) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/*
+ * Record the world's current hash, once per generation that was stepped
+ * to, and look for a cycle if none is known yet
+ */
+void cycle_record(world *w) {
+    cycle_history *h = w->history;
+    uint32_t g = w->generation;
+    uint64_t past;
+
+    if (w->cycle.period == 0) {
+        if (w->hash == 0 && _stays_empty(&w->rule) && _empty(w)) {
+            w->cycle.period = 1;
+            w->cycle.first = g;
+            w->cycle.extinct = 1;
+        } else if (h->candidate) {
+            if (_recorded(h, g - h->candidate, &past) && past != w->hash) {
+                h->candidate = 0;
+            } else if (g - h->candidate_since >= h->candidate) {
+                w->cycle.period = h->candidate;
+                w->cycle.first = h->candidate_since - h->candidate;
+            }
+        }
+
+        for (unsigned int k = 1; k <= h->count && !w->cycle.period; ++k) {
+            unsigned int idx = (h->next + CYCLE_HISTORY - k) % CYCLE_HISTORY;
+            if (h->candidate && g - h->generation[idx] >= h->candidate) {
+                break;
+            }
+            if (h->hash[idx] == w->hash) {
+                h->candidate = g - h->generation[idx];
+                h->candidate_since = g;
+                break;
+            }
+        }
+    }
+
+    h->hash[h->next] = w->hash;
+    h->generation[h->next] = g;
+    h->next = (h->next + 1) % CYCLE_HISTORY;
+    h->count += h->count < CYCLE_HISTORY;
+}
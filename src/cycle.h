@@ -0,0 +1,49 @@
+#ifndef _CYCLE_H
+#define _CYCLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+
+// Generations of hashes kept, so the longest period that can be found
+// is one less
+#define CYCLE_HISTORY 256
+
+/*** TYPES ***/
+
+/*
+ * Hashes of the last CYCLE_HISTORY recorded generations, a ring with the
+ * newest at next - 1, and the period being confirmed, if any
+ */
+struct cycle_history {
+    uint64_t hash[CYCLE_HISTORY];
+    uint32_t generation[CYCLE_HISTORY];
+    unsigned int count;
+    unsigned int next;
+
+    uint32_t candidate;
+    uint32_t candidate_since;
+};
+typedef struct cycle_history cycle_history;
+
+/*** INLINE HELPERS ***/
+
+/*
+ * Hash of word i of the states holding v, 0 if v is. The world's hash is
+ * the XOR of the hashes of all its words, so changing one changes the
+ * hash by the XOR of its old and new hashes, and an empty world hashes
+ * to 0.
+ */
+static inline uint64_t cycle_hash(uint64_t i, uint64_t v) {
+    uint64_t x = (v ^ (i * 0x9e3779b97f4a7c15ull)) * 0xbf58476d1ce4e5b9ull;
+
+    return (x ^ (x >> 32)) & (0 - (uint64_t) (v != 0));
+}
+
+/*** FUNCTIONS ***/
+
+void cycle_reset(world *w);
+void cycle_record(world *w);
+
+#endif
+/* vim: set ft=c : */
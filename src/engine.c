@@ -0,0 +1,104 @@
+#include <string.h>
+#include "engine.h"
+
+/*
+ * Engine registry
+ *
+ * A world's engine is its index here, fixed when the world is made. The
+ * built-in engines come first, in the order of enum world_engine, and
+ * engines registered later get the indices after them, so an engine can
+ * be added without changing anything that steps or shows worlds.
+ */
+
+static const world_engine_ops *engines[ENGINE_MAX] = { &CELL_ENGINE, &BITWISE_ENGINE };
+static unsigned int engines_count = 2;
+
+/*
+ * Add an engine, setting engine to its index. Returns 0 if the name is
+ * taken or the registry is full.
+ */
+int register_engine(const world_engine_ops *ops, world_engine *engine) {
+    world_engine other;
+
+    if (engines_count == ENGINE_MAX || parse_engine(ops->name, &other)) {
+        return 0;
+    }
+    *engine = engines_count;
+    engines[engines_count++] = ops;
+    return 1;
+}
+
+/*
+ * The engine at an index, or NULL if there is none
+ */
+const world_engine_ops *get_engine(world_engine engine) {
+    return (unsigned int) engine < engines_count ? engines[engine] : NULL;
+}
+
+unsigned int engine_count(void) {
+    return engines_count;
+}
+
+/*
+ * Look up an engine by name, returns 0 if the name is unknown
+ */
+int parse_engine(const char *name, world_engine *engine) {
+    for (unsigned int i = 0; i < engines_count; ++i) {
+        if (strcmp(name, engines[i]->name) == 0) {
+            *engine = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const char *engine_name(world_engine engine) {
+    const world_engine_ops *ops = get_engine(engine);
+    return ops != NULL ? ops->name : "unknown";
+}
+
+void print_engines(FILE *out) {
+    for (unsigned int i = 0; i < engines_count; ++i) {
+        fprintf(out, "    %-10s %s\n", engines[i]->name, engines[i]->summary);
+    }
+}
+
+/*
+ * What the world's engine can't step about it, or NULL if it can step it
+ */
+const char *engine_refuses(world *w) {
+    const world_engine_ops *ops = get_engine(w->engine);
+    return ops->refuses != NULL ? ops->refuses(w) : NULL;
+}
+
+/*
+ * For engines that simulate an unbounded plane: it has no edges to wrap
+ * around, and the empty space around a pattern has to stay empty
+ */
+const char *engine_refuses_unbounded(world *w) {
+    if (w->topology == TORUS) {
+        return "a toroidal world";
+    } else if (w->rule.birth & 1) {
+        return "a B0 rule";
+    } else if (w->rule.range > 1) {
+        return "a Larger than Life rule";
+    } else if (w->rule.states > 2) {
+        return "a Generations rule";
+    }
+    return NULL;
+}
+
+/*
+ * Statistics of the world's engine, or of the world's own storage if
+ * the engine keeps none, or hasn't taken in an edit to the world yet
+ */
+void get_engine_stats(world *w, engine_stats *stats) {
+    const world_engine_ops *ops = get_engine(w->engine);
+
+    if (ops->stats != NULL && !w->edited) {
+        ops->stats(w, stats);
+        return;
+    }
+    stats->population = world_population(w);
+    stats->memory = w->data_size * sizeof(world_store);
+}
@@ -0,0 +1,95 @@
+#ifndef _ENGINE_H
+#define _ENGINE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include "world.h"
+
+// Engines that can be registered, the built-in ones included
+#define ENGINE_MAX 16
+
+/*** TYPES ***/
+
+/*
+ * What an engine holds: the live cells of the whole pattern, which for
+ * an engine that keeps its own can go on past the world's edges, and
+ * the bytes its cells take up
+ */
+struct engine_stats {
+    uint64_t population;
+    size_t memory;
+};
+typedef struct engine_stats engine_stats;
+
+/*
+ * A stepping engine. Most engines work on the world's own storage:
+ * calc writes the next state of each cell into its even bit, for any
+ * range 1 rule, and world.c shifts it into place, hashes it and keeps
+ * the history. Range rules and dying states are stepped the same way
+ * whatever the engine, so calc never sees them.
+ *
+ * An engine can keep the pattern itself instead, by setting
+ * export_region, and the world is then a window onto it with its top
+ * left cell at (0, 0). Its calc only steps the pattern, taking the
+ * window in first if the world was edited since it last did, and the
+ * window of the next generation is exported into the next states.
+ * Generations it steps have no cycles looked for, and aren't kept for
+ * rewinding, as the window repeating says nothing of the pattern.
+ *
+ * calc:    next states of the world, setting state to SHIFT. Leaves
+ *          tiles_valid 0, or sets tile_changed for every tile it
+ *          changed and active_tiles to the tiles it calculated.
+ * init:    optional, sets up w->engine_data once the world is made
+ * step_n:  optional, advances a world in the CALC state by n whole
+ *          generations at once, returning 0 to be stepped one
+ *          generation at a time instead
+ * report:  optional, details for profile mode
+ * destroy: optional, frees w->engine_data
+ * refuses: optional, what the engine can't step about the world, e.g.
+ *          "a toroidal world", or NULL if it can step it. Refused
+ *          worlds are stepped by the bitwise engine.
+ * get_cell, set_cell: optional, a cell of the pattern, anywhere on it.
+ *          set_cell returns 0 if it couldn't be set, and the window is
+ *          taken in whole instead.
+ * export_region: optional, sets both state bits of the live cells of
+ *          the pattern's xlim by ylim region from (x0, y0) in data,
+ *          laid out like world data, leaving the others as they are
+ * stats:   optional, the pattern's statistics, the window's otherwise
+ * shift_band: optional, run for each band on its worker thread once
+ *          the band's next states are current, for engines that keep
+ *          something of their own up to date with the world's data
+ */
+struct world_engine_ops {
+    const char *name;
+    const char *summary;
+    void (*calc)(world *w);
+    void (*init)(world *w);
+    int (*step_n)(world *w, unsigned int n);
+    void (*report)(world *w, FILE *out);
+    void (*destroy)(world *w);
+    const char *(*refuses)(world *w);
+    int (*get_cell)(world *w, int64_t x, int64_t y);
+    int (*set_cell)(world *w, int64_t x, int64_t y, int alive);
+    void (*export_region)(world *w, int64_t x0, int64_t y0, uint32_t xlim, uint32_t ylim,
+            world_store *data);
+    void (*stats)(world *w, engine_stats *stats);
+    void (*shift_band)(world *w, unsigned int band, unsigned int bands);
+};
+typedef struct world_engine_ops world_engine_ops;
+
+/*** FUNCTIONS ***/
+
+// Built-in engines, defined in world.c
+extern const world_engine_ops CELL_ENGINE;
+extern const world_engine_ops BITWISE_ENGINE;
+
+int register_engine(const world_engine_ops *ops, world_engine *engine);
+const world_engine_ops *get_engine(world_engine engine);
+unsigned int engine_count(void);
+void print_engines(FILE *out);
+const char *engine_refuses(world *w);
+const char *engine_refuses_unbounded(world *w);
+void get_engine_stats(world *w, engine_stats *stats);
+
+#endif
+/* vim: set ft=c : */
@@ -0,0 +1,222 @@
+#include <string.h>
+#include "ensemble.h"
+#include "bitwise.h"
+
+/*
+ * Ensembles of worlds in bit lanes
+ *
+ * The bitwise engine packs 64 cells of a row into a word, so each cell
+ * needs shifts to meet its neighbours. An ensemble packs the same cell of
+ * 64 worlds into a word instead: the neighbours of a cell are the words
+ * around it, and the same adder network and rule logic as the bitwise
+ * engine's (the kernels' life_row and rule_row only work word by word)
+ * step all 64 worlds at once. Sweeps of seeds or starting patterns over
+ * one small world get 64 runs for about the cost of one.
+ *
+ * Only totalistic rules with a range of 1 and 2 states are stepped this
+ * way; init_ensemble returns NULL for the others.
+ */
+
+static inline board_word *_row(world_ensemble *e, int buffer, uint32_t y) {
+    return e->cells[buffer] + (size_t) (y + 1) * e->stride;
+}
+
+/*
+ * Three-cell counts of a guarded row of lanes, the same as
+ * _row_sums_from but with the neighbours in the next words
+ */
+static inline void _lane_sums(const board_word *row, board_word *s0, board_word *s1, size_t n) {
+    for (size_t k = 0; k < n; ++k) {
+        board_word left = row[k], mid = row[k+1], right = row[k+2];
+        board_word lm = left ^ mid;
+        s0[k] = lm ^ right;
+        s1[k] = (left & mid) | (right & lm);
+    }
+}
+
+/*
+ * Copy the opposite edges of a torus into the guard words and rows
+ */
+static void _wrap(world_ensemble *e, board_word *cells) {
+    for (uint32_t y = 1; y <= e->ylim; ++y) {
+        board_word *row = cells + y * e->stride;
+        row[0] = row[e->xlim];
+        row[e->xlim + 1] = row[1];
+    }
+    memcpy(cells, cells + e->ylim * e->stride, e->stride * sizeof(board_word));
+    memcpy(cells + (e->ylim + 1) * e->stride, cells + e->stride, e->stride * sizeof(board_word));
+}
+
+world_ensemble *init_ensemble(uint32_t xlim, uint32_t ylim, world_topology topology,
+        const life_rule *rule) {
+    world_ensemble *e;
+    size_t words;
+
+    // The table kernels shift neighbours in from the same word
+    if (xlim == 0 || ylim == 0 || rule->range > 1 || rule->states > 2 || !rule->totalistic) {
+        return NULL;
+    }
+
+    e = calloc(1, sizeof(world_ensemble));
+    e->xlim = xlim;
+    e->ylim = ylim;
+    e->topology = topology;
+    e->rule = *rule;
+    e->stride = (size_t) xlim + 2;
+
+    words = (size_t) (ylim + 2) * e->stride;
+    e->cells[0] = calloc(words, sizeof(board_word));
+    e->cells[1] = calloc(words, sizeof(board_word));
+    e->sums = malloc(BOARD_SLOTS * 2 * (size_t) xlim * sizeof(board_word));
+    if (e->cells[0] == NULL || e->cells[1] == NULL || e->sums == NULL) {
+        destroy_ensemble(e);
+        return NULL;
+    }
+
+    get_kernel();
+    return e;
+}
+
+void destroy_ensemble(world_ensemble *e) {
+    free(e->cells[0]);
+    free(e->cells[1]);
+    free(e->sums);
+    free(e);
+}
+
+/*
+ * Kill every cell of every world and start again from generation 0
+ */
+void ensemble_clear(world_ensemble *e) {
+    size_t words = (size_t) (e->ylim + 2) * e->stride;
+
+    memset(e->cells[0], 0, words * sizeof(board_word));
+    memset(e->cells[1], 0, words * sizeof(board_word));
+    e->generation = 0;
+}
+
+int ensemble_cell(world_ensemble *e, unsigned int lane, uint32_t x, uint32_t y) {
+    return (_row(e, e->generation & 1, y)[x + 1] >> lane) & 1;
+}
+
+void ensemble_set_cell(world_ensemble *e, unsigned int lane, uint32_t x, uint32_t y, int alive) {
+    board_word *word = &_row(e, e->generation & 1, y)[x + 1];
+    board_word bit = (board_word) 1 << lane;
+
+    *word = alive ? *word | bit : *word & ~bit;
+}
+
+/*
+ * Copy the current states of a world the size of the ensemble into a
+ * lane, which is then stepped by the ensemble's rule and topology from
+ * the ensemble's generation. Returns 0 if the sizes differ.
+ */
+int ensemble_pack(world_ensemble *e, unsigned int lane, world *w) {
+    if (w->xlim != e->xlim || w->ylim != e->ylim || lane >= ENSEMBLE_LANES) {
+        return 0;
+    }
+    for (uint32_t y = 0; y < w->ylim; ++y) {
+        for (uint32_t x = 0; x < w->xlim; ++x) {
+            size_t c = (size_t) y * w->xlim + x;
+            ensemble_set_cell(e, lane, x, y,
+                    (w->data[c >> IDX_DIV] >> ((c & OFFSET_MASK) * BITS_PER_CELL + 1)) & 1);
+        }
+    }
+    return 1;
+}
+
+/*
+ * Copy a lane into a world the size of the ensemble, as its current and
+ * next states, at the ensemble's generation. Returns 0 if the sizes
+ * differ.
+ */
+int ensemble_unpack(world_ensemble *e, unsigned int lane, world *w) {
+    if (w->xlim != e->xlim || w->ylim != e->ylim || lane >= ENSEMBLE_LANES) {
+        return 0;
+    }
+    for (size_t i = 0; i < w->data_size; ++i) {
+        world_store v = 0;
+        for (size_t j = 0; j < CELLS_PER_ELEM && (i << IDX_DIV) + j < w->cell_count; ++j) {
+            size_t c = (i << IDX_DIV) + j;
+            if (ensemble_cell(e, lane, c % w->xlim, c / w->xlim)) {
+                v |= (world_store) SINGLE_CELL_MASK << (j * BITS_PER_CELL);
+            }
+        }
+        w->data[i] = v;
+    }
+    w->generation = e->generation;
+    w->state = CALC;
+    world_clear_dying(w);
+    world_invalidate(w);
+    return 1;
+}
+
+/*
+ * Step every world of the ensemble by gens generations
+ */
+void ensemble_step(world_ensemble *e, uint32_t gens) {
+    const bitwise_kernel *kn = get_kernel();
+    int life = rule_is_conway(&e->rule);
+    board_slot slots[BOARD_SLOTS];
+
+    for (int s = 0; s < BOARD_SLOTS; ++s) {
+        slots[s].s0 = e->sums + 2 * s * e->xlim;
+        slots[s].s1 = slots[s].s0 + e->xlim;
+    }
+
+    for (uint32_t g = 0; g < gens; ++g) {
+        board_word *curr = e->cells[e->generation & 1],
+                   *next = e->cells[(e->generation + 1) & 1];
+
+        if (e->topology == TORUS) {
+            _wrap(e, curr);
+        }
+        for (size_t r = 0; r <= 1; ++r) {
+            board_slot *slot = &slots[r % BOARD_SLOTS];
+            slot->row = curr + r * e->stride;
+            _lane_sums(slot->row, slot->s0, slot->s1, e->xlim);
+        }
+        for (size_t r = 1; r <= e->ylim; ++r) {
+            board_slot *up = &slots[(r - 1) % BOARD_SLOTS],
+                       *mid = &slots[r % BOARD_SLOTS],
+                       *down = &slots[(r + 1) % BOARD_SLOTS];
+            board_word *out = next + r * e->stride + 1;
+
+            down->row = curr + (r + 1) * e->stride;
+            _lane_sums(down->row, down->s0, down->s1, e->xlim);
+            if (life) {
+                kn->life_row(up, mid, down, out, e->xlim);
+            } else {
+                kn->rule_row(up, mid, down, &e->rule, out, e->xlim);
+            }
+        }
+        e->generation++;
+    }
+}
+
+/*
+ * Lanes with any live cell
+ */
+uint64_t ensemble_alive(world_ensemble *e) {
+    uint64_t alive = 0;
+
+    for (uint32_t y = 0; y < e->ylim; ++y) {
+        const board_word *row = _row(e, e->generation & 1, y);
+        for (uint32_t x = 1; x <= e->xlim; ++x) {
+            alive |= row[x];
+        }
+    }
+    return alive;
+}
+
+uint64_t ensemble_population(world_ensemble *e, unsigned int lane) {
+    uint64_t population = 0;
+
+    for (uint32_t y = 0; y < e->ylim; ++y) {
+        const board_word *row = _row(e, e->generation & 1, y);
+        for (uint32_t x = 1; x <= e->xlim; ++x) {
+            population += (row[x] >> lane) & 1;
+        }
+    }
+    return population;
+}
@@ -0,0 +1,48 @@
+#ifndef _ENSEMBLE_H
+#define _ENSEMBLE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+#include "kernels.h"
+
+// Worlds in an ensemble, one per bit of a board word
+#define ENSEMBLE_LANES BOARD_BITS
+
+/*** TYPES ***/
+
+/*
+ * ENSEMBLE_LANES worlds of the same size, topology and rule, stepped
+ * together: bit k of every word belongs to world k, and word x + 1 of
+ * row y + 1 holds cell (x, y) of all of them. Rows have a guard word on
+ * each side and there is a guard row above and below, dead or wrapped.
+ */
+struct world_ensemble {
+    uint32_t xlim;
+    uint32_t ylim;
+    world_topology topology;
+    life_rule rule;
+    uint32_t generation;
+
+    size_t stride; // words per row, xlim + 2
+    board_word *cells[2]; // by generation parity
+    board_word *sums; // count planes of BOARD_SLOTS rows
+};
+typedef struct world_ensemble world_ensemble;
+
+/*** FUNCTIONS ***/
+
+world_ensemble *init_ensemble(uint32_t xlim, uint32_t ylim, world_topology topology,
+        const life_rule *rule);
+void destroy_ensemble(world_ensemble *e);
+void ensemble_clear(world_ensemble *e);
+int ensemble_cell(world_ensemble *e, unsigned int lane, uint32_t x, uint32_t y);
+void ensemble_set_cell(world_ensemble *e, unsigned int lane, uint32_t x, uint32_t y, int alive);
+int ensemble_pack(world_ensemble *e, unsigned int lane, world *w);
+int ensemble_unpack(world_ensemble *e, unsigned int lane, world *w);
+void ensemble_step(world_ensemble *e, uint32_t gens);
+uint64_t ensemble_alive(world_ensemble *e);
+uint64_t ensemble_population(world_ensemble *e, unsigned int lane);
+
+#endif
+/* vim: set ft=c : */
@@ -64,5 +64,6 @@ void fill(world *w, fill_type fill) {
 
     w->generation = 0;
     w->state = CALC;
+    world_clear_dying(w);
     iter_world(w, f_it);
 }
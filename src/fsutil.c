@@ -1,3 +1,8 @@
+#ifdef __unix__
+#define _POSIX_C_SOURCE 200809L
+#include <unistd.h>
+#endif
+#include <string.h>
 #include "fsutil.h"
 
 char* read_file(const char *filename) {
@@ -15,3 +20,45 @@ char* read_file(const char *filename) {
 
     return data;
 }
+
+/*
+ * Write data to a file next to filename, and rename it over filename once
+ * it is all on disk, so filename is only ever the old file or the new one
+ * whole, however the write ends. Returns 0 if it couldn't be written.
+ */
+int write_file(const char *filename, const char *data, size_t size) {
+    size_t len = strlen(filename);
+    char *tmp = malloc(len + sizeof(FSUTIL_TMP_SUFFIX));
+    FILE *f;
+    int ok;
+
+    if (tmp == NULL) {
+        return 0;
+    }
+    memcpy(tmp, filename, len);
+    memcpy(tmp + len, FSUTIL_TMP_SUFFIX, sizeof(FSUTIL_TMP_SUFFIX));
+
+    f = fopen(tmp, "wb");
+    if (f == NULL) {
+        free(tmp);
+        return 0;
+    }
+    ok = fwrite(data, sizeof(char), size, f) == size && fflush(f) == 0;
+#ifdef __unix__
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = fclose(f) == 0 && ok;
+#ifdef _WIN32
+    // rename doesn't replace an existing file here
+    if (ok) {
+        remove(filename);
+    }
+#endif
+    ok = ok && rename(tmp, filename) == 0;
+    if (!ok) {
+        remove(tmp);
+    }
+
+    free(tmp);
+    return ok;
+}
@@ -4,6 +4,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+// Appended to a file's name while it is being written
+#define FSUTIL_TMP_SUFFIX ".tmp"
+
 char* read_file(const char *filename);
+int write_file(const char *filename, const char *data, size_t size);
 
 #endif
@@ -209,11 +209,17 @@ game* init_game_from_world(world *w) {
     g->d.trans_amount = 0.9;
 
     g->w = w;
+    g->s = NULL;
+    g->rate = (sim_rate) {SIM_PER_SECOND, 60};
+    g->rewind_budget = REWIND_DEFAULT_BUDGET;
+    g->snap = NULL;
+    g->cp = NULL;
+    g->autosave = (checkpoint_interval) {CHECKPOINT_GENERATIONS, 0};
     return g;
 }
 
 game* init_game(size_t xlim, size_t ylim) {
-    world *w = init_world(xlim, ylim);
+    world *w = init_world(xlim, ylim, BOUNDED);
     return init_game_from_world(w);
 }
 
@@ -272,6 +278,17 @@ static void _overlay_static_text(game *g) {
     snprintf(temp_text, o->label_text_max, "World data size: %lu", g->w->data_size * sizeof(world_store));
     _overlay_draw_text(o, temp_text, 1, line++, NULL);
 
+    // Draw tile count
+    snprintf(temp_text, o->label_text_max, "World tiles: %lu",
+            (unsigned long) g->w->tile_cols * g->w->tile_rows);
+    _overlay_draw_text(o, temp_text, 1, line++, NULL);
+
+    // Draw rule
+    char rule[RULE_STRING_LEN];
+    rule_string(&g->w->rule, rule);
+    snprintf(temp_text, o->label_text_max, "Rule: %s", rule);
+    _overlay_draw_text(o, temp_text, 1, line++, NULL);
+
     line = 5;
     // Draw FPS label
     snprintf(temp_text, o->label_text_max, "Avg. FPS: ");
@@ -291,6 +308,26 @@ static void _overlay_static_text(game *g) {
     // Draw sub state label
     snprintf(temp_text, o->label_text_max, "Step: ");
     _overlay_draw_text(o, temp_text, 0, line++, &o->step_loc);
+
+    // Draw active tiles label
+    snprintf(temp_text, o->label_text_max, "Active tiles: ");
+    _overlay_draw_text(o, temp_text, 0, line++, &o->tiles_loc);
+
+    // Draw cycle label
+    snprintf(temp_text, o->label_text_max, "Period: ");
+    _overlay_draw_text(o, temp_text, 0, line++, &o->period_loc);
+
+    // Draw simulation rate label
+    snprintf(temp_text, o->label_text_max, "Steps/s: ");
+    _overlay_draw_text(o, temp_text, 0, line++, &o->rate_loc);
+
+    // Draw population label
+    snprintf(temp_text, o->label_text_max, "Population: ");
+    _overlay_draw_text(o, temp_text, 0, line++, &o->pop_loc);
+
+    // Draw bounding box label
+    snprintf(temp_text, o->label_text_max, "Live box: ");
+    _overlay_draw_text(o, temp_text, 0, line++, &o->box_loc);
 }
 
 static void _update_colors(game *g, int color_scheme) {
@@ -356,7 +393,7 @@ static void _init_overlay(game *g) {
     Uint32 amask = 0x000000ff;
 
     // Overlay stuff
-    o->size = 0.4;
+    o->size = 0.45;
     o->mvp = malloc(sizeof(mat4x4));
     mat4x4_ortho(*o->mvp, -g->aspect, g->aspect, -1.0, 1.0, 0, 10);
 
@@ -468,11 +505,31 @@ static void _destroy_overlay(game *g) {
     SDL_free(g->o.font_text);
 }
 
+/*
+ * Whether a world of xlim by ylim cells can be drawn, see GAME_MAX_CELLS
+ */
+int game_world_fits(uint32_t xlim, uint32_t ylim) {
+    uint64_t cells = (uint64_t) xlim * ylim;
+    return cells <= GAME_MAX_CELLS && cells * 2 * VERTS_PER_TRIANGLE <= SIZE_MAX / sizeof(GLfloat);
+}
+
 static void _init_world_display(game *g) {
+    size_t vcount;
+
+    if (!game_world_fits(g->w->xlim, g->w->ylim)) {
+        fprintf(stderr, "A %lux%lu world is too big to draw, at most %lu cells are\n",
+                (unsigned long) g->w->xlim, (unsigned long) g->w->ylim, (unsigned long) GAME_MAX_CELLS);
+        exit(EXIT_FAILURE);
+    }
     // Triangle has 6 points, each a float
     // Each cell has 2 triangles to make a square
-    g->d.vcount = 2 * VERTS_PER_TRIANGLE * g->w->xlim * g->w->ylim;
-    g->d.vertices = SDL_malloc(g->d.vcount * sizeof(GLfloat));
+    vcount = 2 * VERTS_PER_TRIANGLE * (size_t) g->w->xlim * g->w->ylim;
+    g->d.vcount = (GLsizei) vcount;
+    g->d.vertices = SDL_malloc(vcount * sizeof(GLfloat));
+    if (g->d.vertices == NULL) {
+        fprintf(stderr, "Could not allocate %lu bytes\n", (unsigned long) (vcount * sizeof(GLfloat)));
+        exit(EXIT_FAILURE);
+    }
 }
 
 static void _destroy_world_display(game *g) {
@@ -523,16 +580,14 @@ static inline void _world_coords_to_cell_pos(game *g, world_cell_pos *pos, vec3
     pos->y = (-coords[1] - half_pad + g->d.top) / full_size;
 }
 
+/*
+ * Invert the cell under the cursor, on the simulation thread
+ */
 static inline void _handle_mouse_click(game *g, int win_x, int win_y) {
     vec3 mwc, mnc;
     Ray mouse_ray;
     world_cell_pos pos;
-    pos.w = g->w;
-    pos.cell_val = NULL;
-
-    if (g->w->state == SHIFT) {
-        world_half_step(g->w);
-    }
+    sim_command cmd = {SIM_INVERT, 0, 0, EMPTY, NULL, 0};
 
     _norm_mouse_coords(mnc, win_x, win_y, g->win_w, g->win_h);
     _norm_point_to_ray(g, &mouse_ray, mnc[0], mnc[1]);
@@ -541,7 +596,9 @@ static inline void _handle_mouse_click(game *g, int win_x, int win_y) {
     if (pos.x >= g->w->xlim || pos.y >= g->w->ylim) {
         return;
     }
-    invert_cell(&pos);
+    cmd.x = pos.x;
+    cmd.y = pos.y;
+    sim_command_push(g->s, cmd);
 }
 
 static void _world_vertices(game *g) {
@@ -697,12 +754,21 @@ static inline void _move_camera(game *g, direction d) {
     vec3_add(g->d.center, g->d.center, temp);
 }
 
+static inline size_t _decay_size(world *w) {
+    return (w->data_size + 1) * w->decay_planes * sizeof(world_store);
+}
+
 static inline void _setup_world(game *g) {
     g->d.matrix_id = glGetUniformLocation(g->world_shader, "MVP");
     g->d.colors_id = glGetUniformLocation(g->world_shader, "colors");
     g->d.inv_state_id = glGetUniformLocation(g->world_shader, "inv_state");
     g->d.tex_buff_id = glGetUniformLocation(g->world_shader, "world_texture_buffer");
     g->d.tex_id = 0;
+    g->d.decay_tex_buff_id = glGetUniformLocation(g->world_shader, "decay_texture_buffer");
+    g->d.decay_tex_id = 1;
+    g->d.decay_planes_id = glGetUniformLocation(g->world_shader, "decay_planes");
+    g->d.decay_stride_id = glGetUniformLocation(g->world_shader, "decay_stride");
+    g->d.dying_states_id = glGetUniformLocation(g->world_shader, "dying_states");
 
     // Vertex arrays
     glGenVertexArrays(1, &g->d.vert_array_id);
@@ -717,11 +783,24 @@ static inline void _setup_world(game *g) {
     // World data buffer (texture buffer object)
     glGenBuffers(1, &g->d.data_buffer);
     glBindBuffer(GL_TEXTURE_BUFFER, g->d.data_buffer);
-    glBufferData(GL_TEXTURE_BUFFER, g->w->data_size*sizeof(world_store), g->w->data, GL_DYNAMIC_DRAW);
+    glBufferData(GL_TEXTURE_BUFFER, g->w->data_size*sizeof(world_store), g->snap->w.data, GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+    // Dying planes of a Generations rule, a single empty store otherwise
+    // so the texture is never unbacked
+    glGenBuffers(1, &g->d.decay_buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, g->d.decay_buffer);
+    if (g->w->decay != NULL) {
+        glBufferData(GL_TEXTURE_BUFFER, _decay_size(g->w), g->snap->w.decay, GL_DYNAMIC_DRAW);
+    } else {
+        world_store none = 0;
+        glBufferData(GL_TEXTURE_BUFFER, sizeof(world_store), &none, GL_STATIC_DRAW);
+    }
     glBindBuffer(GL_TEXTURE_BUFFER, 0);
 
-    // World texture
+    // World textures
     glGenTextures(1, &g->d.data_tex);
+    glGenTextures(1, &g->d.decay_tex);
 }
 
 static inline void _render_world(game *g) {
@@ -731,7 +810,10 @@ static inline void _render_world(game *g) {
 
     glUniformMatrix4fv(g->d.matrix_id, 1, GL_FALSE, &g->d.mvp[0][0]);
     glUniform4fv(g->d.colors_id, 5, GET_COL(COLORS_OFFSET));
-    glUniform1ui(g->d.inv_state_id, !g->w->state);
+    glUniform1ui(g->d.inv_state_id, !g->snap->w.state);
+    glUniform1i(g->d.decay_planes_id, g->w->decay != NULL ? g->w->decay_planes : 0);
+    glUniform1i(g->d.decay_stride_id, g->w->data_size + 1);
+    glUniform1ui(g->d.dying_states_id, g->w->rule.states > 2 ? g->w->rule.states - 2 : 1);
 
     glBindBuffer(GL_ARRAY_BUFFER, g->d.vert_buffer);
     glEnableVertexAttribArray(0);
@@ -742,10 +824,17 @@ static inline void _render_world(game *g) {
     glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, g->d.data_buffer);
     glUniform1i(g->d.tex_buff_id, g->d.tex_id);
 
+    glActiveTexture(GL_TEXTURE0 + g->d.decay_tex_id);
+    glBindTexture(GL_TEXTURE_BUFFER, g->d.decay_tex);
+    glTexBuffer(GL_TEXTURE_BUFFER, GL_R32UI, g->d.decay_buffer);
+    glUniform1i(g->d.decay_tex_buff_id, g->d.decay_tex_id);
+
     glDrawArrays(GL_TRIANGLES, 0, g->d.vcount / 2);
 
     glDisableVertexAttribArray(0);
     glBindTexture(GL_TEXTURE_BUFFER, 0);
+    glActiveTexture(GL_TEXTURE0 + g->d.tex_id);
+    glBindTexture(GL_TEXTURE_BUFFER, 0);
     glBindBuffer(GL_ARRAY_BUFFER, 0);
 
     glUseProgram(0);
@@ -783,7 +872,7 @@ static inline void _render_overlay(game *g) {
     _render_overlay_live_text(&g->o, &g->o.fps_loc);
 
     // World generations
-    snprintf(g->o.font_text, g->o.update_text_max + 1, "%8u", g->w->generation);
+    snprintf(g->o.font_text, g->o.update_text_max + 1, "%8u", g->snap->w.generation);
     _render_overlay_live_text(&g->o, &g->o.gen_loc);
 
     // Game state
@@ -795,14 +884,75 @@ static inline void _render_overlay(game *g) {
     snprintf(g->o.font_text, g->o.update_text_max + 1, "%8s",
             GET_STEP_TEXT(g->step));
     _render_overlay_live_text(&g->o, &g->o.step_loc);
+
+    // Tiles calculated in the last step
+    snprintf(g->o.font_text, g->o.update_text_max + 1, "%8lu", (unsigned long) g->snap->w.active_tiles);
+    _render_overlay_live_text(&g->o, &g->o.tiles_loc);
+
+    // Period of the cycle the world ended in
+    if (g->snap->w.cycle.extinct) {
+        snprintf(g->o.font_text, g->o.update_text_max + 1, "%8s", "dead");
+    } else if (g->snap->w.cycle.period > 0) {
+        snprintf(g->o.font_text, g->o.update_text_max + 1, "%8u", g->snap->w.cycle.period);
+    } else {
+        snprintf(g->o.font_text, g->o.update_text_max + 1, "%8s", "-");
+    }
+    _render_overlay_live_text(&g->o, &g->o.period_loc);
+
+    // Steps the simulation thread took in the last second
+    snprintf(g->o.font_text, g->o.update_text_max + 1, "%8.1f", g->snap->rate);
+    _render_overlay_live_text(&g->o, &g->o.rate_loc);
+
+    // Live cells, and the size of the box around them
+    snprintf(g->o.font_text, g->o.update_text_max + 1, "%8llu",
+            (unsigned long long) g->snap->w.stats.population);
+    _render_overlay_live_text(&g->o, &g->o.pop_loc);
+
+    char box[24];
+    snprintf(box, sizeof(box), "%ux%u", g->snap->w.stats.x1 - g->snap->w.stats.x0,
+            g->snap->w.stats.y1 - g->snap->w.stats.y0);
+    snprintf(g->o.font_text, g->o.update_text_max + 1, "%8s", box);
+    _render_overlay_live_text(&g->o, &g->o.box_loc);
 }
 
 static inline void _update_world_buffer(game *g) {
     glBindBuffer(GL_TEXTURE_BUFFER, g->d.data_buffer);
-    glBufferSubData(GL_TEXTURE_BUFFER, 0, g->w->data_size*sizeof(world_store), g->w->data);
+    glBufferSubData(GL_TEXTURE_BUFFER, 0, g->w->data_size*sizeof(world_store), g->snap->w.data);
+    if (g->w->decay != NULL) {
+        glBindBuffer(GL_TEXTURE_BUFFER, g->d.decay_buffer);
+        glBufferSubData(GL_TEXTURE_BUFFER, 0, _decay_size(g->w), g->snap->w.decay);
+    }
     glBindBuffer(GL_TEXTURE_BUFFER, 0);
 }
 
+/*
+ * Hold the newest snapshot instead, returning 1 if it changed
+ */
+static inline int _update_snapshot(game *g) {
+    sim_snapshot *snap = sim_snapshot_acquire(g->s);
+    if (snap->seq == g->snap->seq) {
+        sim_snapshot_release(snap);
+        return 0;
+    }
+    sim_snapshot_release(g->snap);
+    g->snap = snap;
+    return 1;
+}
+
+static inline void _push_command(game *g, sim_command_type type, fill_type fill) {
+    sim_command cmd = {type, 0, 0, fill, NULL, 0};
+    sim_command_push(g->s, cmd);
+}
+
+/*
+ * Go back through the generations kept, on the simulation thread
+ */
+static inline void _rewind(game *g, unsigned int generations) {
+    sim_command cmd = {SIM_REWIND, 0, 0, EMPTY, NULL, generations};
+    g->state = PAUSED;
+    sim_command_push(g->s, cmd);
+}
+
 static inline void _handle_event(game *g, SDL_Event e) {
     if (e.type == SDL_QUIT) {
         g->state = ENDED;
@@ -820,12 +970,12 @@ static inline void _handle_event(game *g, SDL_Event e) {
             case(SDLK_7):
             case(SDLK_8):
             case(SDLK_9):
-                fill(g->w, e.key.keysym.sym - SDLK_0);
+                _push_command(g, SIM_FILL, e.key.keysym.sym - SDLK_0);
                 g->state = PAUSED;
                 break;
 
             case(SDLK_r):
-                fill(g->w, RANDOM);
+                _push_command(g, SIM_FILL, RANDOM);
                 g->state = PAUSED;
                 break;
 
@@ -848,16 +998,34 @@ static inline void _handle_event(game *g, SDL_Event e) {
                         break;
                     }
                     world *dec_w = deserialize_world_b64(clip_text, clip_len);
+                    if (dec_w != NULL && !game_world_fits(dec_w->xlim, dec_w->ylim)) {
+                        printf("Not pasting a %ux%u world, at most %lu cells can be drawn\n",
+                                dec_w->xlim, dec_w->ylim, (unsigned long) GAME_MAX_CELLS);
+                        destroy_world(dec_w);
+                        dec_w = NULL;
+                    }
                     if (dec_w != NULL) {
+                        world *old = sim_replace_world(g->s, dec_w);
+                        // A world the same shape as the last is drawn with
+                        // the same vertices and buffers
+                        int same = old->xlim == dec_w->xlim && old->ylim == dec_w->ylim &&
+                            old->decay_planes == dec_w->decay_planes;
                         printf("Decoded world! %ux%u\n", dec_w->xlim, dec_w->ylim);
-                        free(g->w);
+                        destroy_world(old);
                         g->w = dec_w;
-                        _init_world_display(g);
-                        _world_vertices(g);
-                        _setup_world(g);
-                        _reset_camera(g);
-                        _setup_camera(g);
-                        _update_camera(g);
+                        sim_snapshot_release(g->snap);
+                        g->snap = sim_snapshot_latest(g->s);
+                        if (same) {
+                            _update_world_buffer(g);
+                        } else {
+                            _destroy_world_display(g);
+                            _init_world_display(g);
+                            _world_vertices(g);
+                            _setup_world(g);
+                            _reset_camera(g);
+                            _setup_camera(g);
+                            _update_camera(g);
+                        }
                     }
                     SDL_free(clip_text);
                 } else {
@@ -874,9 +1042,7 @@ static inline void _handle_event(game *g, SDL_Event e) {
                 break;
             // Toggle sub-state
             case(SDLK_h):
-                if (g->w->state != CALC) {
-                    world_half_step(g->w);
-                }
+                _push_command(g, SIM_FINISH_STEP, EMPTY);
                 g->step = g->step == WHOLE ? HALF : WHOLE;
                 break;
             // Change color scheme
@@ -885,7 +1051,9 @@ static inline void _handle_event(game *g, SDL_Event e) {
                     _update_colors(g, g->color_scheme - 1);
                 } else if (e.key.keysym.mod & (KMOD_CTRL|KMOD_CAPS)) {
                     size_t ser_size;
-                    char *enc_world = serialize_world_b64(g->w, &ser_size);
+                    sim_snapshot *snap = sim_snapshot_latest(g->s);
+                    char *enc_world = serialize_world_b64(&snap->w, &ser_size);
+                    sim_snapshot_release(snap);
                     printf("Copying to clipboard: %lu bytes\n", ser_size);
                     if (SDL_SetClipboardText(enc_world) != 0) {
                         printf("SDL_Error: %s\n", SDL_GetError());
@@ -914,9 +1082,9 @@ static inline void _handle_event(game *g, SDL_Event e) {
                 break;
             // Save file
             case(SDLK_x):
-                if (g->filename != NULL) {
+                if (g->cp != NULL) {
                     printf("Saving to file: %s\n", g->filename);
-                    write_to_file(g->filename, g->w, BASE64);
+                    checkpoint_snapshot(g->cp, sim_snapshot_latest(g->s));
                 }
                 break;
         }
@@ -927,7 +1095,11 @@ static inline void _handle_event(game *g, SDL_Event e) {
             // Single step
             case(SDLK_m):
                 g->state = PAUSED;
-                world_half_step(g->w);
+                _push_command(g, SIM_HALF_STEP, EMPTY);
+                break;
+            // Step back, and scrub back while held
+            case(SDLK_b):
+                _rewind(g, e.key.keysym.mod & KMOD_SHIFT ? 100 : 1);
                 break;
             // Translate up
             case(SDLK_w):
@@ -967,6 +1139,12 @@ static inline void _handle_event(game *g, SDL_Event e) {
 }
 
 void start_game(game *g) {
+    g->s = init_sim(g->w, g->rate, g->rewind_budget);
+    g->snap = sim_snapshot_acquire(g->s);
+    if (g->filename != NULL) {
+        g->cp = init_checkpointer(g->filename, g->autosave, g->snap->w.generation);
+    }
+
     _world_vertices(g);
     _setup_world(g);
 
@@ -984,6 +1162,13 @@ void start_game(game *g) {
     size_t count = 0;
 
     while (g->state != ENDED) {
+        // Draw the newest generation the simulation thread has published
+        if (_update_snapshot(g)) {
+            _update_world_buffer(g);
+            if (g->cp != NULL && checkpoint_due(g->cp, g->snap->w.generation)) {
+                checkpoint_snapshot(g->cp, sim_snapshot_acquire(g->s));
+            }
+        }
         _render_world(g);
 
         // Get time since last frame (ms)
@@ -1018,17 +1203,47 @@ void start_game(game *g) {
         // Update camera
         _update_camera(g);
 
-        // Update the world
+        // Let the world run, or not
         ++count;
-        if (g->state == RUNNING) {
-            switch (g->step) {
-                case(WHOLE): world_step(g->w); break;
-                case(HALF): world_half_step(g->w); break;
-            }
-        }
+        sim_set_running(g->s, g->state == RUNNING, g->step == HALF);
+        sim_frame_drawn(g->s);
+    }
 
-        _update_world_buffer(g);
+    // With autosave on, the world is saved as it was left too, and every
+    // save has to be written before the simulation's snapshots go
+    if (g->cp != NULL) {
+        if (g->autosave.every > 0) {
+            checkpoint_snapshot(g->cp, sim_snapshot_latest(g->s));
+        }
+        destroy_checkpointer(g->cp);
+        g->cp = NULL;
     }
+    sim_snapshot_release(g->snap);
+    g->snap = NULL;
+    destroy_sim(g->s);
+    g->s = NULL;
+}
+
+/*
+ * How fast the world is stepped while the game runs, see sim_rate
+ */
+void set_game_rate(game *g, sim_rate rate) {
+    g->rate = rate;
+}
+
+/*
+ * Memory for past generations to go back to, 0 to keep none
+ */
+void set_game_rewind(game *g, size_t budget) {
+    g->rewind_budget = budget;
+}
+
+/*
+ * How often the world is saved to the file it was set up with while the
+ * game runs, see checkpoint_due
+ */
+void set_game_autosave(game *g, checkpoint_interval interval) {
+    g->autosave = interval;
 }
 
 void destroy_game(game *g) {
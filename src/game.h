@@ -3,6 +3,8 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <stdint.h>
+#include <limits.h>
 #ifdef __unix__
 #include <SDL2/SDL.h>
 #include <SDL2/SDL_ttf.h>
@@ -19,11 +21,17 @@
 #include "fsutil.h"
 #include "res_path.h"
 #include "world.h"
+#include "sim.h"
+#include "checkpoint.h"
 #include "linmath.h"
 #include "geom.h"
 #include "fills.h"
 #include "colors.h"
 
+// Cells drawn at most: each is 12 vertex floats, and GL draws up to
+// INT_MAX of them at once
+#define GAME_MAX_CELLS ((uint64_t) INT_MAX / 12)
+
 #define GET_STATE_TEXT(state) state == RUNNING ? "Running" : "Paused"
 #define GET_STEP_TEXT(step) step == WHOLE ? "Whole" : "Half"
 
@@ -101,6 +109,11 @@ struct overlay {
     surf_coord gen_loc;
     surf_coord state_loc;
     surf_coord step_loc;
+    surf_coord tiles_loc;
+    surf_coord period_loc;
+    surf_coord rate_loc;
+    surf_coord pop_loc;
+    surf_coord box_loc;
 };
 typedef struct overlay overlay;
 
@@ -123,11 +136,18 @@ struct world_display {
     GLuint inv_state_id;
     GLuint tex_buff_id;
     GLuint tex_id;
+    GLuint decay_tex_buff_id;
+    GLuint decay_tex_id;
+    GLuint decay_planes_id;
+    GLuint decay_stride_id;
+    GLuint dying_states_id;
 
     GLuint vert_array_id;
     GLuint vert_buffer;
     GLuint data_buffer;
     GLuint data_tex;
+    GLuint decay_buffer;
+    GLuint decay_tex;
 
     mat4x4 view;
     mat4x4 proj;
@@ -159,6 +179,15 @@ typedef struct world_display world_display;
 
 struct game {
     world *w;
+    // Steps w on its own thread while the game runs, and the snapshot
+    // of it being drawn
+    sim *s;
+    sim_rate rate;
+    size_t rewind_budget;
+    sim_snapshot *snap;
+    // Saves to filename in the background, and how often automatically
+    checkpointer *cp;
+    checkpoint_interval autosave;
     overlay o;
     world_display d;
     SDL_Window *win;
@@ -180,9 +209,13 @@ typedef struct game game;
 
 /*** FUNCTIONS ***/
 
+int game_world_fits(uint32_t xlim, uint32_t ylim);
 game *init_game(size_t xlim, size_t ylim);
 game *init_game_from_world(world *w);
 void setup_game(game *g, int width, int height, const char *filename);
+void set_game_rate(game *g, sim_rate rate);
+void set_game_rewind(game *g, size_t budget);
+void set_game_autosave(game *g, checkpoint_interval interval);
 void start_game(game *g);
 void destroy_game(game *g);
 
@@ -0,0 +1,126 @@
+#include <string.h>
+#include "generations.h"
+
+// Stores worked on at a time, each step of which is a plain vector loop
+#define GENERATIONS_BLOCK 64
+
+/*
+ * Generations rules
+ *
+ * The alive plane is world data as usual, and any engine steps it
+ * without knowing about the other states. A dying cell's age (its state
+ * less 1) is a bit-sliced counter over w->decay_planes more planes, each
+ * laid out like the next state bits of world data: a world_store per
+ * store, cell j at bit 2j. That lines every plane up with world data, so
+ * all the cells of a store count at once with no shuffling of bits:
+ *   - after the calculation, the next state bits of dying cells are
+ *     cleared, so they can't be born
+ *   - before the shift, live cells going dead start at age 1, dying
+ *     cells add 1 with a ripple carry, and the ones at the last dying
+ *     state drop to dead
+ * Ages of all zero are dead or alive, as the alive plane says. Bands
+ * never share a store, so they step their own part of every plane.
+ */
+
+static inline world_store *_plane(world *w, unsigned int p) {
+    return w->decay + (size_t) p * (w->data_size + 1);
+}
+
+/*
+ * Planes for the ages 1 to states - 2 of the dying states
+ */
+unsigned int generations_planes(unsigned int states) {
+    unsigned int planes = 0;
+    while (states > 2 && (states - 2) >> planes) {
+        ++planes;
+    }
+    return planes;
+}
+
+/*
+ * Age of the cell at index c, 0 if it isn't dying
+ */
+unsigned int generations_age(world *w, size_t c) {
+    unsigned int age = 0;
+
+    if (w->decay == NULL) {
+        return 0;
+    }
+    for (unsigned int p = 0; p < w->decay_planes; ++p) {
+        age |= ((_plane(w, p)[c >> IDX_DIV] >> (c & OFFSET_MASK) * BITS_PER_CELL) & 1) << p;
+    }
+    return age;
+}
+
+/*
+ * Clear the next states of dying cells in stores [i0, i1). A cell made
+ * alive by an edit is alive, whatever age it still has.
+ */
+void generations_mask(world *w, size_t i0, size_t i1) {
+    world_store dying[GENERATIONS_BLOCK];
+
+    for (size_t i = i0; i < i1; i += GENERATIONS_BLOCK) {
+        size_t n = i1 - i < GENERATIONS_BLOCK ? i1 - i : GENERATIONS_BLOCK;
+
+        memset(dying, 0, sizeof(dying));
+        for (unsigned int p = 0; p < w->decay_planes; ++p) {
+            const world_store *d = _plane(w, p) + i;
+            for (size_t k = 0; k < n; ++k) {
+                dying[k] |= d[k];
+            }
+        }
+        for (size_t k = 0; k < n; ++k) {
+            w->data[i+k] &= ~(dying[k] & ~(w->data[i+k] >> 1));
+        }
+    }
+}
+
+/*
+ * Age the dying cells of stores [i0, i1) by a generation, and start the
+ * cells that die in it. The world must be between its half-steps.
+ */
+void generations_decay(world *w, size_t i0, size_t i1) {
+    world_store any[GENERATIONS_BLOCK], expired[GENERATIONS_BLOCK],
+                carry[GENERATIONS_BLOCK], clear[GENERATIONS_BLOCK], died[GENERATIONS_BLOCK];
+    unsigned int last = w->rule.states - 2;
+
+    for (size_t i = i0; i < i1; i += GENERATIONS_BLOCK) {
+        size_t n = i1 - i < GENERATIONS_BLOCK ? i1 - i : GENERATIONS_BLOCK;
+
+        // Ages equal to last, as a bit-sliced compare
+        for (size_t k = 0; k < n; ++k) {
+            any[k] = 0;
+            expired[k] = NEXT_CELL_MASK;
+        }
+        for (unsigned int p = 0; p < w->decay_planes; ++p) {
+            const world_store *d = _plane(w, p) + i;
+            world_store flip = (last >> p) & 1 ? 0 : ~(world_store) 0;
+            for (size_t k = 0; k < n; ++k) {
+                any[k] |= d[k];
+                expired[k] &= d[k] ^ flip;
+            }
+        }
+
+        for (size_t k = 0; k < n; ++k) {
+            world_store alive = (w->data[i+k] >> 1) & NEXT_CELL_MASK;
+            died[k] = alive & ~w->data[i+k];
+            clear[k] = expired[k] | alive;
+            carry[k] = any[k] & ~clear[k];
+        }
+
+        // Count up the rest
+        for (unsigned int p = 0; p < w->decay_planes; ++p) {
+            world_store *d = _plane(w, p) + i;
+            for (size_t k = 0; k < n; ++k) {
+                world_store t = d[k] & carry[k];
+                d[k] = (d[k] ^ carry[k]) & ~clear[k];
+                carry[k] = t;
+            }
+        }
+
+        world_store *d = _plane(w, 0) + i;
+        for (size_t k = 0; k < n; ++k) {
+            d[k] |= died[k];
+        }
+    }
+}
@@ -0,0 +1,16 @@
+#ifndef _GENERATIONS_H
+#define _GENERATIONS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+
+/*** FUNCTIONS ***/
+
+unsigned int generations_planes(unsigned int states);
+unsigned int generations_age(world *w, size_t c);
+void generations_mask(world *w, size_t i0, size_t i1);
+void generations_decay(world *w, size_t i0, size_t i1);
+
+#endif
+/* vim: set ft=c : */
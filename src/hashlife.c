@@ -0,0 +1,676 @@
+#include <string.h>
+#include "hashlife.h"
+
+/*
+ * HashLife: the world as a quadtree of hash-consed nodes, where the
+ * result of every node is memoised. Repeated structure in space and time
+ * is then only ever calculated once, so patterns like guns can be
+ * advanced by huge numbers of generations.
+ *
+ * Unlike world, the plane is unbounded. As the "hashlife" engine, a world
+ * is a window onto it, and cells are only dropped when the world is
+ * edited and taken in as the whole pattern again. Empty space has to
+ * stay empty, so B0 rules can't be used.
+ *
+ * Memory is bounded by max_nodes. If a step runs out of nodes it is
+ * abandoned, everything not reachable from the root is collected, and the
+ * step is retried, as two half-size steps if need be.
+ */
+
+#define HL_BLOCK_NODES 4096
+#define HL_MIN_BUCKETS 4096
+#define HL_MIN_LEVEL 3
+#define HL_FREE 0xff
+
+static inline size_t _hash(const hl_node *nw, const hl_node *ne, const hl_node *sw, const hl_node *se) {
+    uint64_t h = (uintptr_t) nw;
+    h = h * 0x9e3779b97f4a7c15ull + (uintptr_t) ne;
+    h = h * 0x9e3779b97f4a7c15ull + (uintptr_t) sw;
+    h = h * 0x9e3779b97f4a7c15ull + (uintptr_t) se;
+    return h ^ (h >> 32);
+}
+
+static inline void _insert(hashlife *hl, hl_node *n) {
+    size_t h = _hash(n->nw, n->ne, n->sw, n->se) & (hl->buckets - 1);
+    n->next = hl->table[h];
+    hl->table[h] = n;
+}
+
+static void _rehash(hashlife *hl, size_t buckets) {
+    hl_node **old = hl->table;
+    size_t old_buckets = hl->buckets;
+
+    hl->table = calloc(buckets, sizeof(hl_node *));
+    if (hl->table == NULL) {
+        // Longer chains are better than no table
+        hl->table = old;
+        hl->max_buckets = old_buckets;
+        return;
+    }
+    hl->buckets = buckets;
+    for (size_t i = 0; i < old_buckets; ++i) {
+        for (hl_node *n = old[i], *next; n != NULL; n = next) {
+            next = n->next;
+            _insert(hl, n);
+        }
+    }
+    free(old);
+}
+
+static hl_node *_alloc_node(hashlife *hl) {
+    hl_node *n;
+
+    if (hl->free_nodes == NULL) {
+        hl_node **blocks;
+        hl_node *block;
+
+        if ((hl->block_count + 1) * HL_BLOCK_NODES > hl->max_nodes) {
+            return NULL;
+        }
+        block = malloc(HL_BLOCK_NODES * sizeof(hl_node));
+        blocks = realloc(hl->blocks, (hl->block_count + 1) * sizeof(hl_node *));
+        if (block == NULL || blocks == NULL) {
+            free(block);
+            hl->blocks = blocks != NULL ? blocks : hl->blocks;
+            return NULL;
+        }
+        hl->blocks = blocks;
+        hl->blocks[hl->block_count++] = block;
+
+        for (size_t i = 0; i < HL_BLOCK_NODES; ++i) {
+            block[i].level = HL_FREE;
+            block[i].next = hl->free_nodes;
+            hl->free_nodes = &block[i];
+        }
+    }
+
+    n = hl->free_nodes;
+    hl->free_nodes = n->next;
+    return n;
+}
+
+/*
+ * The canonical node with these quadrants. Returns NULL if any of them is
+ * NULL, or if the node cap is reached, so failures fall through.
+ */
+static hl_node *_find(hashlife *hl, hl_node *nw, hl_node *ne, hl_node *sw, hl_node *se) {
+    hl_node *n;
+    size_t h;
+
+    if (nw == NULL || ne == NULL || sw == NULL || se == NULL) {
+        return NULL;
+    }
+
+    h = _hash(nw, ne, sw, se) & (hl->buckets - 1);
+    for (n = hl->table[h]; n != NULL; n = n->next) {
+        if (n->nw == nw && n->ne == ne && n->sw == sw && n->se == se) {
+            return n;
+        }
+    }
+
+    n = _alloc_node(hl);
+    if (n == NULL) {
+        return NULL;
+    }
+    n->nw = nw;
+    n->ne = ne;
+    n->sw = sw;
+    n->se = se;
+    n->result = NULL;
+    n->pop = nw->pop + ne->pop + sw->pop + se->pop;
+    n->level = nw->level + 1;
+    n->mark = 0;
+    n->next = hl->table[h];
+    hl->table[h] = n;
+
+    if (++hl->nodes > hl->buckets && hl->buckets < hl->max_buckets) {
+        _rehash(hl, hl->buckets * 2);
+    }
+    return n;
+}
+
+static hl_node *_empty(hashlife *hl, unsigned int level) {
+    if (hl->empty[level] == NULL) {
+        hl_node *e = _empty(hl, level - 1);
+        hl->empty[level] = _find(hl, e, e, e, e);
+    }
+    return hl->empty[level];
+}
+
+static inline hl_node *_centre(hashlife *hl, hl_node *n) {
+    if (n == NULL) {
+        return NULL;
+    }
+    return _find(hl, n->nw->se, n->ne->sw, n->sw->ne, n->se->nw);
+}
+
+/*
+ * The centre 2x2 of a 4x4 node after one generation
+ */
+static hl_node *_base_result(hashlife *hl, hl_node *n) {
+    uint8_t cells[4][4], next[2][2];
+    hl_node *q[2][2] = { { n->nw, n->ne }, { n->sw, n->se } };
+
+    for (int y = 0; y < 4; ++y) {
+        for (int x = 0; x < 4; ++x) {
+            hl_node *c = q[y / 2][x / 2];
+            hl_node *cell = (y & 1) ? ((x & 1) ? c->se : c->sw) : ((x & 1) ? c->ne : c->nw);
+            cells[y][x] = cell->pop;
+        }
+    }
+
+    // The world's rule, by its table so rules that aren't totalistic work
+    for (int y = 1; y < 3; ++y) {
+        for (int x = 1; x < 3; ++x) {
+            unsigned int idx = 0;
+            for (int n = 0; n < 9; ++n) {
+                idx |= (unsigned int) cells[y + n / 3 - 1][x + n % 3 - 1] << n;
+            }
+            next[y - 1][x - 1] = rule_lookup(&hl->rule, idx);
+        }
+    }
+
+    return _find(hl, &hl->leaf[next[0][0]], &hl->leaf[next[0][1]],
+            &hl->leaf[next[1][0]], &hl->leaf[next[1][1]]);
+}
+
+/*
+ * The centre half of n, 2^step generations later. A node of level L can
+ * be advanced by at most 2^(L-2) generations; the nine overlapping
+ * subnodes are advanced first if that is the step, else just trimmed.
+ */
+static hl_node *_result(hashlife *hl, hl_node *n) {
+    hl_node *n00, *n01, *n02, *n10, *n11, *n12, *n20, *n21, *n22;
+    hl_node *(*first)(hashlife *, hl_node *);
+    hl_node *r;
+
+    if (n == NULL) {
+        return NULL;
+    }
+    if (n->pop == 0) {
+        return _empty(hl, n->level - 1);
+    }
+    if (n->result != NULL) {
+        return n->result;
+    }
+    if (n->level == 2) {
+        return n->result = _base_result(hl, n);
+    }
+
+    first = hl->step >= n->level - 2 ? _result : _centre;
+
+    n00 = first(hl, n->nw);
+    n01 = first(hl, _find(hl, n->nw->ne, n->ne->nw, n->nw->se, n->ne->sw));
+    n02 = first(hl, n->ne);
+    n10 = first(hl, _find(hl, n->nw->sw, n->nw->se, n->sw->nw, n->sw->ne));
+    n11 = first(hl, _centre(hl, n));
+    n12 = first(hl, _find(hl, n->ne->sw, n->ne->se, n->se->nw, n->se->ne));
+    n20 = first(hl, n->sw);
+    n21 = first(hl, _find(hl, n->sw->ne, n->se->nw, n->sw->se, n->se->sw));
+    n22 = first(hl, n->se);
+
+    r = _find(hl,
+            _result(hl, _find(hl, n00, n01, n10, n11)),
+            _result(hl, _find(hl, n01, n02, n11, n12)),
+            _result(hl, _find(hl, n10, n11, n20, n21)),
+            _result(hl, _find(hl, n11, n12, n21, n22)));
+    n->result = r;
+    return r;
+}
+
+static void _clear_results(hashlife *hl) {
+    for (size_t b = 0; b < hl->block_count; ++b) {
+        for (size_t i = 0; i < HL_BLOCK_NODES; ++i) {
+            hl->blocks[b][i].result = NULL;
+        }
+    }
+}
+
+static void _mark(hl_node *n, int results) {
+    if (n == NULL || n->level == 0 || n->mark) {
+        return;
+    }
+    n->mark = 1;
+    _mark(n->nw, results);
+    _mark(n->ne, results);
+    _mark(n->sw, results);
+    _mark(n->se, results);
+    if (results) {
+        _mark(n->result, results);
+    }
+}
+
+/*
+ * Free every node that isn't part of the root, the empty nodes, or (if
+ * results is set) a memoised result of one of those
+ */
+static void _collect(hashlife *hl, int results) {
+    _mark(hl->root, results);
+    for (int l = 1; l <= HL_MAX_LEVEL; ++l) {
+        _mark(hl->empty[l], results);
+    }
+
+    memset(hl->table, 0, hl->buckets * sizeof(hl_node *));
+    hl->free_nodes = NULL;
+    hl->nodes = 0;
+    for (size_t b = 0; b < hl->block_count; ++b) {
+        for (size_t i = 0; i < HL_BLOCK_NODES; ++i) {
+            hl_node *n = &hl->blocks[b][i];
+            if (n->level != HL_FREE && n->mark) {
+                n->mark = 0;
+                if (!results) {
+                    n->result = NULL;
+                }
+                _insert(hl, n);
+                hl->nodes++;
+            } else {
+                n->level = HL_FREE;
+                n->next = hl->free_nodes;
+                hl->free_nodes = n;
+            }
+        }
+    }
+}
+
+hashlife *init_hashlife(size_t max_bytes) {
+    hashlife *hl = malloc(sizeof(hashlife));
+
+    // Every node may also need a bucket
+    hl->max_nodes = max_bytes / (sizeof(hl_node) + sizeof(hl_node *));
+    hl->max_buckets = HL_MIN_BUCKETS;
+    while (hl->max_buckets * 2 <= hl->max_nodes) {
+        hl->max_buckets *= 2;
+    }
+    hl->buckets = HL_MIN_BUCKETS;
+    hl->table = calloc(hl->buckets, sizeof(hl_node *));
+
+    hl->blocks = NULL;
+    hl->block_count = 0;
+    hl->free_nodes = NULL;
+    hl->nodes = 0;
+
+    for (int i = 0; i < 2; ++i) {
+        memset(&hl->leaf[i], 0, sizeof(hl_node));
+        hl->leaf[i].pop = i;
+    }
+    memset(hl->empty, 0, sizeof(hl->empty));
+    hl->empty[0] = &hl->leaf[0];
+
+    hl->root = NULL;
+    hl->x0 = 0;
+    hl->y0 = 0;
+    hl->generation = 0;
+    hl->step = -1;
+    hl->rule = make_rule(CONWAY_BIRTH, CONWAY_SURVIVE);
+    return hl;
+}
+
+void destroy_hashlife(hashlife *hl) {
+    for (size_t b = 0; b < hl->block_count; ++b) {
+        free(hl->blocks[b]);
+    }
+    free(hl->blocks);
+    free(hl->table);
+    free(hl);
+}
+
+static hl_node *_from_world(hashlife *hl, world *w, uint32_t x, uint32_t y, unsigned int level) {
+    uint32_t half;
+
+    if (x >= w->xlim || y >= w->ylim) {
+        return _empty(hl, level);
+    }
+    if (level == 0) {
+        size_t c = (size_t) y * w->xlim + x;
+        return &hl->leaf[(w->data[c >> IDX_DIV] >> ((c & OFFSET_MASK) * BITS_PER_CELL + 1)) & 1];
+    }
+
+    half = (uint32_t) 1 << (level - 1);
+    return _find(hl,
+            _from_world(hl, w, x, y, level - 1),
+            _from_world(hl, w, x + half, y, level - 1),
+            _from_world(hl, w, x, y + half, level - 1),
+            _from_world(hl, w, x + half, y + half, level - 1));
+}
+
+/*
+ * Replace the pattern with the current state of a world, placed with its
+ * top left cell at (0, 0), and take its rule. Returns 0 if it doesn't
+ * fit in memory.
+ */
+int hashlife_from_world(hashlife *hl, world *w) {
+    unsigned int level = HL_MIN_LEVEL;
+    hl_node *root;
+
+    while (((uint64_t) 1 << level) < w->xlim || ((uint64_t) 1 << level) < w->ylim) {
+        level++;
+    }
+
+    hl->root = NULL;
+    _collect(hl, 0);
+    root = _from_world(hl, w, 0, 0, level);
+    if (root == NULL) {
+        return 0;
+    }
+
+    hl->root = root;
+    hl->x0 = 0;
+    hl->y0 = 0;
+    hl->generation = w->generation;
+
+    // Results of the old rule are no use
+    if (!rule_equal(&hl->rule, &w->rule)) {
+        hl->rule = w->rule;
+        hl->step = -1;
+    }
+    return 1;
+}
+
+static void _export(hl_node *n, int64_t x, int64_t y, uint32_t xlim, uint32_t ylim,
+        world_store *data) {
+    int64_t size = (int64_t) 1 << n->level;
+
+    if (n->pop == 0 || x >= xlim || y >= ylim || x + size <= 0 || y + size <= 0) {
+        return;
+    }
+    if (n->level == 0) {
+        size_t c = (size_t) y * xlim + x;
+        data[c >> IDX_DIV] |= (world_store) SINGLE_CELL_MASK << ((c & OFFSET_MASK) * BITS_PER_CELL);
+        return;
+    }
+
+    size /= 2;
+    _export(n->nw, x, y, xlim, ylim, data);
+    _export(n->ne, x + size, y, xlim, ylim, data);
+    _export(n->sw, x, y + size, xlim, ylim, data);
+    _export(n->se, x + size, y + size, xlim, ylim, data);
+}
+
+/*
+ * Set both state bits of the live cells of the xlim by ylim region with
+ * its top left cell at (x0, y0) in data, laid out like world data
+ */
+void hashlife_export(hashlife *hl, int64_t x0, int64_t y0, uint32_t xlim, uint32_t ylim,
+        world_store *data) {
+    if (hl->root != NULL) {
+        _export(hl->root, hl->x0 - x0, hl->y0 - y0, xlim, ylim, data);
+    }
+}
+
+/*
+ * Whether the cell at (x, y) is alive
+ */
+int hashlife_get_cell(hashlife *hl, int64_t x, int64_t y) {
+    hl_node *n = hl->root;
+
+    if (n == NULL) {
+        return 0;
+    }
+    x -= hl->x0;
+    y -= hl->y0;
+    if (x < 0 || y < 0 || x >= (int64_t) 1 << n->level || y >= (int64_t) 1 << n->level) {
+        return 0;
+    }
+    while (n->level > 0 && n->pop > 0) {
+        int64_t half = (int64_t) 1 << (n->level - 1);
+        int east = x >= half, south = y >= half;
+
+        n = south ? (east ? n->se : n->sw) : (east ? n->ne : n->nw);
+        x -= east ? half : 0;
+        y -= south ? half : 0;
+    }
+    return n->pop > 0;
+}
+
+static hl_node *_set(hashlife *hl, hl_node *n, int64_t x, int64_t y, int alive) {
+    int64_t half;
+
+    if (n->level == 0) {
+        return &hl->leaf[alive != 0];
+    }
+    half = (int64_t) 1 << (n->level - 1);
+    if (y < half) {
+        return x < half ?
+            _find(hl, _set(hl, n->nw, x, y, alive), n->ne, n->sw, n->se) :
+            _find(hl, n->nw, _set(hl, n->ne, x - half, y, alive), n->sw, n->se);
+    }
+    return x < half ?
+        _find(hl, n->nw, n->ne, _set(hl, n->sw, x, y - half, alive), n->se) :
+        _find(hl, n->nw, n->ne, n->sw, _set(hl, n->se, x - half, y - half, alive));
+}
+
+/*
+ * Make the cell at (x, y) alive or dead, growing the pattern to hold it.
+ * Returns 0, leaving the pattern as it was, if that doesn't fit in
+ * memory.
+ */
+int hashlife_set_cell(hashlife *hl, int64_t x, int64_t y, int alive) {
+    hl_node *root = hl->root, *e;
+    int64_t x0 = hl->x0, y0 = hl->y0, half;
+
+    if (root == NULL) {
+        return 0;
+    }
+    while (x < x0 || y < y0 || x - x0 >= (int64_t) 1 << root->level ||
+            y - y0 >= (int64_t) 1 << root->level) {
+        if (root->level >= HL_MAX_LEVEL) {
+            return 0;
+        }
+        half = (int64_t) 1 << (root->level - 1);
+        e = _empty(hl, root->level - 1);
+        root = _find(hl,
+                _find(hl, e, e, e, root->nw),
+                _find(hl, e, e, root->ne, e),
+                _find(hl, e, root->sw, e, e),
+                _find(hl, root->se, e, e, e));
+        if (root == NULL) {
+            return 0;
+        }
+        x0 -= half;
+        y0 -= half;
+    }
+
+    root = _set(hl, root, x - x0, y - y0, alive);
+    if (root == NULL) {
+        return 0;
+    }
+    hl->root = root;
+    hl->x0 = x0;
+    hl->y0 = y0;
+    return 1;
+}
+
+/*
+ * Live cells only in the middle quarter, and in the middle half
+ */
+static inline int _in_middle_quarter(hl_node *n) {
+    return n->pop == n->nw->se->se->pop + n->ne->sw->sw->pop + n->sw->ne->ne->pop + n->se->nw->nw->pop;
+}
+
+static inline int _in_middle_half(hl_node *n) {
+    return n->pop == n->nw->se->pop + n->ne->sw->pop + n->sw->ne->pop + n->se->nw->pop;
+}
+
+static int _step(hashlife *hl, unsigned int k) {
+    hl_node *root = hl->root, *next, *e;
+    int64_t x0 = hl->x0, y0 = hl->y0, half;
+
+    if ((int) k != hl->step) {
+        _clear_results(hl);
+        hl->step = k;
+    }
+
+    // Pad until the root is big enough for the step and nothing can
+    // reach the edge of the result in that time
+    while (root->level < k + 3 || !_in_middle_quarter(root)) {
+        if (root->level >= HL_MAX_LEVEL) {
+            return 0;
+        }
+        half = (int64_t) 1 << (root->level - 1);
+        e = _empty(hl, root->level - 1);
+        root = _find(hl,
+                _find(hl, e, e, e, root->nw),
+                _find(hl, e, e, root->ne, e),
+                _find(hl, e, root->sw, e, e),
+                _find(hl, root->se, e, e, e));
+        if (root == NULL) {
+            return 0;
+        }
+        x0 -= half;
+        y0 -= half;
+    }
+
+    next = _result(hl, root);
+    if (next == NULL) {
+        return 0;
+    }
+    x0 += (int64_t) 1 << (root->level - 2);
+    y0 += (int64_t) 1 << (root->level - 2);
+
+    // Trim empty space so the next step starts small
+    while (next->level > HL_MIN_LEVEL && _in_middle_half(next)) {
+        hl_node *c = _centre(hl, next);
+        if (c == NULL) {
+            break;
+        }
+        x0 += (int64_t) 1 << (next->level - 2);
+        y0 += (int64_t) 1 << (next->level - 2);
+        next = c;
+    }
+
+    hl->root = next;
+    hl->x0 = x0;
+    hl->y0 = y0;
+    hl->generation += (uint64_t) 1 << k;
+    return 1;
+}
+
+/*
+ * Advance the pattern by 2^k generations. Returns 0 if that can't be done
+ * within the memory cap; the pattern may then have been advanced part of
+ * the way, which hl->generation shows.
+ */
+int hashlife_step(hashlife *hl, unsigned int k) {
+    if (hl->root == NULL || k > HL_MAX_STEP) {
+        return 0;
+    }
+
+    if (hl->nodes > hl->max_nodes / 2) {
+        _collect(hl, 1);
+        if (hl->nodes > hl->max_nodes / 2) {
+            _collect(hl, 0);
+        }
+    }
+    if (_step(hl, k)) {
+        return 1;
+    }
+
+    // Out of nodes: start again from a clean cache, then in halves
+    _collect(hl, 0);
+    if (_step(hl, k)) {
+        return 1;
+    }
+    return k > 0 && hashlife_step(hl, k - 1) && hashlife_step(hl, k - 1);
+}
+
+uint64_t hashlife_population(hashlife *hl) {
+    return hl->root != NULL ? hl->root->pop : 0;
+}
+
+size_t hashlife_memory(hashlife *hl) {
+    return hl->block_count * HL_BLOCK_NODES * sizeof(hl_node) + hl->buckets * sizeof(hl_node *);
+}
+
+static size_t default_memory = HL_DEFAULT_MEMORY;
+
+/*
+ * Memory cap of the hashlife engine, for worlds created or switched to
+ * it from now on
+ */
+void set_default_hashlife_memory(size_t max_bytes) {
+    default_memory = max_bytes;
+}
+
+static void _init_hashlife(world *w) {
+    w->engine_data = init_hashlife(default_memory);
+}
+
+static void _destroy_hashlife(world *w) {
+    destroy_hashlife(w->engine_data);
+}
+
+/*
+ * The world is a window onto the pattern at (0, 0). Taking it in when it
+ * was edited makes it the whole pattern, so the cells outside of it go.
+ */
+static void _take_window(world *w) {
+    hashlife *hl = w->engine_data;
+
+    if ((w->edited || !rule_equal(&hl->rule, &w->rule)) && !hashlife_from_world(hl, w)) {
+        fputs("World doesn't fit in the HashLife memory cap\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void _step_hashlife(hashlife *hl, unsigned int k) {
+    if (!hashlife_step(hl, k)) {
+        fprintf(stderr, "Ran out of HashLife memory at generation %llu\n",
+                (unsigned long long) hl->generation);
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void _calc_hashlife(world *w) {
+    _take_window(w);
+    _step_hashlife(w->engine_data, 0);
+}
+
+/*
+ * A power of two at a time, as long as the generation stays within what
+ * worlds count
+ */
+static int _step_n_hashlife(world *w, unsigned int n) {
+    hashlife *hl = w->engine_data;
+
+    if ((uint64_t) w->generation + n > UINT32_MAX) {
+        return 0;
+    }
+    _take_window(w);
+    for (unsigned int k = 0; k < 32 && (n >> k) > 0; ++k) {
+        if ((n >> k) & 1) {
+            _step_hashlife(hl, k);
+        }
+    }
+    world_take_pattern(w, (uint32_t) hl->generation);
+    return 1;
+}
+
+static void _report_hashlife(world *w, FILE *out) {
+    (void) w;
+    fprintf(out, "HashLife memory cap: %lu MiB\n", (unsigned long) (default_memory >> 20));
+}
+
+static int _get_cell_hashlife(world *w, int64_t x, int64_t y) {
+    return hashlife_get_cell(w->engine_data, x, y);
+}
+
+static int _set_cell_hashlife(world *w, int64_t x, int64_t y, int alive) {
+    return hashlife_set_cell(w->engine_data, x, y, alive);
+}
+
+static void _export_hashlife(world *w, int64_t x0, int64_t y0, uint32_t xlim, uint32_t ylim,
+        world_store *data) {
+    hashlife_export(w->engine_data, x0, y0, xlim, ylim, data);
+}
+
+static void _stats_hashlife(world *w, engine_stats *stats) {
+    stats->population = hashlife_population(w->engine_data);
+    stats->memory = hashlife_memory(w->engine_data);
+}
+
+const world_engine_ops HASHLIFE_ENGINE = {
+    "hashlife", "Unbounded plane as a memoised quadtree, fastest for long jumps",
+    _calc_hashlife, _init_hashlife, _step_n_hashlife, _report_hashlife, _destroy_hashlife,
+    engine_refuses_unbounded, _get_cell_hashlife, _set_cell_hashlife, _export_hashlife,
+    _stats_hashlife, NULL
+};
@@ -0,0 +1,85 @@
+#ifndef _HASHLIFE_H
+#define _HASHLIFE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+#include "engine.h"
+
+// Largest tree level, and largest k for hashlife_step
+#define HL_MAX_LEVEL 60
+#define HL_MAX_STEP (HL_MAX_LEVEL - 4)
+// Largest jump into a world: steps of up to 2^HL_MAX_STEP, and no
+// further than the 32-bit generations worlds count
+#define HL_MAX_JUMP (HL_MAX_STEP >= 31 ? (uint64_t) UINT32_MAX : ((uint64_t) 2 << HL_MAX_STEP) - 1)
+#define HL_DEFAULT_MEMORY ((size_t) 256 << 20)
+
+/*** TYPES ***/
+
+/*
+ * A 2^level square of cells. Level 0 nodes are single cells, the others
+ * are made of four nodes one level down. Nodes are hash-consed, so equal
+ * squares are the same node and never change once made.
+ *
+ * result is the centre half of the square, advanced by the current step
+ * (see hashlife_step), once it has been calculated.
+ */
+struct hl_node {
+    struct hl_node *nw;
+    struct hl_node *ne;
+    struct hl_node *sw;
+    struct hl_node *se;
+    struct hl_node *result;
+    struct hl_node *next;
+    uint64_t pop;
+    uint8_t level;
+    uint8_t mark;
+};
+typedef struct hl_node hl_node;
+
+struct hashlife {
+    // Node hash table, chained through hl_node.next
+    hl_node **table;
+    size_t buckets;
+    size_t max_buckets;
+
+    // Nodes are allocated in blocks, never more than max_nodes
+    hl_node **blocks;
+    size_t block_count;
+    hl_node *free_nodes;
+    size_t nodes;
+    size_t max_nodes;
+
+    hl_node leaf[2];
+    hl_node *empty[HL_MAX_LEVEL + 1];
+
+    // The pattern, with its top left cell at (x0, y0) in world coordinates
+    hl_node *root;
+    int64_t x0;
+    int64_t y0;
+    uint64_t generation;
+    int step;
+    life_rule rule;
+};
+typedef struct hashlife hashlife;
+
+/*** FUNCTIONS ***/
+
+// Registered as the "hashlife" engine
+extern const world_engine_ops HASHLIFE_ENGINE;
+
+void set_default_hashlife_memory(size_t max_bytes);
+
+hashlife *init_hashlife(size_t max_bytes);
+void destroy_hashlife(hashlife *hl);
+int hashlife_from_world(hashlife *hl, world *w);
+void hashlife_export(hashlife *hl, int64_t x0, int64_t y0, uint32_t xlim, uint32_t ylim,
+        world_store *data);
+int hashlife_get_cell(hashlife *hl, int64_t x, int64_t y);
+int hashlife_set_cell(hashlife *hl, int64_t x, int64_t y, int alive);
+int hashlife_step(hashlife *hl, unsigned int k);
+uint64_t hashlife_population(hashlife *hl);
+size_t hashlife_memory(hashlife *hl);
+
+#endif
+/* vim: set ft=c : */
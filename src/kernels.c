@@ -0,0 +1,135 @@
+#include <string.h>
+#include "kernels.h"
+
+#if defined(_MSC_VER) && defined(HAVE_X86_KERNELS)
+#include <intrin.h>
+#include <immintrin.h>
+#endif
+
+static void _scalar_gather(const world_store *data, board_word *lin, size_t n) {
+    _gather_from(data, lin, 0, n);
+}
+
+static void _scalar_scatter(const board_word *lin, world_store *data, size_t n) {
+    _scatter_from(lin, data, 0, n);
+}
+
+static void _scalar_row_sums(const board_word *row, board_word *s0, board_word *s1, size_t words) {
+    _row_sums_from(row, s0, s1, 0, words);
+}
+
+static void _scalar_life_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        board_word *out, size_t words) {
+    _life_row_from(up, mid, down, out, 0, words);
+}
+
+static void _scalar_rule_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t words) {
+    _rule_row_from(up, mid, down, rule, out, 0, words);
+}
+
+static void _scalar_table_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t words) {
+    _table_row_from(up, mid, down, rule, out, 0, words);
+}
+
+static void _scalar_shift(world_store *data, size_t start, size_t end, shift_sums *sums) {
+    _shift_from(data, start, end, sums, 0);
+}
+
+static const bitwise_kernel SCALAR_KERNEL = {
+    "scalar",
+    _scalar_gather,
+    _scalar_scatter,
+    _scalar_row_sums,
+    _scalar_life_row,
+    _scalar_rule_row,
+    _scalar_table_row,
+    _scalar_shift,
+};
+
+static const bitwise_kernel *kernel = NULL;
+
+#ifdef HAVE_X86_KERNELS
+#ifdef _MSC_VER
+static int _cpu_has(const char *feature) {
+    int regs[4];
+    unsigned long long xcr0 = 0;
+
+    __cpuid(regs, 1);
+    int sse42 = (regs[2] >> 20) & 1;
+    int osxsave = (regs[2] >> 27) & 1;
+    if (osxsave) {
+        xcr0 = _xgetbv(0);
+    }
+
+    __cpuidex(regs, 7, 0);
+    // The OS has to save the YMM (and ZMM) state for us to use them
+    int avx2 = ((regs[1] >> 5) & 1) && (xcr0 & 0x6) == 0x6;
+    int avx512f = ((regs[1] >> 16) & 1) && (xcr0 & 0xe6) == 0xe6;
+
+    if (strcmp(feature, "sse4.2") == 0) return sse42;
+    if (strcmp(feature, "avx2") == 0) return avx2;
+    if (strcmp(feature, "avx512f") == 0) return avx512f;
+    return 0;
+}
+#define CPU_HAS(feature) _cpu_has(feature)
+#else
+#define CPU_HAS(feature) __builtin_cpu_supports(feature)
+#endif
+#endif
+
+/*
+ * Widest kernel the CPU we're running on supports
+ */
+static const bitwise_kernel *_detect_kernel(void) {
+#ifdef HAVE_X86_KERNELS
+#ifndef _MSC_VER
+    __builtin_cpu_init();
+#endif
+    if (CPU_HAS("avx512f")) {
+        return &AVX512_KERNEL;
+    }
+    if (CPU_HAS("avx2")) {
+        return &AVX2_KERNEL;
+    }
+    if (CPU_HAS("sse4.2")) {
+        return &SSE42_KERNEL;
+    }
+#endif
+    return &SCALAR_KERNEL;
+}
+
+const bitwise_kernel *get_kernel(void) {
+    if (kernel == NULL) {
+        kernel = _detect_kernel();
+    }
+    return kernel;
+}
+
+/*
+ * Force a kernel by name. Returns 0 if the kernel is unknown or the CPU
+ * doesn't support it, keeping the current kernel.
+ */
+int set_kernel(const char *name) {
+    const bitwise_kernel *k = NULL;
+
+    if (strcmp(name, SCALAR_KERNEL.name) == 0) {
+        k = &SCALAR_KERNEL;
+    }
+#ifdef HAVE_X86_KERNELS
+    else if (strcmp(name, SSE42_KERNEL.name) == 0 && CPU_HAS("sse4.2")) {
+        k = &SSE42_KERNEL;
+    } else if (strcmp(name, AVX2_KERNEL.name) == 0 && CPU_HAS("avx2")) {
+        k = &AVX2_KERNEL;
+    } else if (strcmp(name, AVX512_KERNEL.name) == 0 && CPU_HAS("avx512f")) {
+        k = &AVX512_KERNEL;
+    }
+#endif
+
+    if (k == NULL) {
+        return 0;
+    }
+    kernel = k;
+    return 1;
+}
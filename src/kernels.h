@@ -0,0 +1,317 @@
+#ifndef _KERNELS_H
+#define _KERNELS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+#include "rules.h"
+#include "cycle.h"
+#include "stats.h"
+
+#define BOARD_BITS 64
+#define STORE_CELLS_PER_WORD (BOARD_BITS / CELLS_PER_ELEM)
+
+/*** TYPES ***/
+
+typedef uint64_t board_word;
+
+/*
+ * One board row and its three-cell count planes (count = s0 + 2*s1).
+ * row has a guard word on each side: row[0] and row[words+1].
+ */
+struct board_slot {
+    board_word *row;
+    board_word *s0;
+    board_word *s1;
+};
+typedef struct board_slot board_slot;
+
+/*
+ * What making a run of next states current changed: the world's hash
+ * (see cycle.c), and the cells born and died
+ */
+struct shift_sums {
+    uint64_t hash;
+    uint64_t births;
+    uint64_t deaths;
+};
+typedef struct shift_sums shift_sums;
+
+/*
+ * Inner loops of the bitwise engine, one set per instruction set
+ *
+ * gather:   current states of n world_stores into ceil(n/4) board words
+ * scatter:  board words into the next states of n world_stores
+ * row_sums: three-cell counts of a guarded row
+ * life_row: next states of the middle row from three rows of counts,
+ *           by Conway's Life
+ * rule_row: the same by any compiled totalistic rule (see rules.h)
+ * table_row: next states of the middle row by the rule's neighbourhood
+ *           table, for rules that aren't totalistic. Only reads the rows.
+ * shift:    make the next states of stores start to end current, for
+ *           every engine (see world.c), adding what changed to sums
+ *
+ * rule_row has no branches either: the leaf for each 9-cell sum is 0,
+ * ~alive, alive or ~0, and the leaves are muxed together by the sum bit
+ * planes. It takes about twice the work of life_row.
+ *
+ * table_row can't be bit-sliced, so it builds the neighbourhood of every
+ * cell of a word in vector lanes and looks them all up at once: as
+ * column codes in bytes with shuffles (SSE4.2, AVX2), or as 9-bit
+ * indices in 32-bit lanes with a register-held table (AVX-512).
+ */
+struct bitwise_kernel {
+    const char *name;
+    void (*gather)(const world_store *data, board_word *lin, size_t n);
+    void (*scatter)(const board_word *lin, world_store *data, size_t n);
+    void (*row_sums)(const board_word *row, board_word *s0, board_word *s1, size_t words);
+    void (*life_row)(const board_slot *up, const board_slot *mid, const board_slot *down,
+            board_word *out, size_t words);
+    void (*rule_row)(const board_slot *up, const board_slot *mid, const board_slot *down,
+            const life_rule *rule, board_word *out, size_t words);
+    void (*table_row)(const board_slot *up, const board_slot *mid, const board_slot *down,
+            const life_rule *rule, board_word *out, size_t words);
+    void (*shift)(world_store *data, size_t start, size_t end, shift_sums *sums);
+};
+typedef struct bitwise_kernel bitwise_kernel;
+
+/*** INLINE HELPERS ***/
+
+/*
+ * Gather the odd (current state) bits of a world_store into the low
+ * CELLS_PER_ELEM bits, one bit per cell.
+ */
+static inline uint32_t _gather_curr(world_store v) {
+    v = (v >> 1) & 0x55555555;
+    v = (v | (v >> 1)) & 0x33333333;
+    v = (v | (v >> 2)) & 0x0f0f0f0f;
+    v = (v | (v >> 4)) & 0x00ff00ff;
+    v = (v | (v >> 8)) & 0x0000ffff;
+    return v;
+}
+
+static inline uint32_t _gather_next(world_store v) {
+    return _gather_curr(v << 1);
+}
+
+/*
+ * Spread the low CELLS_PER_ELEM bits out to the even (next state) bits
+ * of a world_store. Inverse of _gather_next.
+ */
+static inline world_store _scatter_next(uint32_t v) {
+    v &= 0x0000ffff;
+    v = (v | (v << 8)) & 0x00ff00ff;
+    v = (v | (v << 4)) & 0x0f0f0f0f;
+    v = (v | (v << 2)) & 0x33333333;
+    v = (v | (v << 1)) & 0x55555555;
+    return v;
+}
+
+/*
+ * Scalar remainders, for the stores and words left over once the
+ * vector loops run out of full registers. j is where to start.
+ */
+static inline void _gather_from(const world_store *data, board_word *lin, size_t j, size_t n) {
+    for (; j < n; j += STORE_CELLS_PER_WORD) {
+        board_word v = 0;
+        for (size_t e = 0; e < STORE_CELLS_PER_WORD && j + e < n; ++e) {
+            v |= (board_word) _gather_curr(data[j + e]) << (e * CELLS_PER_ELEM);
+        }
+        lin[j / STORE_CELLS_PER_WORD] = v;
+    }
+}
+
+static inline void _scatter_from(const board_word *lin, world_store *data, size_t j, size_t n) {
+    for (; j < n; ++j) {
+        uint32_t bits = lin[j / STORE_CELLS_PER_WORD] >> ((j % STORE_CELLS_PER_WORD) * CELLS_PER_ELEM);
+        data[j] = (data[j] & CURR_CELL_MASK) | _scatter_next(bits);
+    }
+}
+
+static inline void _row_sums_from(const board_word *row, board_word *s0, board_word *s1,
+        size_t k, size_t words) {
+    board_word left, mid, right, lm;
+
+    for (; k < words; ++k) {
+        mid = row[k+1];
+        left = (mid << 1) | (row[k] >> (BOARD_BITS - 1));
+        right = (mid >> 1) | (row[k+2] << (BOARD_BITS - 1));
+
+        lm = left ^ mid;
+        s0[k] = lm ^ right;
+        s1[k] = (left & mid) | (right & lm);
+    }
+}
+
+/*
+ * Add the three-cell counts of the rows above, at and below to get the
+ * 9-cell sum (bit planes sum0..sum3), then apply Conway's Life rules:
+ * a sum of 3 is alive, 4 keeps the current state. The minimal network
+ * for the default rule, used instead of _rule_row_from.
+ */
+static inline void _life_row_from(const board_slot *up, const board_slot *mid, const board_slot *down,
+        board_word *out, size_t k, size_t words) {
+    board_word x0, x1, t, carry, maj, z;
+    board_word sum0, sum1, sum2, sum3;
+
+    for (; k < words; ++k) {
+        x0 = up->s0[k] ^ mid->s0[k];
+        sum0 = x0 ^ down->s0[k];
+        carry = (up->s0[k] & mid->s0[k]) | (down->s0[k] & x0);
+
+        x1 = up->s1[k] ^ mid->s1[k];
+        t = x1 ^ down->s1[k];
+        maj = (up->s1[k] & mid->s1[k]) | (down->s1[k] & x1);
+
+        sum1 = t ^ carry;
+        z = t & carry;
+        sum2 = maj ^ z;
+        sum3 = maj & z;
+
+        out[k] = ~sum3 & (
+                (~sum2 & sum1 & sum0) |
+                (sum2 & ~sum1 & ~sum0 & mid->row[k+1]));
+    }
+}
+
+/*
+ * Bitwise sel ? b : a
+ */
+static inline board_word _select(board_word sel, board_word a, board_word b) {
+    return a ^ (sel & (a ^ b));
+}
+
+/*
+ * Add the three-cell counts of the rows above, at and below to get the
+ * 9-cell sum (bit planes sum0..sum3), then apply the rule. Sums of 8 and
+ * 9 are the only ones with sum3 set, and have sum1 and sum2 clear.
+ */
+static inline void _rule_row_from(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t k, size_t words) {
+    unsigned int r[10];
+    board_word x0, x1, t, carry, maj, z, leaf[4];
+    board_word sum0, sum1, sum2, sum3, low, high;
+
+    // Copied, as out could alias the rule
+    for (int n = 0; n < 10; ++n) {
+        r[n] = rule->sum9[n];
+    }
+
+    for (; k < words; ++k) {
+        x0 = up->s0[k] ^ mid->s0[k];
+        sum0 = x0 ^ down->s0[k];
+        carry = (up->s0[k] & mid->s0[k]) | (down->s0[k] & x0);
+
+        x1 = up->s1[k] ^ mid->s1[k];
+        t = x1 ^ down->s1[k];
+        maj = (up->s1[k] & mid->s1[k]) | (down->s1[k] & x1);
+
+        sum1 = t ^ carry;
+        z = t & carry;
+        sum2 = maj ^ z;
+        sum3 = maj & z;
+
+        leaf[RULE_DEAD] = 0;
+        leaf[RULE_BORN] = ~mid->row[k+1];
+        leaf[RULE_KEPT] = mid->row[k+1];
+        leaf[RULE_ALIVE] = ~(board_word) 0;
+
+        low = _select(sum1,
+                _select(sum0, leaf[r[0]], leaf[r[1]]),
+                _select(sum0, leaf[r[2]], leaf[r[3]]));
+        high = _select(sum1,
+                _select(sum0, leaf[r[4]], leaf[r[5]]),
+                _select(sum0, leaf[r[6]], leaf[r[7]]));
+        out[k] = _select(sum3,
+                _select(sum2, low, high),
+                _select(sum0, leaf[r[8]], leaf[r[9]]));
+    }
+}
+
+/*
+ * Cells -1 to 32 of half h of word k of a guarded row, as bits 0 to 33
+ */
+static inline uint64_t _half_window(const board_word *row, size_t k, int h) {
+    return h == 0 ? (row[k+1] << 1) | (row[k] >> (BOARD_BITS - 1)) :
+        (row[k+1] >> 31) | (row[k+2] << 33);
+}
+
+/*
+ * Look up the 3x3 neighbourhood of each cell in the rule's table, the
+ * rows three bits of the index each
+ */
+static inline void _table_row_from(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t k, size_t words) {
+    uint64_t table[8];
+
+    // Copied, as out could alias the rule
+    for (int i = 0; i < 8; ++i) {
+        table[i] = rule->table[i];
+    }
+
+    for (; k < words; ++k) {
+        board_word next = 0;
+        for (int h = 0; h < 2; ++h) {
+            uint64_t u = _half_window(up->row, k, h),
+                     m = _half_window(mid->row, k, h) << 3,
+                     d = _half_window(down->row, k, h) << 6;
+            for (unsigned int j = 0; j < 32; ++j) {
+                unsigned int idx = ((u >> j) & 0x7) | ((m >> j) & 0x38) | ((d >> j) & 0x1c0);
+                next |= ((table[idx >> 6] >> (idx & 63)) & 1) << (32 * h + j);
+            }
+        }
+        out[k] = next;
+    }
+}
+
+/*
+ * Live cells of a store, with the popcnt instruction if the kernel is
+ * compiled for an instruction set that has it
+ */
+static inline unsigned int _count_curr(world_store v, int popcnt) {
+#ifdef __GNUC__
+    if (popcnt) {
+        return __builtin_popcount(v & CURR_CELL_MASK);
+    }
+#endif
+    (void) popcnt;
+    return stats_popcount(v);
+}
+
+/*
+ * The next states of stores j to end become current, and the next state
+ * bits are left equal to them, so a store shifted twice doesn't change.
+ * Every store is hashed and counted, without branches, as in a busy
+ * world whether one changed can't be predicted.
+ */
+static inline void _shift_from(world_store *data, size_t j, size_t end, shift_sums *sums, int popcnt) {
+    world_store v, old;
+    uint64_t hash = 0, births = 0, deaths = 0;
+
+    for (; j < end; ++j) {
+        old = data[j] & CURR_CELL_MASK;
+        v = (data[j] << 1) & CURR_CELL_MASK;
+        data[j] = v | (v >> 1);
+        hash ^= cycle_hash(j, old) ^ cycle_hash(j, v);
+        births += _count_curr(v & ~old, popcnt);
+        deaths += _count_curr(old & ~v, popcnt);
+    }
+    sums->hash ^= hash;
+    sums->births += births;
+    sums->deaths += deaths;
+}
+
+/*** FUNCTIONS ***/
+
+const bitwise_kernel *get_kernel(void);
+int set_kernel(const char *name);
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define HAVE_X86_KERNELS 1
+extern const bitwise_kernel SSE42_KERNEL;
+extern const bitwise_kernel AVX2_KERNEL;
+extern const bitwise_kernel AVX512_KERNEL;
+#endif
+
+#endif
+/* vim: set ft=c : */
@@ -0,0 +1,155 @@
+#include <string.h>
+#include "ltl.h"
+#include "kernels.h"
+
+/*
+ * Larger than Life stepping
+ *
+ * The count of a cell is the sum of a (2r + 1)^2 box, which is
+ * separable: each column is summed over the 2r + 1 rows around the
+ * current one, and each box is then a difference of two prefix sums
+ * along the row of column sums. Moving down a row adds the row entering
+ * the columns and takes away the one leaving, so the work per cell is
+ * the same for any range.
+ *
+ * Current states are first unpacked to a byte per cell for the whole
+ * world, so bands can read each other's rows while they write next
+ * states. Sums are 16 bits and wrap, which the differences don't mind
+ * as long as a box count fits (RULE_RANGE_MAX).
+ */
+
+/*
+ * Eight bits to a byte each and back, low bit first
+ */
+static inline uint64_t _bits_to_bytes(uint32_t b) {
+    uint64_t x = ((b & 0xff) * 0x0101010101010101ull) & 0x8040201008040201ull;
+    return ((x + 0x7f7f7f7f7f7f7f7full) >> 7) & 0x0101010101010101ull;
+}
+
+static inline uint32_t _bytes_to_bits(uint64_t x) {
+    return (x * 0x0102040810204080ull) >> 56;
+}
+
+/*
+ * Current states of world data into a byte per cell, for rows [y0, y1).
+ * Works a world_store at a time, so the last one can run past the end
+ * of the world: cells must hold data_size * CELLS_PER_ELEM bytes.
+ */
+void ltl_unpack_rows(world *w, uint8_t *cells, uint32_t y0, uint32_t y1) {
+    size_t c0 = (size_t) y0 * w->xlim,
+           c1 = (size_t) y1 * w->xlim;
+
+    for (size_t i = c0 >> IDX_DIV; i < (c1 + OFFSET_MASK) >> IDX_DIV; ++i) {
+        uint32_t curr = _gather_curr(w->data[i]);
+        uint64_t bytes[2] = { _bits_to_bytes(curr), _bits_to_bytes(curr >> 8) };
+        memcpy(cells + (i << IDX_DIV), bytes, sizeof(bytes));
+    }
+}
+
+static inline int64_t _wrap(int64_t i, uint32_t n) {
+    return ((i % n) + n) % n;
+}
+
+/*
+ * Row y of cells, which can be outside the world: none, or the row it
+ * wraps to on a torus
+ */
+static inline const uint8_t *_cell_row(world *w, const uint8_t *cells, int64_t y) {
+    if (w->topology == TORUS) {
+        return cells + (size_t) _wrap(y, w->ylim) * w->xlim;
+    }
+    return y >= 0 && y < w->ylim ? cells + (size_t) y * w->xlim : NULL;
+}
+
+/*
+ * Next states of n cells from cell c on into the next state bits.
+ * Whole world_stores are packed from 16 bytes at once.
+ */
+static void _store_next(world *w, size_t c, const uint8_t *next, size_t n) {
+    for (size_t i = 0; i < n; ) {
+        size_t ci = (c + i) >> IDX_DIV;
+        unsigned int j = (c + i) & OFFSET_MASK;
+        uint64_t bytes[2];
+
+        if (j == 0 && i + CELLS_PER_ELEM <= n) {
+            memcpy(bytes, next + i, sizeof(bytes));
+            w->data[ci] = (w->data[ci] & CURR_CELL_MASK) |
+                _scatter_next(_bytes_to_bits(bytes[0]) | _bytes_to_bits(bytes[1]) << 8);
+            i += CELLS_PER_ELEM;
+            continue;
+        }
+
+        // Cells sharing a world_store with the row before or after
+        world_store bits = 0, mask = 0;
+        for (; j < CELLS_PER_ELEM && i < n; ++j, ++i) {
+            bits |= (world_store) next[i] << (j * BITS_PER_CELL);
+            mask |= (world_store) NEXT_STATE_MASK << (j * BITS_PER_CELL);
+        }
+        w->data[ci] = (w->data[ci] & ~mask) | bits;
+    }
+}
+
+/*
+ * Calculate the next state of rows [y0, y1) by the world's range rule,
+ * from the unpacked current states of the whole world
+ */
+void ltl_calc_rows(world *w, const uint8_t *cells, uint32_t y0, uint32_t y1) {
+    const life_rule *rule = &w->rule;
+    int64_t r = rule->range;
+    uint16_t middle = rule->middle,
+             birth_min = rule->birth_min, birth_max = rule->birth_max,
+             survive_min = rule->survive_min, survive_max = rule->survive_max;
+    size_t xlim = w->xlim, padded = xlim + 2 * r;
+    int torus = w->topology == TORUS;
+    const uint8_t *row;
+
+    // Column sums and their prefix sums run from x = -r, and past the
+    // right edge by r
+    uint16_t *cols = calloc(padded, sizeof(uint16_t)),
+             *sums = malloc((padded + 1) * sizeof(uint16_t));
+    uint8_t *next = malloc(xlim);
+
+    for (int64_t dy = -r; dy <= r; ++dy) {
+        if ((row = _cell_row(w, cells, (int64_t) y0 + dy)) != NULL) {
+            for (size_t x = 0; x < xlim; ++x) {
+                cols[r + x] += row[x];
+            }
+        }
+    }
+
+    for (uint32_t y = y0; y < y1; ++y) {
+        for (int64_t i = 0; i < r; ++i) {
+            cols[i] = torus ? cols[r + _wrap(i - r, w->xlim)] : 0;
+            cols[r + xlim + i] = torus ? cols[r + _wrap(i, w->xlim)] : 0;
+        }
+        sums[0] = 0;
+        for (size_t i = 0; i < padded; ++i) {
+            sums[i + 1] = sums[i] + cols[i];
+        }
+
+        row = cells + (size_t) y * xlim;
+        for (size_t x = 0; x < xlim; ++x) {
+            uint16_t count = sums[x + 2 * r + 1] - sums[x] - (middle ? 0 : row[x]);
+            next[x] = row[x] ?
+                count >= survive_min && count <= survive_max :
+                count >= birth_min && count <= birth_max;
+        }
+        _store_next(w, (size_t) y * xlim, next, xlim);
+
+        // Slide the columns down a row
+        if ((row = _cell_row(w, cells, (int64_t) y + r + 1)) != NULL) {
+            for (size_t x = 0; x < xlim; ++x) {
+                cols[r + x] += row[x];
+            }
+        }
+        if ((row = _cell_row(w, cells, (int64_t) y - r)) != NULL) {
+            for (size_t x = 0; x < xlim; ++x) {
+                cols[r + x] -= row[x];
+            }
+        }
+    }
+
+    free(cols);
+    free(sums);
+    free(next);
+}
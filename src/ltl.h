@@ -0,0 +1,14 @@
+#ifndef _LTL_H
+#define _LTL_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+
+/*** FUNCTIONS ***/
+
+void ltl_unpack_rows(world *w, uint8_t *cells, uint32_t y0, uint32_t y1);
+void ltl_calc_rows(world *w, const uint8_t *cells, uint32_t y0, uint32_t y1);
+
+#endif
+/* vim: set ft=c : */
@@ -1,5 +1,6 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #ifdef __unix__
 #include <getopt.h>
@@ -11,6 +12,23 @@
 #include "world.h"
 #include "game.h"
 #include "fills.h"
+#include "kernels.h"
+#include "engine.h"
+#include "hashlife.h"
+#include "sparse.h"
+#include "soup.h"
+#include "pages.h"
+#include "stats.h"
+#include "rewind.h"
+#include "checkpoint.h"
+
+// Long options without a short form
+#define OPT_SOUP 256
+#define OPT_SEED 257
+#define OPT_CENSUS 258
+#define OPT_STATS 259
+#define OPT_REWIND 260
+#define OPT_AUTOSAVE 261
 
 
 static unsigned long int parse_int_opt(char *optval) {
@@ -23,15 +41,174 @@ static unsigned long int parse_int_opt(char *optval) {
     return val;
 }
 
+static unsigned long long int parse_long_opt(char *optval) {
+    char *end;
+    unsigned long long int val = strtoull(optval, &end, 10);
+    if (*optval == '-' || *end != '\0') {
+        fprintf(stderr, "Invalid numeric value: %s\n", optval);
+        exit(EXIT_FAILURE);
+    }
+
+    return val;
+}
+
+/*
+ * Worlds the engine can't step are refused up front, rather than stepped
+ * by another engine
+ */
+static void require_engine(world *w) {
+    const char *refused = engine_refuses(w);
+
+    if (refused != NULL) {
+        fprintf(stderr, "The %s engine can't step %s\n", engine_name(w->engine), refused);
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * Advance a world with the hashlife engine, then go on with its own
+ */
+static void jump_world(world *w, unsigned long long int gens, world_engine hashlife) {
+    world_engine engine = w->engine;
+    engine_stats stats;
+    clock_t start = clock();
+
+    if (gens > HL_MAX_JUMP - w->generation) {
+        fprintf(stderr, "Can't jump %llu generations from generation %lu, worlds count up to %llu\n",
+                gens, (unsigned long) w->generation, (unsigned long long) HL_MAX_JUMP);
+        exit(EXIT_FAILURE);
+    }
+    world_set_engine(w, hashlife);
+    require_engine(w);
+    world_step_n(w, (unsigned int) gens);
+
+    get_engine_stats(w, &stats);
+    printf("Jumped %llu generations in %.3fs: population %llu, %lu bytes\n",
+            gens, (double) (clock() - start) / CLOCKS_PER_SEC,
+            (unsigned long long) stats.population, (unsigned long) stats.memory);
+    world_set_engine(w, engine);
+}
+
+/*
+ * How the run ended, if a cycle was found
+ */
+static void print_outcome(world *w) {
+    engine_stats stats;
+
+    get_engine_stats(w, &stats);
+    printf("Generation %lu, population %llu\n",
+            (unsigned long) w->generation, (unsigned long long) stats.population);
+    printf("Engine memory: %lu bytes\n", (unsigned long) stats.memory);
+    if (w->cycle.extinct) {
+        printf("Extinct at generation %lu\n", (unsigned long) w->cycle.first);
+    } else if (w->cycle.period > 0) {
+        printf("Period %lu from generation %lu\n",
+                (unsigned long) w->cycle.period, (unsigned long) w->cycle.first);
+    }
+}
+
+/*
+ * Run soups soups of a search, saving the census after every round so
+ * it can be resumed from there
+ */
+static void search_soups(unsigned long long int soups, uint32_t xlim, uint32_t ylim,
+        const life_rule *rule, unsigned long long int seed, int seedflag,
+        const char *census_file, unsigned int threads) {
+    char rule_str[RULE_STRING_LEN];
+    soup_search *s = init_soup_search(xlim, ylim, rule, seed, threads);
+    unsigned long long int done = 0;
+    Uint32 start = SDL_GetTicks(), round_start;
+    census_entry *sorted;
+    double seconds;
+
+    if (s == NULL) {
+        fputs("Soups can't be searched with a B0, Larger than Life or Generations rule\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+    switch (soup_resume(s, census_file, seedflag)) {
+        case 1:
+            printf("Resuming %s after %llu soups\n", census_file, (unsigned long long) s->soups);
+            break;
+        case -1:
+            fprintf(stderr, "%s is the census of a different search\n", census_file);
+            exit(EXIT_FAILURE);
+        default:
+            break;
+    }
+
+    rule_string(rule, rule_str);
+    printf("Soup search: %lux%lu, rule %s, seed %llu, %u threads\n", (unsigned long) xlim,
+            (unsigned long) ylim, rule_str, (unsigned long long) s->seed, s->bands);
+    while (done < soups) {
+        unsigned long long int round = soups - done < SOUP_ROUND ? soups - done : SOUP_ROUND;
+        round_start = SDL_GetTicks();
+        soup_run(s, round);
+        done += round;
+        if (!soup_save_census(s, census_file)) {
+            fprintf(stderr, "Couldn't write %s\n", census_file);
+            exit(EXIT_FAILURE);
+        }
+        printf("Soups: %llu, %.0f soups/s\n", (unsigned long long) s->soups,
+                round * 1000.0 / (SDL_GetTicks() - round_start + 1));
+    }
+
+    seconds = (SDL_GetTicks() - start) / 1000.0;
+    printf("Searched %llu soups in %.3fs, %.0f soups/s\n", done, seconds,
+            seconds > 0 ? done / seconds : 0.0);
+    printf("Soups: %llu, extinct %llu, unfinished %llu, %llu objects on the edge, %lu kinds of object\n",
+            (unsigned long long) s->soups, (unsigned long long) s->extinct,
+            (unsigned long long) s->unfinished, (unsigned long long) s->edge,
+            (unsigned long) s->census.count);
+    sorted = soup_sorted_census(s);
+    for (size_t i = 0; i < s->census.count && i < 10; ++i) {
+        printf("%12llu %s\n", (unsigned long long) sorted[i].count, sorted[i].code);
+    }
+    free(sorted);
+    destroy_soup_search(s);
+}
+
 int main(int argc, char **argv) {
     int c;
-    int pflag = 0, tflag = 0;
-    unsigned long int xlim = 160, ylim = 100, ilim = 1, fill_type = 3;
+    int pflag = 0, tflag = 0, sizeflag = 0;
+    world_topology topology = BOUNDED;
+    unsigned long int xlim = 160, ylim = 100, ilim = 1, fill_type = 3, block = 0;
+    unsigned long long int jump = 0, soups = 0, seed = time(NULL);
+    int seedflag = 0;
+    const char *census_file = SOUP_CENSUS_DEFAULT;
+    FILE *stats_file = NULL;
+    uint64_t stats_written = 0;
+    size_t rewind_budget = REWIND_DEFAULT_BUDGET;
+    checkpoint_interval autosave = {CHECKPOINT_GENERATIONS, 0};
+    checkpointer *cp = NULL;
     char *fopt = NULL;
+    world_engine engine, sparse_engine, hashlife_engine;
+    huge_pages huge;
+    life_rule rule = make_rule(CONWAY_BIRTH, CONWAY_SURVIVE);
+    sim_rate rate = {SIM_PER_SECOND, 60};
+    char rule_str[RULE_STRING_LEN];
+    char *threads_env = getenv("YALS2_THREADS");
+
+    // Threads: -j overrides YALS2_THREADS, which overrides the CPU count
+    unsigned int threads = threads_env != NULL ?
+            parse_int_opt(threads_env) : (unsigned int) SDL_GetCPUCount();
+    set_default_threads(threads);
 
-    const char *optstr = "tn:w:x:h:y:f:pi:";
+    // Engines past the built-in ones, which -e picks by name as well
+    register_engine(&SPARSE_ENGINE, &sparse_engine);
+    register_engine(&HASHLIFE_ENGINE, &hashlife_engine);
 
-    while ( (c = getopt(argc, argv, optstr)) != -1 ) {
+    const char *optstr = "tn:w:x:h:y:f:pi:e:k:j:NG:m:uTr:b:g:H:";
+    const struct option longopts[] = {
+        { "soup", required_argument, NULL, OPT_SOUP },
+        { "seed", required_argument, NULL, OPT_SEED },
+        { "census", required_argument, NULL, OPT_CENSUS },
+        { "stats", required_argument, NULL, OPT_STATS },
+        { "rewind", required_argument, NULL, OPT_REWIND },
+        { "autosave", required_argument, NULL, OPT_AUTOSAVE },
+        { NULL, 0, NULL, 0 }
+    };
+
+    while ( (c = getopt_long(argc, argv, optstr, longopts, NULL)) != -1 ) {
         switch (c) {
             case 'p':
                 // Profiling flag
@@ -41,6 +218,10 @@ int main(int argc, char **argv) {
                 // Iteration count
                 ilim = parse_int_opt(optarg);
                 break;
+            case 'b':
+                // Generations per world_step_n in profile mode
+                block = parse_int_opt(optarg);
+                break;
             case 't':
                 // Text flag
                 tflag = 1;
@@ -53,16 +234,123 @@ int main(int argc, char **argv) {
             case 'x':
                 // World width
                 xlim = parse_int_opt(optarg);
+                sizeflag = 1;
                 break;
             case 'h':
             case 'y':
                 // World height
                 ylim = parse_int_opt(optarg);
+                sizeflag = 1;
                 break;
             case 'f':
                 // File option (read/write)
                 fopt = optarg;
                 break;
+            case 'e':
+                // Stepping engine
+                if (strcmp(optarg, "list") == 0) {
+                    print_engines(stdout);
+                    exit(EXIT_SUCCESS);
+                } else if (!parse_engine(optarg, &engine)) {
+                    fprintf(stderr, "Unknown engine: %s, available engines:\n", optarg);
+                    print_engines(stderr);
+                    exit(EXIT_FAILURE);
+                }
+                set_default_engine(engine);
+                break;
+            case 'H':
+                // Huge pages for world memory
+                if (!parse_huge_pages(optarg, &huge)) {
+                    fprintf(stderr, "Unknown huge page mode: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                set_default_huge_pages(huge);
+                break;
+            case 'N':
+                // NUMA placement
+                set_default_numa(1);
+                break;
+            case 'j':
+                // Worker threads
+                threads = parse_int_opt(optarg);
+                set_default_threads(threads);
+                break;
+            case 'T':
+                // Toroidal world
+                topology = TORUS;
+                break;
+            case 'r':
+                // Life-like rule
+                if (!parse_rule(optarg, &rule)) {
+                    fprintf(stderr, "Invalid rule: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                set_default_rule(&rule);
+                break;
+            case 'u':
+                // Unbounded world, stepped by the sparse engine
+                set_default_engine(sparse_engine);
+                break;
+            case 'G':
+                // Jump ahead with HashLife
+                jump = parse_long_opt(optarg);
+                if (jump > HL_MAX_JUMP) {
+                    fprintf(stderr, "HashLife jumps go up to %llu generations\n",
+                            (unsigned long long) HL_MAX_JUMP);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'm':
+                // HashLife memory cap in MiB
+                set_default_hashlife_memory((size_t) parse_int_opt(optarg) << 20);
+                break;
+            case 'g':
+                // Simulation rate in graphical mode
+                if (!parse_sim_rate(optarg, &rate)) {
+                    fprintf(stderr, "Invalid rate: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case 'k':
+                // Force a SIMD kernel
+                if (!set_kernel(optarg)) {
+                    fprintf(stderr, "Unknown or unsupported kernel: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
+            case OPT_SOUP:
+                // Soups to search
+                soups = parse_long_opt(optarg);
+                break;
+            case OPT_SEED:
+                // Seed of the soups
+                seed = parse_long_opt(optarg);
+                seedflag = 1;
+                break;
+            case OPT_CENSUS:
+                // Census file of the soup search
+                census_file = optarg;
+                break;
+            case OPT_STATS:
+                // CSV of every generation's statistics in profile mode
+                stats_file = fopen(optarg, "w");
+                if (stats_file == NULL) {
+                    fprintf(stderr, "Couldn't write %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                stats_csv_header(stats_file);
+                break;
+            case OPT_REWIND:
+                // Memory for past generations in graphical mode, in MiB
+                rewind_budget = (size_t) parse_int_opt(optarg) << 20;
+                break;
+            case OPT_AUTOSAVE:
+                // Save to the -f file every so many generations or seconds
+                if (!parse_checkpoint_interval(optarg, &autosave)) {
+                    fprintf(stderr, "Invalid interval: %s\n", optarg);
+                    exit(EXIT_FAILURE);
+                }
+                break;
             case '?':
                 exit(EXIT_FAILURE);
                 break;
@@ -78,6 +366,22 @@ int main(int argc, char **argv) {
         putchar('\n');
     }
 
+    if (xlim > UINT32_MAX || ylim > UINT32_MAX) {
+        fprintf(stderr, "Width and height go up to %lu\n", (unsigned long) UINT32_MAX);
+        exit(EXIT_FAILURE);
+    }
+
+    if (autosave.every > 0 && fopt == NULL) {
+        fputs("Autosave needs a file to save to (-f)\n", stderr);
+        exit(EXIT_FAILURE);
+    }
+
+    if (soups > 0) {
+        search_soups(soups, sizeflag ? xlim : 64, sizeflag ? ylim : 64, &rule, seed, seedflag,
+                census_file, threads);
+        return EXIT_SUCCESS;
+    }
+
     // Declare world
     world *w = NULL;
     srand(time(NULL));
@@ -92,16 +396,79 @@ int main(int argc, char **argv) {
         unsigned long iterations = ilim * 1000;
         printf("Iterations: %lu\n", iterations);
 
-        w = init_world(200, 200);
+        // A world from -f is stepped as it is, for comparing engines on it
+        w = fopt != NULL ? read_from_file(fopt, AUTO) : NULL;
+        if (w == NULL) {
+            w = sizeflag ? init_world(xlim, ylim, topology) : init_world(200, 200, topology);
+            if (w == NULL) {
+                exit(EXIT_FAILURE);
+            }
+            fill(w, fill_type);
+        }
+        require_engine(w);
 
         printf("World size: %lu\n", w->data_size);
-        fill(w, fill_type);
+        printf("Engine: %s\n", engine_name(w->engine));
+        if (get_engine(w->engine)->report != NULL) {
+            get_engine(w->engine)->report(w, stdout);
+        }
+        printf("Threads: %u\n", w->bands);
+        printf("Topology: %s\n", w->topology == TORUS ? "torus" : "bounded");
+        rule_string(&w->rule, rule_str);
+        printf("Rule: %s\n", rule_str);
+        printf("Tiles: %lu\n", (unsigned long) w->tile_cols * w->tile_rows);
+        if (autosave.every > 0) {
+            // Back to the -f file, which a run cut short can go on from
+            cp = init_checkpointer(fopt, autosave, w->generation);
+        }
 
-        puts("Start!");
-        for (unsigned long i = 0; i < iterations; i++) {
-            world_step(w);
+        if (block > 0) {
+            printf("Blocked: %lu generations per step\n", block);
+            puts("Start!");
+            for (unsigned long i = 0; i < iterations; i += block) {
+                world_step_n(w, iterations - i < block ? iterations - i : block);
+                if (stats_file != NULL) {
+                    stats_written = stats_write_csv(w, stats_file, stats_written);
+                }
+                if (cp != NULL && checkpoint_due(cp, w->generation)) {
+                    checkpoint_world(cp, w);
+                }
+            }
+            puts("End!");
+            print_outcome(w);
+        } else {
+            double active_tiles = 0;
+            unsigned long steps = 0;
+            puts("Start!");
+            for (unsigned long i = 0; i < iterations; i++, steps++) {
+                world_step(w);
+                active_tiles += w->active_tiles;
+                if (stats_file != NULL) {
+                    stats_written = stats_write_csv(w, stats_file, stats_written);
+                }
+                if (cp != NULL && checkpoint_due(cp, w->generation)) {
+                    checkpoint_world(cp, w);
+                }
+                // Skip the periods that are left once the outcome is known
+                i += world_fast_forward(w, w->generation + (iterations - i - 1));
+            }
+            puts("End!");
+            printf("Active tiles: %.1f avg, %lu last\n",
+                    active_tiles / steps, (unsigned long) w->active_tiles);
+            print_outcome(w);
+        }
+        if (w->numa) {
+            print_numa_report(w);
+        }
+        if (stats_file != NULL) {
+            fclose(stats_file);
+        }
+        if (cp != NULL) {
+            if (w->generation != cp->generation) {
+                checkpoint_world(cp, w);
+            }
+            destroy_checkpointer(cp);
         }
-        puts("End!");
     } else {
         if (fopt != NULL) {
             printf("Opening and saving to file %s\n", fopt);
@@ -119,13 +486,21 @@ int main(int argc, char **argv) {
             exit(EXIT_FAILURE);
         } else if (w == NULL) {
             // Create an empty world
-            w = init_world(xlim, ylim);
+            w = init_world(xlim, ylim, topology);
+            if (w == NULL) {
+                exit(EXIT_FAILURE);
+            }
             fill(w, fill_type);
         }
 
         // Definitely should have a world at this point
         printf("World size: %lu\n", w->data_size);
 
+        require_engine(w);
+        if (jump > 0) {
+            jump_world(w, jump, hashlife_engine);
+        }
+
         if (tflag) {
             print_world(w);
             for (int i = 0; i < 5; i++) {
@@ -135,7 +510,16 @@ int main(int argc, char **argv) {
                 print_world(w);
             }
         } else {
+            if (!game_world_fits(w->xlim, w->ylim)) {
+                fprintf(stderr, "Graphical mode draws at most %lu cells, a %lux%lu world is too big "
+                        "(profile or text mode can run it)\n", (unsigned long) GAME_MAX_CELLS,
+                        (unsigned long) w->xlim, (unsigned long) w->ylim);
+                exit(EXIT_FAILURE);
+            }
             game *g = init_game_from_world(w);
+            set_game_rate(g, rate);
+            set_game_rewind(g, rewind_budget);
+            set_game_autosave(g, autosave);
             setup_game(g, 1280, 720, fopt);
             start_game(g);
 
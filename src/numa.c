@@ -0,0 +1,192 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#endif
+#include <stdint.h>
+#include "numa.h"
+
+/*
+ * Nodes are numbered 0..numa_count_nodes()-1 here, which need not match
+ * the kernel's node ids if some nodes are offline.
+ */
+
+#ifdef __linux__
+#define NODE_PATH "/sys/devices/system/node"
+#define PAGE_BATCH 1024
+
+static int node_count = 0;
+static int node_ids[NUMA_MAX_NODES];
+
+/*
+ * Parse a sysfs list like "0-3,8,10-11", calling add for every number
+ */
+static int _parse_list(const char *path, void (*add)(int, void *), void *arg) {
+    FILE *fp = fopen(path, "r");
+    int lo, hi, n = 0;
+    char sep;
+
+    if (fp == NULL) {
+        return 0;
+    }
+    while (fscanf(fp, "%d", &lo) == 1) {
+        hi = lo;
+        if (fscanf(fp, "%c", &sep) == 1 && sep == '-') {
+            if (fscanf(fp, "%d", &hi) != 1) {
+                break;
+            }
+            if (fscanf(fp, "%c", &sep) != 1) {
+                sep = '\n';
+            }
+        }
+        for (int i = lo; i <= hi; ++i) {
+            add(i, arg);
+            n++;
+        }
+        if (sep != ',') {
+            break;
+        }
+    }
+    fclose(fp);
+    return n;
+}
+
+static void _add_node(int id, void *arg) {
+    (void) arg;
+    if (node_count < NUMA_MAX_NODES) {
+        node_ids[node_count++] = id;
+    }
+}
+
+static void _add_cpu(int cpu, void *arg) {
+    if (cpu < CPU_SETSIZE) {
+        CPU_SET(cpu, (cpu_set_t *) arg);
+    }
+}
+
+static int _node_index(int id) {
+    for (int i = 0; i < node_count; ++i) {
+        if (node_ids[i] == id) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+int numa_count_nodes(void) {
+    if (node_count == 0 && _parse_list(NODE_PATH "/online", _add_node, NULL) == 0) {
+        node_ids[0] = 0;
+        node_count = 1;
+    }
+    return node_count;
+}
+
+/*
+ * Restrict the calling thread to the CPUs of a node. Returns 0 if the
+ * node has no CPUs or the affinity can't be set.
+ */
+int numa_pin_thread(int node) {
+    char path[64];
+    cpu_set_t cpus;
+
+    if (node < 0 || node >= numa_count_nodes()) {
+        return 0;
+    }
+
+    CPU_ZERO(&cpus);
+    snprintf(path, sizeof(path), NODE_PATH "/node%d/cpulist", node_ids[node]);
+    if (_parse_list(path, _add_cpu, &cpus) == 0) {
+        return 0;
+    }
+    return sched_setaffinity(0, sizeof(cpus), &cpus) == 0;
+}
+
+/*
+ * The CPUs the calling thread may run on, for numa_restore_affinity.
+ * Returns NULL if they can't be had.
+ */
+void *numa_save_affinity(void) {
+    cpu_set_t *cpus = malloc(sizeof(cpu_set_t));
+
+    if (cpus != NULL && sched_getaffinity(0, sizeof(cpu_set_t), cpus) != 0) {
+        free(cpus);
+        cpus = NULL;
+    }
+    return cpus;
+}
+
+/*
+ * Put back the CPUs from numa_save_affinity, and free them
+ */
+void numa_restore_affinity(void *saved) {
+    if (saved != NULL) {
+        sched_setaffinity(0, sizeof(cpu_set_t), saved);
+        free(saved);
+    }
+}
+
+/*
+ * Add the bytes of [p, p+size) resident on each node to node_bytes.
+ * Returns the bytes that aren't resident anywhere yet.
+ */
+size_t numa_page_usage(const void *p, size_t size, size_t *node_bytes) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    uintptr_t start = (uintptr_t) p & ~(page - 1),
+              end = (uintptr_t) p + size;
+    void *pages[PAGE_BATCH];
+    int status[PAGE_BATCH];
+    size_t missing = 0;
+
+    numa_count_nodes();
+    while (start < end) {
+        uintptr_t batch = start;
+        unsigned long count = 0;
+        for (; count < PAGE_BATCH && start < end; ++count, start += page) {
+            pages[count] = (void *) start;
+        }
+
+        // With no target nodes, move_pages only reports where pages are
+        if (syscall(SYS_move_pages, 0, count, pages, NULL, status, 0) != 0) {
+            return missing + (end - batch);
+        }
+        for (unsigned long i = 0; i < count; ++i) {
+            int node = status[i] >= 0 ? _node_index(status[i]) : -1;
+            if (node >= 0) {
+                node_bytes[node] += page;
+            } else {
+                missing += page;
+            }
+        }
+    }
+    return missing;
+}
+
+#else
+
+int numa_count_nodes(void) {
+    return 1;
+}
+
+int numa_pin_thread(int node) {
+    (void) node;
+    return 0;
+}
+
+void *numa_save_affinity(void) {
+    return NULL;
+}
+
+void numa_restore_affinity(void *saved) {
+    (void) saved;
+}
+
+size_t numa_page_usage(const void *p, size_t size, size_t *node_bytes) {
+    (void) p;
+    node_bytes[0] += size;
+    return 0;
+}
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef _NUMA_H
+#define _NUMA_H
+
+#include <stdlib.h>
+
+#define NUMA_MAX_NODES 64
+
+/*
+ * Minimal NUMA support without libnuma: topology from sysfs, pinning
+ * with sched_setaffinity, and page placement from first touch of memory
+ * from pages_alloc_placed. On other platforms there is a single node and
+ * everything is a no-op.
+ */
+
+/*** FUNCTIONS ***/
+
+int numa_count_nodes(void);
+int numa_pin_thread(int node);
+void *numa_save_affinity(void);
+void numa_restore_affinity(void *saved);
+size_t numa_page_usage(const void *p, size_t size, size_t *node_bytes);
+
+#endif
+/* vim: set ft=c : */
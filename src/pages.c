@@ -0,0 +1,257 @@
+#ifdef __linux__
+#define _GNU_SOURCE
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+#include <stdio.h>
+#include <string.h>
+#include <stdint.h>
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+#include "pages.h"
+
+/*
+ * Big buffers, like world data, straight from the kernel
+ *
+ * A world of a few gigacells spans millions of 4k pages, far more than
+ * the TLB holds, so each step would miss on nearly every row without
+ * huge pages.
+ *
+ * Freed buffers are kept by their size rounded up to whole pages, up to
+ * PAGES_CACHE_BYTES of them, and handed out again, cleared, for the same
+ * size class. A world loaded or pasted over one of the same size then
+ * gets memory that is already mapped, instead of faulting in every page
+ * of it again. Kept buffers are given back to the kernel if it runs out
+ * of memory.
+ *
+ * Clearing a kept buffer touches all of it from the calling thread, so
+ * buffers placed with NUMA (see numa.c) come from pages_alloc_placed,
+ * which only maps fresh ones. Those are zeroed and untouched until first
+ * written, and end up on the node of the thread that writes them first,
+ * a huge page at a time.
+ */
+
+static huge_pages default_huge_pages = HUGE_PAGES_TRANSPARENT;
+static const char *HUGE_PAGES_NAMES[] = { "off", "thp", "explicit" };
+
+/*
+ * Huge pages of buffers allocated from now on
+ */
+void set_default_huge_pages(huge_pages mode) {
+    default_huge_pages = mode;
+}
+
+/*
+ * Look up a huge page mode by name, returns 0 if the name is unknown
+ */
+int parse_huge_pages(const char *name, huge_pages *mode) {
+    for (size_t i = 0; i < sizeof(HUGE_PAGES_NAMES) / sizeof(HUGE_PAGES_NAMES[0]); ++i) {
+        if (strcmp(name, HUGE_PAGES_NAMES[i]) == 0) {
+            *mode = i;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+#ifdef __linux__
+
+struct cached_pages {
+    void *p;
+    size_t size; // as mapped
+};
+
+static struct cached_pages cache[PAGES_CACHE];
+static size_t cache_bytes = 0;
+static SDL_SpinLock cache_lock;
+
+static inline size_t _huge_size(size_t size) {
+    return (size + PAGES_HUGE_MIN - 1) / PAGES_HUGE_MIN * PAGES_HUGE_MIN;
+}
+
+static inline int _is_huge(size_t size) {
+    return default_huge_pages != HUGE_PAGES_OFF && size >= PAGES_HUGE_MIN;
+}
+
+/*
+ * Size of the mapping for a buffer, which is its size class
+ */
+static inline size_t _mapped_size(size_t size) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    return _is_huge(size) ? _huge_size(size) : (size + page - 1) / page * page;
+}
+
+static void *_cache_take(size_t mapped) {
+    void *p = NULL;
+
+    SDL_AtomicLock(&cache_lock);
+    for (int i = 0; i < PAGES_CACHE; ++i) {
+        if (cache[i].p != NULL && cache[i].size == mapped) {
+            p = cache[i].p;
+            cache[i].p = NULL;
+            cache_bytes -= mapped;
+            break;
+        }
+    }
+    SDL_AtomicUnlock(&cache_lock);
+    return p;
+}
+
+static int _cache_put(void *p, size_t mapped) {
+    int kept = 0;
+
+    SDL_AtomicLock(&cache_lock);
+    for (int i = 0; i < PAGES_CACHE && !kept && mapped <= PAGES_CACHE_BYTES - cache_bytes; ++i) {
+        if (cache[i].p == NULL) {
+            cache[i].p = p;
+            cache[i].size = mapped;
+            cache_bytes += mapped;
+            kept = 1;
+        }
+    }
+    SDL_AtomicUnlock(&cache_lock);
+    return kept;
+}
+
+/*
+ * Give every kept buffer back to the kernel
+ */
+void pages_trim(void) {
+    SDL_AtomicLock(&cache_lock);
+    for (int i = 0; i < PAGES_CACHE; ++i) {
+        if (cache[i].p != NULL) {
+            munmap(cache[i].p, cache[i].size);
+            cache[i].p = NULL;
+        }
+    }
+    cache_bytes = 0;
+    SDL_AtomicUnlock(&cache_lock);
+}
+
+/*
+ * Transparent huge pages only back whole aligned huge pages, so the
+ * mapping is made a huge page bigger and trimmed to start on one
+ */
+static void *_alloc_transparent(size_t size) {
+    size_t huge = _huge_size(size);
+    char *p, *start;
+
+    if (huge + PAGES_HUGE_MIN < huge) {
+        return NULL;
+    }
+    p = mmap(NULL, huge + PAGES_HUGE_MIN, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        return NULL;
+    }
+    start = (char *) (((uintptr_t) p + PAGES_HUGE_MIN - 1) & ~(uintptr_t) (PAGES_HUGE_MIN - 1));
+    if (start > p) {
+        munmap(p, start - p);
+    }
+    munmap(start + huge, p + PAGES_HUGE_MIN - start);
+#ifdef MADV_HUGEPAGE
+    // Only a hint, the kernel may not have them enabled
+    madvise(start, huge, MADV_HUGEPAGE);
+#endif
+    return start;
+}
+
+static void *_map(size_t size) {
+    void *p = NULL;
+
+    if (!_is_huge(size)) {
+        p = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        p = p == MAP_FAILED ? NULL : p;
+    } else if (default_huge_pages == HUGE_PAGES_EXPLICIT) {
+#ifdef MAP_HUGETLB
+        p = mmap(NULL, _huge_size(size), PROT_READ | PROT_WRITE,
+                MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        p = p == MAP_FAILED ? NULL : p;
+#endif
+    } else {
+        p = _alloc_transparent(size);
+    }
+    return p;
+}
+
+/*
+ * Zeroed memory, page aligned and on huge pages if it is big enough.
+ * Prints why and returns NULL if it can't be had.
+ */
+void *pages_alloc(size_t size) {
+    void *p = _cache_take(_mapped_size(size > 0 ? size : 1));
+
+    if (p != NULL) {
+        memset(p, 0, size);
+        return p;
+    }
+    return pages_alloc_placed(size);
+}
+
+/*
+ * Like pages_alloc, but never a kept buffer, so no page of it is touched
+ * until it is first written
+ */
+void *pages_alloc_placed(size_t size) {
+    void *p;
+
+    if (size == 0) {
+        size = 1;
+    }
+    p = _map(size);
+    if (p == NULL) {
+        pages_trim();
+        p = _map(size);
+    }
+    if (p == NULL && default_huge_pages == HUGE_PAGES_EXPLICIT && _is_huge(size)) {
+        fprintf(stderr, "Could not allocate %lu bytes of huge pages, "
+                "reserve more in /proc/sys/vm/nr_hugepages\n", (unsigned long) size);
+    } else if (p == NULL) {
+        fprintf(stderr, "Could not allocate %lu bytes\n", (unsigned long) size);
+    }
+    return p;
+}
+
+/*
+ * Free memory from pages_alloc, of the size it was allocated with. The
+ * huge page mode has to be the same as then too.
+ */
+void pages_free(void *p, size_t size) {
+    size_t mapped;
+
+    if (p == NULL) {
+        return;
+    }
+    mapped = _mapped_size(size > 0 ? size : 1);
+    if (!_cache_put(p, mapped)) {
+        munmap(p, mapped);
+    }
+}
+
+#else
+
+void *pages_alloc(size_t size) {
+    void *p = calloc(size > 0 ? size : 1, 1);
+
+    if (p == NULL) {
+        fprintf(stderr, "Could not allocate %lu bytes\n", (unsigned long) size);
+    }
+    return p;
+}
+
+void *pages_alloc_placed(size_t size) {
+    return pages_alloc(size);
+}
+
+void pages_free(void *p, size_t size) {
+    (void) size;
+    free(p);
+}
+
+void pages_trim(void) {
+}
+
+#endif
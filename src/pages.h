@@ -0,0 +1,32 @@
+#ifndef _PAGES_H
+#define _PAGES_H
+
+#include <stdlib.h>
+
+// Buffers from this size on are backed by huge pages
+#define PAGES_HUGE_MIN (2 << 20)
+// Freed buffers kept for reuse, and the most bytes they may take
+#define PAGES_CACHE 8
+#define PAGES_CACHE_BYTES ((size_t) 256 << 20)
+
+/*** TYPES ***/
+
+/*
+ * Huge pages for big buffers: none, transparent ones the kernel uses when
+ * it can (the default), or explicit ones from the reserved pool, which
+ * have to be there
+ */
+enum huge_pages { HUGE_PAGES_OFF=0, HUGE_PAGES_TRANSPARENT=1, HUGE_PAGES_EXPLICIT=2 };
+typedef enum huge_pages huge_pages;
+
+/*** FUNCTIONS ***/
+
+void set_default_huge_pages(huge_pages mode);
+int parse_huge_pages(const char *name, huge_pages *mode);
+void *pages_alloc(size_t size);
+void *pages_alloc_placed(size_t size);
+void pages_free(void *p, size_t size);
+void pages_trim(void);
+
+#endif
+/* vim: set ft=c : */
@@ -0,0 +1,110 @@
+#include "pool.h"
+
+/*
+ * Persistent worker threads. Workers sleep on the start condition until
+ * the epoch changes, run their band, and the last one to finish wakes
+ * the caller. pool_run is the only synchronisation point.
+ */
+
+static int _worker(void *data) {
+    pool_worker *pw = data;
+    pool *p = pw->p;
+    unsigned int seen = 0;
+    pool_func_type func;
+    void *arg;
+
+    SDL_LockMutex(p->lock);
+    for (;;) {
+        while (p->epoch == seen && !p->quit) {
+            SDL_CondWait(p->start, p->lock);
+        }
+        if (p->quit) {
+            break;
+        }
+        seen = p->epoch;
+        func = p->func;
+        arg = p->arg;
+        SDL_UnlockMutex(p->lock);
+
+        func(arg, pw->band, p->threads);
+
+        SDL_LockMutex(p->lock);
+        if (--p->pending == 0) {
+            SDL_CondSignal(p->done);
+        }
+    }
+    SDL_UnlockMutex(p->lock);
+
+    return 0;
+}
+
+pool *init_pool(unsigned int threads) {
+    pool *p = malloc(sizeof(pool));
+    p->threads = threads > 0 ? threads : 1;
+    p->func = NULL;
+    p->arg = NULL;
+    p->epoch = 0;
+    p->pending = 0;
+    p->quit = 0;
+
+    p->lock = SDL_CreateMutex();
+    p->start = SDL_CreateCond();
+    p->done = SDL_CreateCond();
+
+    // The calling thread runs band 0 itself
+    p->workers = calloc(p->threads, sizeof(pool_worker));
+    for (unsigned int i = 1; i < p->threads; ++i) {
+        p->workers[i].p = p;
+        p->workers[i].band = i;
+        p->workers[i].thread = SDL_CreateThread(_worker, "world_step", &p->workers[i]);
+        if (p->workers[i].thread == NULL) {
+            printf("Could not create worker thread: %s\n", SDL_GetError());
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    return p;
+}
+
+void destroy_pool(pool *p) {
+    SDL_LockMutex(p->lock);
+    p->quit = 1;
+    SDL_CondBroadcast(p->start);
+    SDL_UnlockMutex(p->lock);
+
+    for (unsigned int i = 1; i < p->threads; ++i) {
+        SDL_WaitThread(p->workers[i].thread, NULL);
+    }
+
+    SDL_DestroyCond(p->start);
+    SDL_DestroyCond(p->done);
+    SDL_DestroyMutex(p->lock);
+    free(p->workers);
+    free(p);
+}
+
+/*
+ * Run func on every band and wait for all of them to finish
+ */
+void pool_run(pool *p, pool_func_type func, void *arg) {
+    if (p->threads == 1) {
+        func(arg, 0, 1);
+        return;
+    }
+
+    SDL_LockMutex(p->lock);
+    p->func = func;
+    p->arg = arg;
+    p->pending = p->threads - 1;
+    p->epoch++;
+    SDL_CondBroadcast(p->start);
+    SDL_UnlockMutex(p->lock);
+
+    func(arg, 0, p->threads);
+
+    SDL_LockMutex(p->lock);
+    while (p->pending > 0) {
+        SDL_CondWait(p->done, p->lock);
+    }
+    SDL_UnlockMutex(p->lock);
+}
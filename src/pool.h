@@ -0,0 +1,50 @@
+#ifndef _POOL_H
+#define _POOL_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+/*** TYPES ***/
+
+/*
+ * Work for one band. Called once per thread with band in [0, bands),
+ * band 0 on the thread that called pool_run.
+ */
+typedef void (*pool_func_type) (void *arg, unsigned int band, unsigned int bands);
+
+struct pool_worker {
+    struct pool *p;
+    unsigned int band;
+    SDL_Thread *thread;
+};
+typedef struct pool_worker pool_worker;
+
+struct pool {
+    unsigned int threads;
+    pool_worker *workers;
+
+    SDL_mutex *lock;
+    SDL_cond *start;
+    SDL_cond *done;
+
+    pool_func_type func;
+    void *arg;
+    unsigned int epoch;
+    unsigned int pending;
+    int quit;
+};
+typedef struct pool pool;
+
+/*** FUNCTIONS ***/
+
+pool *init_pool(unsigned int threads);
+void destroy_pool(pool *p);
+void pool_run(pool *p, pool_func_type func, void *arg);
+
+#endif
+/* vim: set ft=c : */
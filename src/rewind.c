@@ -0,0 +1,366 @@
+#include <string.h>
+#include "rewind.h"
+#include "stats.h"
+#include "pages.h"
+
+/*
+ * Rewind history
+ *
+ * Each generation recorded is kept as the cells that changed since the
+ * one before, so the same delta takes the world either way between the
+ * two. Only current states are kept, as next states are calculated again
+ * after going back.
+ *
+ * Deltas are run-length encoded: the number of unchanged cells before
+ * each changed one, as a varint of 7 bits a byte. Even a busy soup
+ * changes a few percent of its cells a generation, most of them within a
+ * hundred cells of the last, so that is about a byte a changed cell, and
+ * a quiet world costs next to nothing. A keyframe, the live cells of the
+ * whole world encoded the same way, is taken once the deltas since the
+ * last one add up to its size, but at most every REWIND_KEY_MIN frames.
+ * Going to any generation starts from the nearest keyframe or from where
+ * the world is now, whichever is fewer frames away.
+ *
+ * The oldest frames are dropped to keep within the memory budget, which
+ * the copy of the world deltas are taken against counts towards too.
+ * Worlds with Generations rules aren't recorded, as their dying cells
+ * would have to be too.
+ */
+
+// Frames at least between keyframes, so a nearly empty world isn't
+// encoded whole every generation
+#define REWIND_KEY_MIN 16
+// Longest varint of a run
+#define REWIND_RUN_MAX ((sizeof(size_t) * 8 + 6) / 7)
+
+static inline rewind_frame *_frame(rewind_log *log, size_t i) {
+    return &log->frames[(log->first + i) % REWIND_FRAMES];
+}
+
+/*
+ * Cell of the lowest current state bit set in v
+ */
+static inline unsigned int _lowest_cell(world_store v) {
+#ifdef __GNUC__
+    return __builtin_ctz(v) / BITS_PER_CELL;
+#else
+    unsigned int j = 0;
+    for (; !(v & 2); v >>= BITS_PER_CELL, ++j);
+    return j;
+#endif
+}
+
+static inline unsigned int _lowest_bit(uint64_t v) {
+#ifdef __GNUC__
+    return __builtin_ctzll(v);
+#else
+    unsigned int j = 0;
+    for (; !(v & 1); v >>= 1, ++j);
+    return j;
+#endif
+}
+
+static uint8_t *_grow_scratch(rewind_log *log) {
+    size_t cap = log->scratch_cap > 0 ? 2 * log->scratch_cap : 4096;
+    uint8_t *scratch = realloc(log->scratch, cap);
+
+    if (scratch == NULL) {
+        fprintf(stderr, "Could not allocate %lu bytes\n", (unsigned long) cap);
+        exit(EXIT_FAILURE);
+    }
+    log->bytes += cap - log->scratch_cap;
+    log->scratch = scratch;
+    log->scratch_cap = cap;
+    return scratch;
+}
+
+/*
+ * Encode the cells of data that differ from prev into the scratch
+ * buffer, bringing prev's current states up to date, or the live cells
+ * if prev is NULL. Returns the bytes written.
+ *
+ * Which of a block of stores changed is gathered first without branching,
+ * as in a soup about every other store does, unpredictably. Runs short
+ * enough for two bytes, nearly all of them, are written the same way.
+ */
+static inline size_t _encode(rewind_log *log, const world_store *data, world_store *prev, size_t n) {
+    uint8_t *out = log->scratch;
+    size_t len = 0, next = 0;
+
+    for (size_t i0 = 0; i0 < n; i0 += 64) {
+        size_t end = i0 + 64 < n ? i0 + 64 : n;
+        uint64_t changed = 0;
+
+        for (size_t i = i0; i < end; ++i) {
+            world_store d = (data[i] ^ (prev != NULL ? prev[i] : 0)) & CURR_CELL_MASK;
+            changed |= (uint64_t) (d != 0) << (i - i0);
+        }
+        for (; changed != 0; changed &= changed - 1) {
+            size_t i = i0 + _lowest_bit(changed);
+            world_store d = (data[i] ^ (prev != NULL ? prev[i] : 0)) & CURR_CELL_MASK;
+
+            if (prev != NULL) {
+                prev[i] ^= d;
+            }
+            if (len + CELLS_PER_ELEM * REWIND_RUN_MAX > log->scratch_cap) {
+                out = _grow_scratch(log);
+            }
+            for (; d != 0; d &= d - 1) {
+                size_t cell = (i << IDX_DIV) + _lowest_cell(d),
+                       run = cell - next;
+                if (run < 0x4000) {
+                    unsigned int more = run >= 0x80;
+                    out[len] = (uint8_t) (run | more << 7);
+                    out[len + 1] = (uint8_t) (run >> 7);
+                    len += 1 + more;
+                } else {
+                    for (; run >= 0x80; run >>= 7) {
+                        out[len++] = (uint8_t) (run | 0x80);
+                    }
+                    out[len++] = (uint8_t) run;
+                }
+                next = cell + 1;
+            }
+        }
+    }
+    return len;
+}
+
+/*
+ * Flip the current states of the cells encoded in runs
+ */
+static void _apply(world_store *data, const uint8_t *runs, size_t len) {
+    size_t cell = 0;
+
+    for (size_t p = 0; p < len; ++cell) {
+        unsigned int shift = 0;
+        uint8_t byte;
+        do {
+            byte = runs[p++];
+            cell += (size_t) (byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+        data[cell >> IDX_DIV] ^= (world_store) 2 << ((cell & OFFSET_MASK) * BITS_PER_CELL);
+    }
+}
+
+static uint8_t *_copy_runs(rewind_log *log, size_t len) {
+    uint8_t *runs;
+
+    if (len == 0) {
+        return NULL;
+    }
+    runs = malloc(len);
+    if (runs == NULL) {
+        fprintf(stderr, "Could not allocate %lu bytes\n", (unsigned long) len);
+        exit(EXIT_FAILURE);
+    }
+    memcpy(runs, log->scratch, len);
+    log->bytes += len;
+    return runs;
+}
+
+static void _free_delta(rewind_log *log, rewind_frame *f) {
+    log->bytes -= f->delta_len;
+    free(f->delta);
+    f->delta = NULL;
+    f->delta_len = 0;
+}
+
+static void _free_frame(rewind_log *log, rewind_frame *f) {
+    _free_delta(log, f);
+    log->bytes -= f->key_len;
+    free(f->key);
+    f->keyframe = 0;
+    f->key = NULL;
+    f->key_len = 0;
+}
+
+/*
+ * Drop the oldest frame. The next one's delta leads from it, so goes too.
+ */
+static void _drop_oldest(rewind_log *log) {
+    _free_frame(log, _frame(log, 0));
+    log->first = (log->first + 1) % REWIND_FRAMES;
+    log->count--;
+    log->pos--;
+    _free_delta(log, _frame(log, 0));
+}
+
+rewind_log *init_rewind_log(size_t budget) {
+    rewind_log *log = calloc(1, sizeof(rewind_log));
+
+    if (log == NULL) {
+        fprintf(stderr, "Could not allocate %lu bytes\n", (unsigned long) sizeof(rewind_log));
+        exit(EXIT_FAILURE);
+    }
+    log->budget = budget;
+    return log;
+}
+
+void destroy_rewind_log(rewind_log *log) {
+    rewind_reset(log);
+    pages_free(log->prev, log->data_size * sizeof(world_store));
+    free(log->scratch);
+    free(log);
+}
+
+/*
+ * Forget every frame, for when the world is replaced. The next one
+ * recorded starts over.
+ */
+void rewind_reset(rewind_log *log) {
+    for (size_t i = 0; i < log->count; ++i) {
+        _free_frame(log, _frame(log, i));
+    }
+    log->first = log->count = log->pos = 0;
+    log->since_key = log->since_key_frames = log->key_bytes = 0;
+}
+
+/*
+ * A copy of worlds of w's size to take deltas against, if it takes no
+ * more than half the budget
+ */
+static void _fit(rewind_log *log, world *w) {
+    size_t data_bytes = w->data_size * sizeof(world_store);
+
+    rewind_reset(log);
+    if (log->prev != NULL) {
+        log->bytes -= log->data_size * sizeof(world_store);
+    }
+    pages_free(log->prev, log->data_size * sizeof(world_store));
+    log->prev = NULL;
+    log->data_size = w->data_size;
+
+    if (data_bytes > log->budget / 2) {
+        printf("World too big to rewind within %lu MiB\n", (unsigned long) (log->budget >> 20));
+        return;
+    }
+    log->prev = pages_alloc(data_bytes);
+    if (log->prev == NULL) {
+        exit(EXIT_FAILURE);
+    }
+    log->bytes += data_bytes;
+}
+
+/*
+ * Record the world as it is now, unless nothing changed since the last
+ * frame. Frames gone back from are dropped first.
+ */
+void rewind_record(rewind_log *log, world *w) {
+    rewind_frame *f;
+    size_t len = 0;
+
+    if (w->rule.states > 2) {
+        return;
+    }
+    if (w->data_size != log->data_size) {
+        _fit(log, w);
+    }
+    if (log->prev == NULL) {
+        return;
+    }
+
+    while (log->count > log->pos + 1) {
+        _free_frame(log, _frame(log, --log->count));
+    }
+    if (log->count > 0) {
+        len = _encode(log, w->data, log->prev, w->data_size);
+        if (len == 0 && w->generation == _frame(log, log->pos)->generation) {
+            return;
+        }
+    } else {
+        memcpy(log->prev, w->data, w->data_size * sizeof(world_store));
+    }
+    if (log->count == REWIND_FRAMES) {
+        _drop_oldest(log);
+    }
+
+    log->pos = log->count++;
+    f = _frame(log, log->pos);
+    f->generation = w->generation;
+    f->delta = _copy_runs(log, len);
+    f->delta_len = len;
+    log->since_key += len;
+    log->since_key_frames++;
+
+    if (log->count == 1 ||
+            (log->since_key >= log->key_bytes && log->since_key_frames >= REWIND_KEY_MIN)) {
+        len = _encode(log, w->data, NULL, w->data_size);
+        f->keyframe = 1;
+        f->key = _copy_runs(log, len);
+        f->key_len = len;
+        log->since_key = log->since_key_frames = 0;
+        log->key_bytes = len;
+    }
+
+    while (log->bytes > log->budget && log->count > 1) {
+        _drop_oldest(log);
+    }
+}
+
+/*
+ * Take the world to frame target, from a keyframe or where it is now,
+ * whichever is the fewest frames away. Restoring a keyframe counts as a
+ * frame too.
+ */
+static void _go_to(rewind_log *log, world *w, size_t target) {
+    size_t from = log->pos, lo = target, hi = target;
+    size_t distance = from > target ? from - target : target - from;
+
+    for (; lo > 0 && !_frame(log, lo)->keyframe; --lo);
+    for (; hi < log->count && !_frame(log, hi)->keyframe; ++hi);
+    if (_frame(log, lo)->keyframe && target - lo + 1 < distance) {
+        from = lo;
+        distance = target - lo + 1;
+    }
+    if (hi < log->count && hi - target + 1 < distance) {
+        from = hi;
+    }
+    if (from != log->pos) {
+        memset(w->data, 0, w->data_size * sizeof(world_store));
+        _apply(w->data, _frame(log, from)->key, _frame(log, from)->key_len);
+    }
+
+    for (; from > target; --from) {
+        _apply(w->data, _frame(log, from)->delta, _frame(log, from)->delta_len);
+    }
+    for (; from < target; ++from) {
+        _apply(w->data, _frame(log, from + 1)->delta, _frame(log, from + 1)->delta_len);
+    }
+
+    memcpy(log->prev, w->data, w->data_size * sizeof(world_store));
+    log->pos = target;
+    log->since_key = log->since_key_frames = 0;
+    for (size_t i = target; i > lo; --i) {
+        log->since_key += _frame(log, i)->delta_len;
+        log->since_key_frames++;
+    }
+    log->key_bytes = _frame(log, lo)->key_len;
+
+    w->generation = _frame(log, target)->generation;
+    w->state = CALC;
+    // The hashes and statistics of the generations gone back from no
+    // longer hold
+    world_invalidate(w);
+    stats_reset(w);
+}
+
+/*
+ * Go back up to generations frames, as far as they are kept. Returns how
+ * many the world went back.
+ */
+unsigned int rewind_back(rewind_log *log, world *w, unsigned int generations) {
+    size_t back;
+
+    // Anything changed since the last frame is a frame of its own
+    rewind_record(log, w);
+    if (log->count == 0) {
+        return 0;
+    }
+    back = log->pos < generations ? log->pos : generations;
+    if (back > 0) {
+        _go_to(log, w, log->pos - back);
+    }
+    return back;
+}
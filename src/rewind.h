@@ -0,0 +1,64 @@
+#ifndef _REWIND_H
+#define _REWIND_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+
+// Memory for past generations unless set otherwise
+#define REWIND_DEFAULT_BUDGET ((size_t) 512 << 20)
+// Generations kept at most, whatever the budget
+#define REWIND_FRAMES 65536
+
+/*** TYPES ***/
+
+/*
+ * A recorded generation: its cells as changed from the frame before, and
+ * every now and then all of them, both run-length encoded (see rewind.c)
+ */
+struct rewind_frame {
+    uint32_t generation;
+    uint8_t *delta;
+    size_t delta_len;
+    int keyframe;
+    uint8_t *key;
+    size_t key_len;
+};
+typedef struct rewind_frame rewind_frame;
+
+/*
+ * Past generations of a world, a ring of frames with the oldest at first.
+ * The world is at frame pos, and prev is a copy of its stores as they
+ * were recorded there. Frames after pos were gone back from, and are
+ * dropped when the next one is recorded. prev is NULL if the world is too
+ * big to be recorded within the budget.
+ */
+struct rewind_log {
+    rewind_frame frames[REWIND_FRAMES];
+    size_t first;
+    size_t count;
+    size_t pos;
+
+    world_store *prev;
+    size_t data_size;
+    uint8_t *scratch; // runs being encoded
+    size_t scratch_cap;
+
+    size_t budget;
+    size_t bytes; // of prev, scratch and every frame's delta and key
+    size_t since_key; // bytes of deltas since the keyframe before pos
+    size_t since_key_frames;
+    size_t key_bytes; // of the keyframe before pos
+};
+typedef struct rewind_log rewind_log;
+
+/*** FUNCTIONS ***/
+
+rewind_log *init_rewind_log(size_t budget);
+void destroy_rewind_log(rewind_log *log);
+void rewind_reset(rewind_log *log);
+void rewind_record(rewind_log *log, world *w);
+unsigned int rewind_back(rewind_log *log, world *w, unsigned int generations);
+
+#endif
+/* vim: set ft=c : */
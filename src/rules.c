@@ -1,16 +1,381 @@
+#include <ctype.h>
 #include <stdio.h>
+#include <string.h>
 #include "rules.h"
 
-world_store debug_count_rule(world_store state, world_store sum9) {
-    printf("%d ", sum9);
-    return state & 1;
+// Every cell of a neighbourhood but the middle one
+#define NEIGHBOURS 0x1ef
+
+/*
+ * Hensel letters of each neighbour count, in the order of the bits of
+ * born and kept. 0 and 8 have a single configuration and no letter.
+ */
+static const char *RULE_LETTERS[9] = {
+    "", "ce", "ceaikn", "ceaiknjqry", "ceaiknjqrytwz", "ceaiknjqry", "ceaikn", "ce", ""
+};
+
+/*
+ * One neighbourhood (as in rule_lookup) for each letter of 0 to 4
+ * neighbours. 5 to 8 are the complements of 3 to 0 with the same letter.
+ */
+static const uint16_t RULE_SHAPES[5][RULE_LETTERS_MAX] = {
+    { 0x000 },
+    { 0x001, 0x002 },
+    { 0x005, 0x00a, 0x003, 0x028, 0x021, 0x044 },
+    { 0x045, 0x02a, 0x00b, 0x007, 0x062, 0x00d, 0x00e, 0x046, 0x029, 0x061 },
+    { 0x145, 0x0aa, 0x00f, 0x02d, 0x063, 0x047, 0x06a, 0x066, 0x02b, 0x065, 0x069, 0x04e, 0x06c },
+};
+
+static inline unsigned int _letter_count(int n) {
+    size_t len = strlen(RULE_LETTERS[n]);
+    return len ? (unsigned int) len : 1;
+}
+
+static inline uint16_t _all_letters(int n) {
+    return (uint16_t) ((1u << _letter_count(n)) - 1);
+}
+
+static inline uint16_t _shape(int n, unsigned int letter) {
+    return n <= 4 ? RULE_SHAPES[n][letter] : NEIGHBOURS & ~RULE_SHAPES[8 - n][letter];
+}
+
+/*
+ * Neighbourhood turned a quarter turn clockwise, or mirrored left to right
+ */
+static uint16_t _rotate(uint16_t m) {
+    uint16_t r = 0;
+    for (int p = 0; p < 9; ++p) {
+        if ((m >> p) & 1) {
+            r |= 1 << ((p % 3) * 3 + 2 - p / 3);
+        }
+    }
+    return r;
+}
+
+static uint16_t _reflect(uint16_t m) {
+    uint16_t r = 0;
+    for (int p = 0; p < 9; ++p) {
+        if ((m >> p) & 1) {
+            r |= 1 << (p - p % 3 + 2 - p % 3);
+        }
+    }
+    return r;
+}
+
+static inline void _set_next(life_rule *rule, unsigned int idx) {
+    rule->table[idx >> 6] |= (uint64_t) 1 << (idx & 63);
+}
+
+/*
+ * Compile born and kept into everything else. Each configuration sets
+ * its neighbourhood in all 8 orientations. A live cell's 9-cell sum
+ * counts itself, so its neighbour count is one less.
+ */
+static void _compile(life_rule *rule) {
+    rule->range = 1;
+    rule->middle = 0;
+    rule->states = 2;
+    rule->birth_min = rule->birth_max = rule->survive_min = rule->survive_max = 0;
+    rule->birth = rule->survive = 0;
+    rule->totalistic = 1;
+    memset(rule->sum9, 0, sizeof(rule->sum9));
+    memset(rule->table, 0, sizeof(rule->table));
+    memset(rule->columns, 0, sizeof(rule->columns));
+
+    for (int n = 0; n <= 8; ++n) {
+        uint16_t all = _all_letters(n);
+
+        rule->born[n] &= all;
+        rule->kept[n] &= all;
+        rule->birth |= (rule->born[n] != 0) << n;
+        rule->survive |= (rule->kept[n] != 0) << n;
+        rule->totalistic &= (rule->born[n] == 0 || rule->born[n] == all) &&
+            (rule->kept[n] == 0 || rule->kept[n] == all);
+
+        for (unsigned int i = 0; i < _letter_count(n); ++i) {
+            uint16_t m = _shape(n, i);
+            for (int t = 0; t < 8; ++t) {
+                if ((rule->born[n] >> i) & 1) {
+                    _set_next(rule, m);
+                }
+                if ((rule->kept[n] >> i) & 1) {
+                    _set_next(rule, m | 0x10);
+                }
+                m = t == 3 ? _reflect(m) : _rotate(m);
+            }
+        }
+    }
+
+    for (unsigned int n = 0; n <= 9; ++n) {
+        rule->sum9[n] = (n <= 8 && ((rule->birth >> n) & 1) ? RULE_BORN : RULE_DEAD) |
+            (n >= 1 && ((rule->survive >> (n - 1)) & 1) ? RULE_KEPT : RULE_DEAD);
+    }
+
+    // Column codes l, c and r hold bits 0, 1, 2 of each row
+    for (unsigned int l = 0; l < 8; ++l) {
+        for (unsigned int r = 0; r < 8; ++r) {
+            for (unsigned int c = 0; c < 8; ++c) {
+                unsigned int idx = 0;
+                for (int y = 0; y < 3; ++y) {
+                    idx |= (((l >> y) & 1) | ((c >> y) & 1) << 1 | ((r >> y) & 1) << 2) << (3 * y);
+                }
+                rule->columns[l | r << 3] |= rule_lookup(rule, idx) << c;
+            }
+        }
+    }
+}
+
+/*
+ * Totalistic rule from birth and survive masks
+ */
+life_rule make_rule(uint16_t birth, uint16_t survive) {
+    life_rule rule;
+
+    for (int n = 0; n <= 8; ++n) {
+        rule.born[n] = (birth >> n) & 1 ? _all_letters(n) : 0;
+        rule.kept[n] = (survive >> n) & 1 ? _all_letters(n) : 0;
+    }
+    _compile(&rule);
+    return rule;
 }
 
-world_store conways_life(world_store state, world_store sum9) {
-    switch(sum9) {
-        case 3: return 1;
-        case 4: return state & 1;
-        default: return 0;
+/*
+ * Isotropic rule from configurations by neighbour count
+ */
+life_rule make_isotropic_rule(const uint16_t born[9], const uint16_t kept[9]) {
+    life_rule rule;
+
+    memcpy(rule.born, born, sizeof(rule.born));
+    memcpy(rule.kept, kept, sizeof(rule.kept));
+    _compile(&rule);
+    return rule;
+}
+
+/*
+ * Larger than Life rule, or the same totalistic rule for range 1. The
+ * counts are clamped to the size of the box.
+ */
+life_rule make_range_rule(unsigned int range, int middle, unsigned int birth_min,
+        unsigned int birth_max, unsigned int survive_min, unsigned int survive_max) {
+    life_rule rule;
+    unsigned int box = (2 * range + 1) * (2 * range + 1);
+
+    if (range <= 1) {
+        // A live cell counts itself if middle is set
+        uint16_t birth = 0, survive = 0;
+        for (unsigned int n = 0; n <= 8; ++n) {
+            birth |= (n >= birth_min && n <= birth_max) << n;
+            survive |= (n + !!middle >= survive_min && n + !!middle <= survive_max) << n;
+        }
+        return make_rule(birth, survive);
+    }
+
+    rule = make_rule(0, 0);
+    rule.range = range > RULE_RANGE_MAX ? RULE_RANGE_MAX : range;
+    rule.middle = !!middle;
+    rule.birth_min = birth_min > box ? box : birth_min;
+    rule.birth_max = birth_max > box ? box : birth_max;
+    rule.survive_min = survive_min > box ? box : survive_min;
+    rule.survive_max = survive_max > box ? box : survive_max;
+    return rule;
+}
+
+/*
+ * Neighbour counts after a B or S, until the next '/' or the end. A
+ * count alone has all of its configurations, followed by letters only
+ * those, and by '-' and letters all but those.
+ */
+static const char *_parse_counts(const char *str, uint16_t *letters) {
+    memset(letters, 0, 9 * sizeof(uint16_t));
+    while (*str != '\0' && *str != '/') {
+        if (*str < '0' || *str > '8') {
+            return NULL;
+        }
+        int n = *str++ - '0';
+        int minus = *str == '-';
+        uint16_t set = 0;
+
+        str += minus;
+        for (; isalpha((unsigned char) *str); ++str) {
+            const char *l = strchr(RULE_LETTERS[n], tolower((unsigned char) *str));
+            if (l == NULL) {
+                return NULL;
+            }
+            set |= 1 << (l - RULE_LETTERS[n]);
+        }
+        if (minus && set == 0) {
+            return NULL;
+        }
+        letters[n] |= set == 0 ? _all_letters(n) : (minus ? _all_letters(n) & ~set : set);
     }
+    return str;
 }
 
+/*
+ * Parse a number, then what comes after it must be
+ */
+static const char *_parse_number(const char *str, unsigned int *n, const char *after) {
+    if (!isdigit((unsigned char) *str)) {
+        return NULL;
+    }
+    for (*n = 0; isdigit((unsigned char) *str) && *n <= 100000; ++str) {
+        *n = 10 * *n + (*str - '0');
+    }
+    return strncmp(str, after, strlen(after)) == 0 ? str + strlen(after) : NULL;
+}
+
+/*
+ * Larger than Life rulestring as Golly writes it, R5,C0,M1,S34..58,
+ * B34..45,NM. C0 and C2 are two states, more make it a Generations rule.
+ * The Moore (box) neighbourhood only, which is also what a missing N
+ * means.
+ */
+static int _parse_range_rule(const char *str, life_rule *rule) {
+    unsigned int r, c, m, smin, smax, bmin, bmax;
+
+    if ((str = _parse_number(str + 1, &r, ",C")) == NULL ||
+            (str = _parse_number(str, &c, ",M")) == NULL ||
+            (str = _parse_number(str, &m, ",S")) == NULL ||
+            (str = _parse_number(str, &smin, "..")) == NULL ||
+            (str = _parse_number(str, &smax, ",B")) == NULL ||
+            (str = _parse_number(str, &bmin, "..")) == NULL ||
+            (str = _parse_number(str, &bmax, "")) == NULL) {
+        return 0;
+    }
+    if (r < 1 || r > RULE_RANGE_MAX || c == 1 || c > RULE_STATES_MAX || m > 1 ||
+            (*str != '\0' && strcmp(str, ",NM") != 0 && strcmp(str, ",Nm") != 0)) {
+        return 0;
+    }
+    *rule = make_range_rule(r, m, bmin, bmax, smin, smax);
+    rule->states = c ? c : 2;
+    return 1;
+}
+
+/*
+ * Number of states at the end of a Generations rule, with or without a
+ * C in front
+ */
+static const char *_parse_states(const char *str, unsigned int *states) {
+    if (toupper((unsigned char) *str) == 'C') {
+        ++str;
+    }
+    str = _parse_number(str, states, "");
+    return str != NULL && *states >= 2 && *states <= RULE_STATES_MAX ? str : NULL;
+}
+
+/*
+ * Parse a rulestring like B3/S23, B36/S23 or, in Hensel notation,
+ * B2-a/S12, the parts in either order and either case, or a Larger than
+ * Life one. Generations rules add the number of states, as in B2/S/C3,
+ * or are counts alone in the order S/B/C, as in /2/3. Returns 0 if it
+ * isn't valid, leaving rule as it was.
+ */
+int parse_rule(const char *str, life_rule *rule) {
+    uint16_t letters[2][9];
+    int seen[2] = { 0, 0 };
+    unsigned int states = 2;
+
+    if (toupper((unsigned char) *str) == 'R') {
+        return _parse_range_rule(str, rule);
+    }
+
+    // Counts alone are S/B
+    if (isdigit((unsigned char) *str) || *str == '/') {
+        str = _parse_counts(str, letters[1]);
+        if (str == NULL || *str != '/' || (str = _parse_counts(str + 1, letters[0])) == NULL) {
+            return 0;
+        }
+        seen[0] = seen[1] = 1;
+    }
+
+    for (int part = 0; part < 2 && !(seen[0] && seen[1]); ++part) {
+        int which = toupper((unsigned char) *str) == 'B' ? 0 :
+            (toupper((unsigned char) *str) == 'S' ? 1 : -1);
+        if (which < 0 || seen[which]) {
+            return 0;
+        }
+        seen[which] = 1;
+
+        str = _parse_counts(str + 1, letters[which]);
+        if (str == NULL || (part == 0 && *str != '/')) {
+            return 0;
+        }
+        str += part == 0;
+    }
+
+    if (*str == '/' && (str = _parse_states(str + 1, &states)) == NULL) {
+        return 0;
+    }
+    if (*str != '\0') {
+        return 0;
+    }
+
+    *rule = make_isotropic_rule(letters[0], letters[1]);
+    rule->states = states;
+    return 1;
+}
+
+static char *_count_string(const uint16_t *letters, char *str) {
+    for (int n = 0; n <= 8; ++n) {
+        uint16_t all = _all_letters(n), set = letters[n];
+        int count = 0;
+
+        if (set == 0) {
+            continue;
+        }
+        *str++ = '0' + n;
+        if (set == all) {
+            continue;
+        }
+
+        // Whichever of the letters and the rest is shorter
+        for (unsigned int i = 0; i < _letter_count(n); ++i) {
+            count += (set >> i) & 1;
+        }
+        if (2 * count > (int) _letter_count(n)) {
+            *str++ = '-';
+            set = all & ~set;
+        }
+        for (unsigned int i = 0; i < _letter_count(n); ++i) {
+            if ((set >> i) & 1) {
+                *str++ = RULE_LETTERS[n][i];
+            }
+        }
+    }
+    return str;
+}
+
+/*
+ * Rulestring of a rule into str, at least RULE_STRING_LEN long
+ */
+void rule_string(const life_rule *rule, char *str) {
+    if (rule->range > 1) {
+        snprintf(str, RULE_STRING_LEN, "R%u,C%u,M%u,S%u..%u,B%u..%u,NM",
+                rule->range, rule->states > 2 ? rule->states : 0, rule->middle,
+                rule->survive_min, rule->survive_max, rule->birth_min, rule->birth_max);
+        return;
+    }
+    *str++ = 'B';
+    str = _count_string(rule->born, str);
+    *str++ = '/';
+    *str++ = 'S';
+    str = _count_string(rule->kept, str);
+    *str = '\0';
+    if (rule->states > 2) {
+        sprintf(str, "/C%u", rule->states);
+    }
+}
+
+int rule_is_conway(const life_rule *rule) {
+    return rule->totalistic && rule->range == 1 && rule->states == 2 &&
+        rule->birth == CONWAY_BIRTH && rule->survive == CONWAY_SURVIVE;
+}
+
+int rule_equal(const life_rule *a, const life_rule *b) {
+    return memcmp(a->born, b->born, sizeof(a->born)) == 0 &&
+        memcmp(a->kept, b->kept, sizeof(a->kept)) == 0 &&
+        a->range == b->range && a->middle == b->middle &&
+        a->birth_min == b->birth_min && a->birth_max == b->birth_max &&
+        a->survive_min == b->survive_min && a->survive_max == b->survive_max &&
+        a->states == b->states;
+}
@@ -1,12 +1,114 @@
 #ifndef _RULES_H
 #define _RULES_H
 
-#include "world.h"
+#include <stdint.h>
+#include <stdlib.h>
 
-typedef world_store (*rule_calc_func_type) (world_store, world_store);
+// Conway's Life, B3/S23
+#define CONWAY_BIRTH 0x008
+#define CONWAY_SURVIVE 0x00c
 
-world_store debug_count_rule(world_store state, world_store sum9);
-world_store conways_life(world_store state, world_store sum9);
+// Longest rulestring and its terminator. Each count lists at most half
+// of its letters, the rest being written as the ones it leaves out, and
+// a Generations rule ends in /C and its number of states.
+#define RULE_STRING_LEN 88
+
+// Most configurations of one neighbour count up to symmetry, for 4
+#define RULE_LETTERS_MAX 13
+
+// Largest Larger than Life range, whose box count still fits 16 bits
+#define RULE_RANGE_MAX 100
+
+// Most states of a Generations rule, dead and alive included
+#define RULE_STATES_MAX 256
+
+// Leaf codes of a compiled rule, bit 0 for a dead cell and bit 1 for a
+// live one
+#define RULE_DEAD 0x0
+#define RULE_BORN 0x1
+#define RULE_KEPT 0x2
+#define RULE_ALIVE 0x3
+
+/*** TYPES ***/
+
+/*
+ * A Life-like rule. Bit n of birth (survive) is set if a dead (live)
+ * cell with n live neighbours can be alive next.
+ *
+ * Isotropic non-totalistic rules also depend on where the neighbours
+ * are. Bit i of born[n] (kept[n]) is set if a dead (live) cell is alive
+ * next with n neighbours in the ith configuration of Hensel notation
+ * (RULE_LETTERS in rules.c). A rule is totalistic if every count has all
+ * of its configurations or none.
+ *
+ * sum9 is a totalistic rule compiled against the 9-cell sum the engines
+ * count, the cell itself included: the leaf code for each sum, 10 to 15
+ * never being used. table is any rule compiled against the 3x3
+ * neighbourhood (see rule_lookup), and columns the same table for the
+ * byte shuffle kernels: bit c of byte l | r << 3 is the next state with
+ * column codes l, c and r left to right, a column code being the cells
+ * above, at and below as bits 0 to 2.
+ *
+ * Larger than Life rules have a range above 1 and count the live cells
+ * in the (2 range + 1)^2 box around a cell, the cell itself only if
+ * middle is set. A dead (live) cell is alive next if the count is from
+ * birth_min to birth_max (survive_min to survive_max). None of the other
+ * fields apply to them.
+ *
+ * Any of these can be a Generations rule, with more than 2 states. A
+ * live cell that doesn't survive goes through the dying states 2 to
+ * states - 1, one per generation, before it is dead. Dying cells don't
+ * count as alive and can't be born.
+ */
+struct life_rule {
+    uint16_t birth;
+    uint16_t survive;
+    uint16_t born[9];
+    uint16_t kept[9];
+    int totalistic;
+    uint8_t sum9[16];
+    uint64_t table[8];
+    uint8_t columns[64];
+
+    uint16_t range;
+    uint16_t middle;
+    uint16_t birth_min;
+    uint16_t birth_max;
+    uint16_t survive_min;
+    uint16_t survive_max;
+
+    uint16_t states;
+};
+typedef struct life_rule life_rule;
+
+/*** INLINE HELPERS ***/
+
+/*
+ * Next state of a cell from its state and 9-cell sum, totalistic rules
+ * only
+ */
+static inline int rule_next(const life_rule *rule, int alive, unsigned int sum9) {
+    return (rule->sum9[sum9] >> alive) & 1;
+}
+
+/*
+ * Next state of a cell from its 3x3 neighbourhood, rows top to bottom
+ * and cells left to right as bits 0 to 8, so the cell itself is bit 4
+ */
+static inline int rule_lookup(const life_rule *rule, unsigned int idx) {
+    return (rule->table[idx >> 6] >> (idx & 63)) & 1;
+}
+
+/*** FUNCTIONS ***/
+
+life_rule make_rule(uint16_t birth, uint16_t survive);
+life_rule make_isotropic_rule(const uint16_t born[9], const uint16_t kept[9]);
+life_rule make_range_rule(unsigned int range, int middle, unsigned int birth_min,
+        unsigned int birth_max, unsigned int survive_min, unsigned int survive_max);
+int parse_rule(const char *str, life_rule *rule);
+void rule_string(const life_rule *rule, char *str);
+int rule_is_conway(const life_rule *rule);
+int rule_equal(const life_rule *a, const life_rule *b);
 
 #endif
 /* vim: set ft=c : */
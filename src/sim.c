@@ -0,0 +1,486 @@
+#include <string.h>
+#include "sim.h"
+#include "pages.h"
+
+/*
+ * Simulation thread
+ *
+ * Only the simulation thread changes the world. It applies queued edits,
+ * steps the world at its rate, and after either copies the world into a
+ * free snapshot and makes that the current one. So that a world stepped
+ * faster than it is drawn isn't copied every step, it only publishes again
+ * once the current snapshot has been taken, or a reader is waiting for the
+ * world as it is now.
+ *
+ * Every generation it steps to, and every edit, is recorded in the rewind
+ * log (see rewind.c) if there is one, which edits can go back through.
+ *
+ * Snapshots are reclaimed by reference counts. A reader adds a reference
+ * to the current snapshot and checks it is still current, or drops it and
+ * tries again. The simulation thread only reuses a snapshot that isn't
+ * current and has no references, so one reused after a reader loaded it
+ * isn't current again until it has been written, and the reader either
+ * fails the check or gets the whole new copy.
+ */
+
+/*
+ * Rates are a number of steps per second, per frame with an 'f' after
+ * it, or 0 for as fast as possible. Returns 0 if str isn't a rate.
+ */
+int parse_sim_rate(const char *str, sim_rate *rate) {
+    char *end;
+    long int steps = strtol(str, &end, 10);
+
+    if (end == str || steps < 0 || steps > UINT32_MAX) {
+        return 0;
+    }
+    if (*end == 'f' && end[1] == '\0' && steps > 0) {
+        rate->mode = SIM_PER_FRAME;
+    } else if (*end != '\0') {
+        return 0;
+    } else {
+        rate->mode = steps > 0 ? SIM_PER_SECOND : SIM_UNBOUNDED;
+    }
+    rate->steps = steps;
+    return 1;
+}
+
+static inline size_t _decay_size(world *w) {
+    return w->decay != NULL ? (w->data_size + 1) * w->decay_planes * sizeof(world_store) : 0;
+}
+
+/*
+ * Copy the world into snap, keeping its buffers if they are big enough,
+ * or taking bigger ones from pages_alloc. Everything but data and decay
+ * is left out of the copy. Snapshots of a world that isn't simulated can
+ * be taken this way too, as long as whoever took them frees them with
+ * sim_snapshot_free. Returns 0, leaving snap empty, if there isn't the
+ * memory for the copy.
+ */
+int sim_snapshot_copy(sim_snapshot *snap, world *w) {
+    size_t data_size = w->data_size * sizeof(world_store);
+    size_t decay_size = _decay_size(w);
+
+    if (snap->data_cap < data_size) {
+        pages_free(snap->data, snap->data_cap);
+        snap->data = pages_alloc(data_size);
+        snap->data_cap = snap->data != NULL ? data_size : 0;
+    }
+    if (snap->decay_cap < decay_size) {
+        pages_free(snap->decay, snap->decay_cap);
+        snap->decay = pages_alloc(decay_size);
+        snap->decay_cap = snap->decay != NULL ? decay_size : 0;
+    }
+    if (snap->data == NULL || (decay_size > 0 && snap->decay == NULL)) {
+        sim_snapshot_free(snap);
+        return 0;
+    }
+    memcpy(snap->data, w->data, data_size);
+    if (decay_size > 0) {
+        memcpy(snap->decay, w->decay, decay_size);
+    }
+
+    snap->w = *w;
+    snap->w.data = snap->data;
+    snap->w.decay = w->decay != NULL ? snap->decay : NULL;
+    snap->w.temp_calc = NULL;
+    snap->w.range_cells = NULL;
+    snap->w.board = NULL;
+    snap->w.block = NULL;
+    snap->w.pool = NULL;
+    snap->w.tile_changed = NULL;
+    snap->w.tile_active = NULL;
+    snap->w.band_hash = NULL;
+    snap->w.history = NULL;
+    snap->w.engine_data = NULL;
+    snap->w.tile_live = NULL;
+    snap->w.band_stats = NULL;
+    snap->w.stats_history = NULL;
+    return 1;
+}
+
+/*
+ * Give back a snapshot's buffers
+ */
+void sim_snapshot_free(sim_snapshot *snap) {
+    pages_free(snap->data, snap->data_cap);
+    pages_free(snap->decay, snap->decay_cap);
+    snap->data = snap->decay = NULL;
+    snap->data_cap = snap->decay_cap = 0;
+}
+
+/*
+ * Publish the world as version seq, unless every snapshot is held or
+ * there isn't the memory to copy it. Returns 0 if it wasn't published.
+ */
+static int _publish(sim *s, uint64_t seq, float rate) {
+    sim_snapshot *current = SDL_AtomicGetPtr(&s->current);
+    sim_snapshot *snap = NULL;
+
+    for (int i = 0; i < SIM_SNAPSHOTS; ++i) {
+        if (&s->snaps[i] != current && SDL_AtomicGet(&s->snaps[i].refs) == 0) {
+            snap = &s->snaps[i];
+            break;
+        }
+    }
+    if (snap == NULL) {
+        return 0;
+    }
+
+    // Edits aren't counted until stepped, but the statistics shown have
+    // to be of this world
+    if (!s->w->stats_valid) {
+        world_census(s->w);
+    }
+    if (!sim_snapshot_copy(snap, s->w)) {
+        // Snapshots nobody holds keep their buffers for next time, which
+        // for a big world can be most of the memory there is
+        for (int i = 0; i < SIM_SNAPSHOTS; ++i) {
+            if (&s->snaps[i] != current && SDL_AtomicGet(&s->snaps[i].refs) == 0) {
+                sim_snapshot_free(&s->snaps[i]);
+            }
+        }
+        if (!sim_snapshot_copy(snap, s->w)) {
+            return 0;
+        }
+    }
+    snap->seq = seq;
+    snap->rate = rate;
+    SDL_AtomicSet(&s->taken, 0);
+    SDL_AtomicSetPtr(&s->current, snap);
+    return 1;
+}
+
+static inline int _should_publish(sim *s) {
+    return s->published != s->version && (s->wanted || SDL_AtomicGet(&s->taken));
+}
+
+static void _step(sim *s, int half) {
+    if (half) {
+        world_half_step(s->w);
+    } else {
+        world_step(s->w);
+    }
+}
+
+/*
+ * Record the world in the rewind log. A window onto a pattern its engine
+ * keeps isn't all of it, so isn't recorded.
+ */
+static inline void _remember(sim *s) {
+    if (s->rewind != NULL && !world_is_window(s->w)) {
+        rewind_record(s->rewind, s->w);
+    }
+}
+
+static void _apply(sim *s, sim_command cmd) {
+    world_cell_pos pos;
+
+    switch (cmd.type) {
+        case SIM_INVERT:
+            if (s->w->state == SHIFT) {
+                _step(s, 1);
+            }
+            pos.w = s->w;
+            pos.x = cmd.x;
+            pos.y = cmd.y;
+            pos.cell_val = NULL;
+            invert_cell(&pos);
+            break;
+        case SIM_FILL:
+            fill(s->w, cmd.fill);
+            break;
+        case SIM_HALF_STEP:
+            _step(s, 1);
+            break;
+        case SIM_FINISH_STEP:
+            if (s->w->state != CALC) {
+                _step(s, 1);
+            }
+            break;
+        case SIM_REPLACE:
+            s->replaced = s->w;
+            s->w = cmd.w;
+            if (s->rewind != NULL) {
+                rewind_reset(s->rewind);
+            }
+            break;
+        case SIM_REWIND:
+            if (s->rewind != NULL) {
+                rewind_back(s->rewind, s->w, cmd.generations);
+            }
+            return;
+    }
+    _remember(s);
+}
+
+/*
+ * Whether a running world is due a step. If not, wait is set to how long
+ * until it is, or 0 if that depends on the renderer. Called with the
+ * lock held.
+ */
+static int _due(sim *s, Uint32 *wait) {
+    Uint32 now = SDL_GetTicks();
+    uint64_t due;
+
+    *wait = 0;
+    switch (s->rate.mode) {
+        case SIM_UNBOUNDED:
+            return 1;
+        case SIM_PER_FRAME:
+            return s->budget > 0;
+        case SIM_PER_SECOND:
+            due = (uint64_t) (now - s->since) * s->rate.steps / 1000;
+            if (due > s->since_steps + s->rate.steps) {
+                // More than a second behind, so the world is too slow for
+                // the rate: carry on from now rather than catch up
+                s->since = now;
+                s->since_steps = 0;
+                return 1;
+            } else if (due > s->since_steps) {
+                return 1;
+            }
+            *wait = (s->since_steps + 1) * 1000 / s->rate.steps - (now - s->since) + 1;
+            return 0;
+    }
+    return 0;
+}
+
+static void _count_step(sim *s) {
+    Uint32 now = SDL_GetTicks();
+
+    s->budget -= s->budget > 0;
+    s->since_steps++;
+    s->rate_steps++;
+    if (now - s->rate_since >= 1000) {
+        s->measured = s->rate_steps * 1000.f / (now - s->rate_since);
+        s->rate_since = now;
+        s->rate_steps = 0;
+    }
+}
+
+static int _run(void *data) {
+    sim *s = data;
+    int stalled = 0;
+
+    SDL_LockMutex(s->lock);
+    while (!s->quit) {
+        Uint32 wait = 0;
+
+        if (s->queued > 0) {
+            sim_command cmd = s->queue[s->head];
+            s->head = (s->head + 1) % SIM_QUEUE;
+            s->queued--;
+            s->busy = 1;
+            SDL_UnlockMutex(s->lock);
+
+            _apply(s, cmd);
+
+            SDL_LockMutex(s->lock);
+            s->busy = 0;
+            s->version++;
+            SDL_CondBroadcast(s->space);
+        } else if (s->running && _due(s, &wait)) {
+            int half = s->half;
+            SDL_UnlockMutex(s->lock);
+
+            _step(s, half);
+            _remember(s);
+
+            SDL_LockMutex(s->lock);
+            _count_step(s);
+            s->version++;
+        } else if (stalled || !_should_publish(s)) {
+            // With every snapshot held, try again soon
+            if (stalled && (wait == 0 || wait > 1)) {
+                wait = 1;
+            }
+            if (wait > 0) {
+                SDL_CondWaitTimeout(s->wake, s->lock, wait);
+            } else {
+                SDL_CondWait(s->wake, s->lock);
+            }
+            stalled = 0;
+            continue;
+        }
+
+        if (_should_publish(s)) {
+            uint64_t version = s->version;
+            float rate = s->running ? s->measured : 0;
+            SDL_UnlockMutex(s->lock);
+
+            stalled = !_publish(s, version, rate);
+
+            SDL_LockMutex(s->lock);
+            if (!stalled) {
+                s->published = version;
+                s->wanted = 0;
+                SDL_CondBroadcast(s->space);
+            }
+        }
+    }
+    SDL_UnlockMutex(s->lock);
+
+    return 0;
+}
+
+/*
+ * Past generations are kept within rewind_budget bytes, or not at all
+ * if it is 0
+ */
+sim *init_sim(world *w, sim_rate rate, size_t rewind_budget) {
+    sim *s = calloc(1, sizeof(sim));
+
+    s->w = w;
+    s->rate = rate;
+    if (rewind_budget > 0) {
+        s->rewind = init_rewind_log(rewind_budget);
+        _remember(s);
+    }
+    s->since = s->rate_since = SDL_GetTicks();
+    // Readers need a snapshot from the start
+    if (!_publish(s, 0, 0)) {
+        exit(EXIT_FAILURE);
+    }
+
+    s->lock = SDL_CreateMutex();
+    s->wake = SDL_CreateCond();
+    s->space = SDL_CreateCond();
+    s->thread = SDL_CreateThread(_run, "simulation", s);
+    if (s->thread == NULL) {
+        printf("Could not create simulation thread: %s\n", SDL_GetError());
+        exit(EXIT_FAILURE);
+    }
+
+    return s;
+}
+
+/*
+ * Every snapshot has to have been released
+ */
+void destroy_sim(sim *s) {
+    SDL_LockMutex(s->lock);
+    s->quit = 1;
+    SDL_CondSignal(s->wake);
+    SDL_UnlockMutex(s->lock);
+    SDL_WaitThread(s->thread, NULL);
+
+    SDL_DestroyCond(s->wake);
+    SDL_DestroyCond(s->space);
+    SDL_DestroyMutex(s->lock);
+    for (int i = 0; i < SIM_SNAPSHOTS; ++i) {
+        sim_snapshot_free(&s->snaps[i]);
+    }
+    if (s->rewind != NULL) {
+        destroy_rewind_log(s->rewind);
+    }
+    free(s);
+}
+
+/*
+ * Queue an edit, waiting for room if the queue is full
+ */
+void sim_command_push(sim *s, sim_command cmd) {
+    SDL_LockMutex(s->lock);
+    while (s->queued == SIM_QUEUE) {
+        SDL_CondWait(s->space, s->lock);
+    }
+    s->queue[(s->head + s->queued) % SIM_QUEUE] = cmd;
+    s->queued++;
+    SDL_CondSignal(s->wake);
+    SDL_UnlockMutex(s->lock);
+}
+
+void sim_set_running(sim *s, int running, int half) {
+    SDL_LockMutex(s->lock);
+    if (running != s->running || half != s->half) {
+        s->since = s->rate_since = SDL_GetTicks();
+        s->since_steps = s->rate_steps = 0;
+        s->budget = 0;
+        s->measured = 0;
+        s->running = running;
+        s->half = half;
+        // Publish the rate going to 0
+        s->version++;
+        SDL_CondSignal(s->wake);
+    }
+    SDL_UnlockMutex(s->lock);
+}
+
+/*
+ * A frame was drawn: steps per frame can go on, and a snapshot the
+ * renderer took can be followed by the next
+ */
+void sim_frame_drawn(sim *s) {
+    SDL_LockMutex(s->lock);
+    if (s->rate.mode == SIM_PER_FRAME && s->running) {
+        s->budget = s->budget + s->rate.steps < 2 * s->rate.steps ?
+            s->budget + s->rate.steps : 2 * s->rate.steps;
+        SDL_CondSignal(s->wake);
+    } else if (s->published != s->version) {
+        SDL_CondSignal(s->wake);
+    }
+    SDL_UnlockMutex(s->lock);
+}
+
+/*
+ * The current snapshot, without waiting for anything. It stays as it is
+ * until released.
+ */
+sim_snapshot *sim_snapshot_acquire(sim *s) {
+    for (;;) {
+        sim_snapshot *snap = SDL_AtomicGetPtr(&s->current);
+        SDL_AtomicIncRef(&snap->refs);
+        if (SDL_AtomicGetPtr(&s->current) == snap) {
+            SDL_AtomicSet(&s->taken, 1);
+            return snap;
+        }
+        SDL_AtomicAdd(&snap->refs, -1);
+    }
+}
+
+/*
+ * A snapshot with every edit queued so far in it, waiting for the
+ * simulation thread to publish one if the current one is older
+ */
+sim_snapshot *sim_snapshot_latest(sim *s) {
+    SDL_LockMutex(s->lock);
+    while (s->queued > 0 || s->busy) {
+        SDL_CondWait(s->space, s->lock);
+    }
+    if (s->published != s->version) {
+        uint64_t version = s->version;
+        s->wanted = 1;
+        SDL_CondSignal(s->wake);
+        while (s->published < version) {
+            SDL_CondWait(s->space, s->lock);
+        }
+    }
+    SDL_UnlockMutex(s->lock);
+
+    return sim_snapshot_acquire(s);
+}
+
+void sim_snapshot_release(sim_snapshot *snap) {
+    SDL_AtomicAdd(&snap->refs, -1);
+}
+
+/*
+ * Step w from now on instead, and return the world it replaces once it
+ * isn't stepped any more. Snapshots of it stay as they are.
+ */
+world *sim_replace_world(sim *s, world *w) {
+    sim_command cmd = {SIM_REPLACE, 0, 0, EMPTY, w, 0};
+    world *old;
+
+    sim_command_push(s, cmd);
+    SDL_LockMutex(s->lock);
+    while (s->queued > 0 || s->busy) {
+        SDL_CondWait(s->space, s->lock);
+    }
+    old = s->replaced;
+    s->replaced = NULL;
+    SDL_UnlockMutex(s->lock);
+
+    return old;
+}
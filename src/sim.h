@@ -0,0 +1,130 @@
+#ifndef _SIM_H
+#define _SIM_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#ifdef __unix__
+#include <SDL2/SDL.h>
+#else
+#include <SDL.h>
+#endif
+
+#include "world.h"
+#include "fills.h"
+#include "rewind.h"
+
+// Edits waiting for the simulation thread
+#define SIM_QUEUE 64
+// Snapshots that can be published or held at once
+#define SIM_SNAPSHOTS 8
+
+/*** TYPES ***/
+
+/*
+ * How fast a running world is stepped: as fast as it can be, a number
+ * of (half or whole) steps per second, or per frame drawn
+ */
+enum sim_rate_mode { SIM_UNBOUNDED=0, SIM_PER_SECOND=1, SIM_PER_FRAME=2 };
+typedef enum sim_rate_mode sim_rate_mode;
+
+struct sim_rate {
+    sim_rate_mode mode;
+    unsigned int steps;
+};
+typedef struct sim_rate sim_rate;
+
+enum sim_command_type {
+    SIM_INVERT=0, SIM_FILL=1, SIM_HALF_STEP=2, SIM_FINISH_STEP=3, SIM_REPLACE=4,
+    SIM_REWIND=5
+};
+typedef enum sim_command_type sim_command_type;
+
+struct sim_command {
+    sim_command_type type;
+    uint32_t x;
+    uint32_t y;
+    fill_type fill;
+    world *w; // for SIM_REPLACE
+    unsigned int generations; // for SIM_REWIND
+};
+typedef struct sim_command sim_command;
+
+/*
+ * An immutable copy of the world as it was after a step or edit, stamped
+ * with the version it was published at. w has the world's fields with
+ * data and decay of its own, and nothing else, so it can only be read and
+ * serialized. A snapshot is kept until it is released, however long that
+ * takes, and the simulation thread only reuses ones nobody holds.
+ */
+struct sim_snapshot {
+    world w;
+    uint64_t seq;
+    float rate; // steps per second over the last second
+    SDL_atomic_t refs;
+
+    world_store *data;
+    size_t data_cap;
+    world_store *decay;
+    size_t decay_cap;
+};
+typedef struct sim_snapshot sim_snapshot;
+
+/*
+ * Steps a world on its own thread, which is the only one to touch it.
+ * Edits are queued and applied between steps, and the world is copied
+ * into snapshots for everything else to read: the renderer, saves and
+ * the clipboard. Readers take the current snapshot without a lock, and
+ * the simulation thread never waits for them.
+ */
+struct sim {
+    world *w;
+    rewind_log *rewind; // past generations of w, if kept
+
+    SDL_Thread *thread;
+    SDL_mutex *lock;
+    SDL_cond *wake;
+    SDL_cond *space; // the queue has room, or a snapshot was published
+
+    sim_command queue[SIM_QUEUE];
+    unsigned int head;
+    unsigned int queued;
+    world *replaced;
+
+    sim_snapshot snaps[SIM_SNAPSHOTS];
+    void *current; // the newest snapshot, read and written atomically
+    SDL_atomic_t taken; // current has been acquired since it was published
+    uint64_t version; // counts changes to what snapshots show
+    uint64_t published; // the version of current
+    int wanted; // a reader is waiting for the world as it is now
+
+    sim_rate rate;
+    int running;
+    int half;
+    int busy; // applying a command
+    int quit;
+    unsigned int budget; // steps left for this frame
+    Uint32 since; // when since_steps started, to keep to a rate per second
+    uint64_t since_steps;
+    Uint32 rate_since; // when rate_steps started, to measure the rate
+    unsigned int rate_steps;
+    float measured;
+};
+typedef struct sim sim;
+
+/*** FUNCTIONS ***/
+
+int parse_sim_rate(const char *str, sim_rate *rate);
+sim *init_sim(world *w, sim_rate rate, size_t rewind_budget);
+void destroy_sim(sim *s);
+void sim_command_push(sim *s, sim_command cmd);
+void sim_set_running(sim *s, int running, int half);
+void sim_frame_drawn(sim *s);
+sim_snapshot *sim_snapshot_acquire(sim *s);
+sim_snapshot *sim_snapshot_latest(sim *s);
+void sim_snapshot_release(sim_snapshot *snap);
+int sim_snapshot_copy(sim_snapshot *snap, world *w);
+void sim_snapshot_free(sim_snapshot *snap);
+world *sim_replace_world(sim *s, world *w);
+
+#endif
+/* vim: set ft=c : */
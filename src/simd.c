@@ -0,0 +1,702 @@
+#include "kernels.h"
+
+#ifdef HAVE_X86_KERNELS
+#include <immintrin.h>
+
+/*
+ * x86 vector versions of the bitwise kernels. Each function is compiled
+ * for its own instruction set, so the rest of the binary stays portable
+ * and get_kernel() picks one at runtime.
+ */
+
+#ifdef __GNUC__
+#define TARGET(isa) __attribute__((target(isa)))
+#else
+#define TARGET(isa)
+#endif
+
+/*
+ * Block b of a guarded row, blocks being bits wide. The row's own cells
+ * start at block BOARD_BITS / bits. Bits past the block are left in.
+ */
+static inline uint32_t _row_block(const board_word *row, size_t b, unsigned int bits) {
+    return (uint32_t) (row[b * bits / BOARD_BITS] >> (b * bits % BOARD_BITS));
+}
+
+/*** SSE4.2: 2 board words, 4 world_stores per register ***/
+
+TARGET("sse4.2")
+static void _sse42_gather(const world_store *data, board_word *lin, size_t n) {
+    const __m128i m1 = _mm_set1_epi32(0x55555555),
+                  m2 = _mm_set1_epi32(0x33333333),
+                  m4 = _mm_set1_epi32(0x0f0f0f0f),
+                  m8 = _mm_set1_epi32(0x00ff00ff),
+                  m16 = _mm_set1_epi32(0x0000ffff);
+    size_t j;
+
+    for (j = 0; j + 4 <= n; j += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *) (data + j));
+        v = _mm_and_si128(_mm_srli_epi32(v, 1), m1);
+        v = _mm_and_si128(_mm_or_si128(v, _mm_srli_epi32(v, 1)), m2);
+        v = _mm_and_si128(_mm_or_si128(v, _mm_srli_epi32(v, 2)), m4);
+        v = _mm_and_si128(_mm_or_si128(v, _mm_srli_epi32(v, 4)), m8);
+        v = _mm_and_si128(_mm_or_si128(v, _mm_srli_epi32(v, 8)), m16);
+        _mm_storel_epi64((__m128i *) (lin + j / STORE_CELLS_PER_WORD), _mm_packus_epi32(v, v));
+    }
+    _gather_from(data, lin, j, n);
+}
+
+TARGET("sse4.2")
+static void _sse42_scatter(const board_word *lin, world_store *data, size_t n) {
+    const __m128i m1 = _mm_set1_epi32(0x55555555),
+                  m2 = _mm_set1_epi32(0x33333333),
+                  m4 = _mm_set1_epi32(0x0f0f0f0f),
+                  m8 = _mm_set1_epi32(0x00ff00ff),
+                  curr = _mm_set1_epi32((int) CURR_CELL_MASK);
+    size_t j;
+
+    for (j = 0; j + 4 <= n; j += 4) {
+        __m128i v = _mm_cvtepu16_epi32(_mm_loadl_epi64((const __m128i *) (lin + j / STORE_CELLS_PER_WORD)));
+        v = _mm_and_si128(_mm_or_si128(v, _mm_slli_epi32(v, 8)), m8);
+        v = _mm_and_si128(_mm_or_si128(v, _mm_slli_epi32(v, 4)), m4);
+        v = _mm_and_si128(_mm_or_si128(v, _mm_slli_epi32(v, 2)), m2);
+        v = _mm_and_si128(_mm_or_si128(v, _mm_slli_epi32(v, 1)), m1);
+
+        __m128i d = _mm_loadu_si128((const __m128i *) (data + j));
+        d = _mm_or_si128(_mm_and_si128(d, curr), v);
+        _mm_storeu_si128((__m128i *) (data + j), d);
+    }
+    _scatter_from(lin, data, j, n);
+}
+
+TARGET("sse4.2")
+static void _sse42_row_sums(const board_word *row, board_word *s0, board_word *s1, size_t words) {
+    size_t k;
+
+    for (k = 0; k + 2 <= words; k += 2) {
+        __m128i prev = _mm_loadu_si128((const __m128i *) (row + k)),
+                mid = _mm_loadu_si128((const __m128i *) (row + k + 1)),
+                next = _mm_loadu_si128((const __m128i *) (row + k + 2));
+        __m128i left = _mm_or_si128(_mm_slli_epi64(mid, 1), _mm_srli_epi64(prev, BOARD_BITS - 1)),
+                right = _mm_or_si128(_mm_srli_epi64(mid, 1), _mm_slli_epi64(next, BOARD_BITS - 1)),
+                lm = _mm_xor_si128(left, mid);
+
+        _mm_storeu_si128((__m128i *) (s0 + k), _mm_xor_si128(lm, right));
+        _mm_storeu_si128((__m128i *) (s1 + k),
+                _mm_or_si128(_mm_and_si128(left, mid), _mm_and_si128(right, lm)));
+    }
+    _row_sums_from(row, s0, s1, k, words);
+}
+
+TARGET("sse4.2")
+static void _sse42_life_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        board_word *out, size_t words) {
+    size_t k;
+
+    for (k = 0; k + 2 <= words; k += 2) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *) (up->s0 + k)),
+                a1 = _mm_loadu_si128((const __m128i *) (up->s1 + k)),
+                b0 = _mm_loadu_si128((const __m128i *) (mid->s0 + k)),
+                b1 = _mm_loadu_si128((const __m128i *) (mid->s1 + k)),
+                c0 = _mm_loadu_si128((const __m128i *) (down->s0 + k)),
+                c1 = _mm_loadu_si128((const __m128i *) (down->s1 + k)),
+                alive = _mm_loadu_si128((const __m128i *) (mid->row + k + 1));
+
+        __m128i x0 = _mm_xor_si128(a0, b0),
+                sum0 = _mm_xor_si128(x0, c0),
+                carry = _mm_or_si128(_mm_and_si128(a0, b0), _mm_and_si128(c0, x0)),
+                x1 = _mm_xor_si128(a1, b1),
+                t = _mm_xor_si128(x1, c1),
+                maj = _mm_or_si128(_mm_and_si128(a1, b1), _mm_and_si128(c1, x1)),
+                sum1 = _mm_xor_si128(t, carry),
+                z = _mm_and_si128(t, carry),
+                sum2 = _mm_xor_si128(maj, z),
+                sum3 = _mm_and_si128(maj, z);
+
+        __m128i born = _mm_and_si128(_mm_andnot_si128(sum2, sum1), sum0),
+                keep = _mm_and_si128(_mm_andnot_si128(_mm_or_si128(sum1, sum0), sum2), alive);
+        _mm_storeu_si128((__m128i *) (out + k), _mm_andnot_si128(sum3, _mm_or_si128(born, keep)));
+    }
+    _life_row_from(up, mid, down, out, k, words);
+}
+
+TARGET("sse4.2")
+static inline __m128i _sse42_select(__m128i sel, __m128i a, __m128i b) {
+    return _mm_xor_si128(a, _mm_and_si128(sel, _mm_xor_si128(a, b)));
+}
+
+TARGET("sse4.2")
+static void _sse42_rule_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t words) {
+    unsigned int r[10];
+    __m128i leaf[4];
+    size_t k;
+
+    for (int n = 0; n < 10; ++n) {
+        r[n] = rule->sum9[n];
+    }
+    leaf[RULE_DEAD] = _mm_setzero_si128();
+    leaf[RULE_ALIVE] = _mm_set1_epi32(-1);
+
+    for (k = 0; k + 2 <= words; k += 2) {
+        __m128i a0 = _mm_loadu_si128((const __m128i *) (up->s0 + k)),
+                a1 = _mm_loadu_si128((const __m128i *) (up->s1 + k)),
+                b0 = _mm_loadu_si128((const __m128i *) (mid->s0 + k)),
+                b1 = _mm_loadu_si128((const __m128i *) (mid->s1 + k)),
+                c0 = _mm_loadu_si128((const __m128i *) (down->s0 + k)),
+                c1 = _mm_loadu_si128((const __m128i *) (down->s1 + k)),
+                alive = _mm_loadu_si128((const __m128i *) (mid->row + k + 1));
+
+        __m128i x0 = _mm_xor_si128(a0, b0),
+                sum0 = _mm_xor_si128(x0, c0),
+                carry = _mm_or_si128(_mm_and_si128(a0, b0), _mm_and_si128(c0, x0)),
+                x1 = _mm_xor_si128(a1, b1),
+                t = _mm_xor_si128(x1, c1),
+                maj = _mm_or_si128(_mm_and_si128(a1, b1), _mm_and_si128(c1, x1)),
+                sum1 = _mm_xor_si128(t, carry),
+                z = _mm_and_si128(t, carry),
+                sum2 = _mm_xor_si128(maj, z),
+                sum3 = _mm_and_si128(maj, z);
+
+        leaf[RULE_BORN] = _mm_xor_si128(alive, leaf[RULE_ALIVE]);
+        leaf[RULE_KEPT] = alive;
+
+        __m128i low = _sse42_select(sum1,
+                        _sse42_select(sum0, leaf[r[0]], leaf[r[1]]),
+                        _sse42_select(sum0, leaf[r[2]], leaf[r[3]])),
+                high = _sse42_select(sum1,
+                        _sse42_select(sum0, leaf[r[4]], leaf[r[5]]),
+                        _sse42_select(sum0, leaf[r[6]], leaf[r[7]])),
+                top = _sse42_select(sum0, leaf[r[8]], leaf[r[9]]);
+        _mm_storeu_si128((__m128i *) (out + k),
+                _sse42_select(sum3, _sse42_select(sum2, low, high), top));
+    }
+    _rule_row_from(up, mid, down, rule, out, k, words);
+}
+
+/*
+ * Column codes (see rules.h) of 16 cells, one per byte, from their bits
+ * in the rows above, at and below
+ */
+TARGET("sse4.2")
+static inline __m128i _sse42_columns(uint32_t u, uint32_t m, uint32_t d) {
+    const __m128i spread = _mm_setr_epi8(0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1),
+                  bits = _mm_set1_epi64x((long long) 0x8040201008040201ull);
+    __m128i vu = _mm_shuffle_epi8(_mm_cvtsi32_si128((int) u), spread),
+            vm = _mm_shuffle_epi8(_mm_cvtsi32_si128((int) m), spread),
+            vd = _mm_shuffle_epi8(_mm_cvtsi32_si128((int) d), spread);
+
+    vu = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(vu, bits), bits), _mm_set1_epi8(1));
+    vm = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(vm, bits), bits), _mm_set1_epi8(2));
+    vd = _mm_and_si128(_mm_cmpeq_epi8(_mm_and_si128(vd, bits), bits), _mm_set1_epi8(4));
+    return _mm_or_si128(_mm_or_si128(vu, vm), vd);
+}
+
+/*
+ * Next states of 16 cells from their column codes and their left and
+ * right neighbours'. l and r pick a byte of the table, which takes four
+ * shuffles and a blend on bits 4 and 5, and c the bit in it.
+ */
+TARGET("sse4.2")
+static inline uint32_t _sse42_lookup(__m128i l, __m128i c, __m128i r, const __m128i *table) {
+    const __m128i bits = _mm_set1_epi64x((long long) 0x8040201008040201ull);
+    __m128i i = _mm_or_si128(l, _mm_slli_epi16(r, 3)),
+            sel4 = _mm_slli_epi16(i, 3),
+            sel5 = _mm_slli_epi16(i, 2),
+            lo = _mm_blendv_epi8(_mm_shuffle_epi8(table[0], i), _mm_shuffle_epi8(table[1], i), sel4),
+            hi = _mm_blendv_epi8(_mm_shuffle_epi8(table[2], i), _mm_shuffle_epi8(table[3], i), sel4),
+            bit = _mm_shuffle_epi8(bits, c),
+            next = _mm_blendv_epi8(lo, hi, sel5);
+    return (uint32_t) _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_and_si128(next, bit), bit));
+}
+
+TARGET("sse4.2")
+static void _sse42_table_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t words) {
+    __m128i table[4], prev, curr, next;
+    size_t b = BOARD_BITS / 16;
+
+    for (int i = 0; i < 4; ++i) {
+        table[i] = _mm_loadu_si128((const __m128i *) (rule->columns + 16 * i));
+    }
+
+    // Blocks of 16 cells, each with the ones either side for the cells
+    // at its ends
+    prev = _sse42_columns(_row_block(up->row, b - 1, 16),
+            _row_block(mid->row, b - 1, 16), _row_block(down->row, b - 1, 16));
+    curr = _sse42_columns(_row_block(up->row, b, 16),
+            _row_block(mid->row, b, 16), _row_block(down->row, b, 16));
+
+    for (size_t k = 0; k < words; ++k) {
+        board_word cells = 0;
+        for (unsigned int q = 0; q < BOARD_BITS / 16; ++q, ++b) {
+            next = _sse42_columns(_row_block(up->row, b + 1, 16),
+                    _row_block(mid->row, b + 1, 16), _row_block(down->row, b + 1, 16));
+            cells |= (board_word) _sse42_lookup(_mm_alignr_epi8(curr, prev, 15), curr,
+                    _mm_alignr_epi8(next, curr, 1), table) << (16 * q);
+            prev = curr;
+            curr = next;
+        }
+        out[k] = cells;
+    }
+}
+
+TARGET("sse4.2")
+static void _sse42_shift(world_store *data, size_t start, size_t end, shift_sums *sums) {
+    _shift_from(data, start, end, sums, 1);
+}
+
+const bitwise_kernel SSE42_KERNEL = {
+    "sse4.2",
+    _sse42_gather,
+    _sse42_scatter,
+    _sse42_row_sums,
+    _sse42_life_row,
+    _sse42_rule_row,
+    _sse42_table_row,
+    _sse42_shift,
+};
+
+/*** AVX2: 4 board words, 8 world_stores per register ***/
+
+TARGET("avx2")
+static void _avx2_gather(const world_store *data, board_word *lin, size_t n) {
+    const __m256i m1 = _mm256_set1_epi32(0x55555555),
+                  m2 = _mm256_set1_epi32(0x33333333),
+                  m4 = _mm256_set1_epi32(0x0f0f0f0f),
+                  m8 = _mm256_set1_epi32(0x00ff00ff),
+                  m16 = _mm256_set1_epi32(0x0000ffff);
+    size_t j;
+
+    for (j = 0; j + 8 <= n; j += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *) (data + j));
+        v = _mm256_and_si256(_mm256_srli_epi32(v, 1), m1);
+        v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi32(v, 1)), m2);
+        v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi32(v, 2)), m4);
+        v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi32(v, 4)), m8);
+        v = _mm256_and_si256(_mm256_or_si256(v, _mm256_srli_epi32(v, 8)), m16);
+        // Packing works per 128-bit lane, pull both halves together after
+        v = _mm256_permute4x64_epi64(_mm256_packus_epi32(v, v), 0x08);
+        _mm_storeu_si128((__m128i *) (lin + j / STORE_CELLS_PER_WORD), _mm256_castsi256_si128(v));
+    }
+    _gather_from(data, lin, j, n);
+}
+
+TARGET("avx2")
+static void _avx2_scatter(const board_word *lin, world_store *data, size_t n) {
+    const __m256i m1 = _mm256_set1_epi32(0x55555555),
+                  m2 = _mm256_set1_epi32(0x33333333),
+                  m4 = _mm256_set1_epi32(0x0f0f0f0f),
+                  m8 = _mm256_set1_epi32(0x00ff00ff),
+                  curr = _mm256_set1_epi32((int) CURR_CELL_MASK);
+    size_t j;
+
+    for (j = 0; j + 8 <= n; j += 8) {
+        __m256i v = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i *) (lin + j / STORE_CELLS_PER_WORD)));
+        v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 8)), m8);
+        v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 4)), m4);
+        v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 2)), m2);
+        v = _mm256_and_si256(_mm256_or_si256(v, _mm256_slli_epi32(v, 1)), m1);
+
+        __m256i d = _mm256_loadu_si256((const __m256i *) (data + j));
+        d = _mm256_or_si256(_mm256_and_si256(d, curr), v);
+        _mm256_storeu_si256((__m256i *) (data + j), d);
+    }
+    _scatter_from(lin, data, j, n);
+}
+
+TARGET("avx2")
+static void _avx2_row_sums(const board_word *row, board_word *s0, board_word *s1, size_t words) {
+    size_t k;
+
+    for (k = 0; k + 4 <= words; k += 4) {
+        __m256i prev = _mm256_loadu_si256((const __m256i *) (row + k)),
+                mid = _mm256_loadu_si256((const __m256i *) (row + k + 1)),
+                next = _mm256_loadu_si256((const __m256i *) (row + k + 2));
+        __m256i left = _mm256_or_si256(_mm256_slli_epi64(mid, 1), _mm256_srli_epi64(prev, BOARD_BITS - 1)),
+                right = _mm256_or_si256(_mm256_srli_epi64(mid, 1), _mm256_slli_epi64(next, BOARD_BITS - 1)),
+                lm = _mm256_xor_si256(left, mid);
+
+        _mm256_storeu_si256((__m256i *) (s0 + k), _mm256_xor_si256(lm, right));
+        _mm256_storeu_si256((__m256i *) (s1 + k),
+                _mm256_or_si256(_mm256_and_si256(left, mid), _mm256_and_si256(right, lm)));
+    }
+    _row_sums_from(row, s0, s1, k, words);
+}
+
+TARGET("avx2")
+static void _avx2_life_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        board_word *out, size_t words) {
+    size_t k;
+
+    for (k = 0; k + 4 <= words; k += 4) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *) (up->s0 + k)),
+                a1 = _mm256_loadu_si256((const __m256i *) (up->s1 + k)),
+                b0 = _mm256_loadu_si256((const __m256i *) (mid->s0 + k)),
+                b1 = _mm256_loadu_si256((const __m256i *) (mid->s1 + k)),
+                c0 = _mm256_loadu_si256((const __m256i *) (down->s0 + k)),
+                c1 = _mm256_loadu_si256((const __m256i *) (down->s1 + k)),
+                alive = _mm256_loadu_si256((const __m256i *) (mid->row + k + 1));
+
+        __m256i x0 = _mm256_xor_si256(a0, b0),
+                sum0 = _mm256_xor_si256(x0, c0),
+                carry = _mm256_or_si256(_mm256_and_si256(a0, b0), _mm256_and_si256(c0, x0)),
+                x1 = _mm256_xor_si256(a1, b1),
+                t = _mm256_xor_si256(x1, c1),
+                maj = _mm256_or_si256(_mm256_and_si256(a1, b1), _mm256_and_si256(c1, x1)),
+                sum1 = _mm256_xor_si256(t, carry),
+                z = _mm256_and_si256(t, carry),
+                sum2 = _mm256_xor_si256(maj, z),
+                sum3 = _mm256_and_si256(maj, z);
+
+        __m256i born = _mm256_and_si256(_mm256_andnot_si256(sum2, sum1), sum0),
+                keep = _mm256_and_si256(_mm256_andnot_si256(_mm256_or_si256(sum1, sum0), sum2), alive);
+        _mm256_storeu_si256((__m256i *) (out + k), _mm256_andnot_si256(sum3, _mm256_or_si256(born, keep)));
+    }
+    _life_row_from(up, mid, down, out, k, words);
+}
+
+TARGET("avx2")
+static inline __m256i _avx2_select(__m256i sel, __m256i a, __m256i b) {
+    return _mm256_xor_si256(a, _mm256_and_si256(sel, _mm256_xor_si256(a, b)));
+}
+
+TARGET("avx2")
+static void _avx2_rule_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t words) {
+    unsigned int r[10];
+    __m256i leaf[4];
+    size_t k;
+
+    for (int n = 0; n < 10; ++n) {
+        r[n] = rule->sum9[n];
+    }
+    leaf[RULE_DEAD] = _mm256_setzero_si256();
+    leaf[RULE_ALIVE] = _mm256_set1_epi32(-1);
+
+    for (k = 0; k + 4 <= words; k += 4) {
+        __m256i a0 = _mm256_loadu_si256((const __m256i *) (up->s0 + k)),
+                a1 = _mm256_loadu_si256((const __m256i *) (up->s1 + k)),
+                b0 = _mm256_loadu_si256((const __m256i *) (mid->s0 + k)),
+                b1 = _mm256_loadu_si256((const __m256i *) (mid->s1 + k)),
+                c0 = _mm256_loadu_si256((const __m256i *) (down->s0 + k)),
+                c1 = _mm256_loadu_si256((const __m256i *) (down->s1 + k)),
+                alive = _mm256_loadu_si256((const __m256i *) (mid->row + k + 1));
+
+        __m256i x0 = _mm256_xor_si256(a0, b0),
+                sum0 = _mm256_xor_si256(x0, c0),
+                carry = _mm256_or_si256(_mm256_and_si256(a0, b0), _mm256_and_si256(c0, x0)),
+                x1 = _mm256_xor_si256(a1, b1),
+                t = _mm256_xor_si256(x1, c1),
+                maj = _mm256_or_si256(_mm256_and_si256(a1, b1), _mm256_and_si256(c1, x1)),
+                sum1 = _mm256_xor_si256(t, carry),
+                z = _mm256_and_si256(t, carry),
+                sum2 = _mm256_xor_si256(maj, z),
+                sum3 = _mm256_and_si256(maj, z);
+
+        leaf[RULE_BORN] = _mm256_xor_si256(alive, leaf[RULE_ALIVE]);
+        leaf[RULE_KEPT] = alive;
+
+        __m256i low = _avx2_select(sum1,
+                        _avx2_select(sum0, leaf[r[0]], leaf[r[1]]),
+                        _avx2_select(sum0, leaf[r[2]], leaf[r[3]])),
+                high = _avx2_select(sum1,
+                        _avx2_select(sum0, leaf[r[4]], leaf[r[5]]),
+                        _avx2_select(sum0, leaf[r[6]], leaf[r[7]])),
+                top = _avx2_select(sum0, leaf[r[8]], leaf[r[9]]);
+        _mm256_storeu_si256((__m256i *) (out + k),
+                _avx2_select(sum3, _avx2_select(sum2, low, high), top));
+    }
+    _rule_row_from(up, mid, down, rule, out, k, words);
+}
+
+/*
+ * Column codes of 32 cells, as _sse42_columns
+ */
+TARGET("avx2")
+static inline __m256i _avx2_columns(uint32_t u, uint32_t m, uint32_t d) {
+    const __m256i spread = _mm256_setr_epi8(
+                0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1,
+                2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3),
+                  bits = _mm256_set1_epi64x((long long) 0x8040201008040201ull);
+    __m256i vu = _mm256_shuffle_epi8(_mm256_set1_epi32((int) u), spread),
+            vm = _mm256_shuffle_epi8(_mm256_set1_epi32((int) m), spread),
+            vd = _mm256_shuffle_epi8(_mm256_set1_epi32((int) d), spread);
+
+    vu = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(vu, bits), bits), _mm256_set1_epi8(1));
+    vm = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(vm, bits), bits), _mm256_set1_epi8(2));
+    vd = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_and_si256(vd, bits), bits), _mm256_set1_epi8(4));
+    return _mm256_or_si256(_mm256_or_si256(vu, vm), vd);
+}
+
+/*
+ * Next states of 32 cells, as _sse42_lookup with the table in both lanes
+ */
+TARGET("avx2")
+static inline uint32_t _avx2_lookup(__m256i l, __m256i c, __m256i r, const __m256i *table) {
+    const __m256i bits = _mm256_set1_epi64x((long long) 0x8040201008040201ull);
+    __m256i i = _mm256_or_si256(l, _mm256_slli_epi16(r, 3)),
+            sel4 = _mm256_slli_epi16(i, 3),
+            sel5 = _mm256_slli_epi16(i, 2),
+            lo = _mm256_blendv_epi8(_mm256_shuffle_epi8(table[0], i), _mm256_shuffle_epi8(table[1], i), sel4),
+            hi = _mm256_blendv_epi8(_mm256_shuffle_epi8(table[2], i), _mm256_shuffle_epi8(table[3], i), sel4),
+            bit = _mm256_shuffle_epi8(bits, c),
+            next = _mm256_blendv_epi8(lo, hi, sel5);
+    return (uint32_t) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_and_si256(next, bit), bit));
+}
+
+TARGET("avx2")
+static void _avx2_table_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t words) {
+    __m256i table[4], prev, curr, next;
+    size_t b = BOARD_BITS / 32;
+
+    for (int i = 0; i < 4; ++i) {
+        table[i] = _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *) (rule->columns + 16 * i)));
+    }
+
+    prev = _avx2_columns(_row_block(up->row, b - 1, 32),
+            _row_block(mid->row, b - 1, 32), _row_block(down->row, b - 1, 32));
+    curr = _avx2_columns(_row_block(up->row, b, 32),
+            _row_block(mid->row, b, 32), _row_block(down->row, b, 32));
+
+    for (size_t k = 0; k < words; ++k) {
+        board_word cells = 0;
+        for (unsigned int q = 0; q < BOARD_BITS / 32; ++q, ++b) {
+            next = _avx2_columns(_row_block(up->row, b + 1, 32),
+                    _row_block(mid->row, b + 1, 32), _row_block(down->row, b + 1, 32));
+            // Byte shifts across the two lanes
+            __m256i l = _mm256_alignr_epi8(curr, _mm256_permute2x128_si256(prev, curr, 0x21), 15),
+                    r = _mm256_alignr_epi8(_mm256_permute2x128_si256(curr, next, 0x21), curr, 1);
+            cells |= (board_word) _avx2_lookup(l, curr, r, table) << (32 * q);
+            prev = curr;
+            curr = next;
+        }
+        out[k] = cells;
+    }
+}
+
+TARGET("avx2")
+static void _avx2_shift(world_store *data, size_t start, size_t end, shift_sums *sums) {
+    _shift_from(data, start, end, sums, 1);
+}
+
+const bitwise_kernel AVX2_KERNEL = {
+    "avx2",
+    _avx2_gather,
+    _avx2_scatter,
+    _avx2_row_sums,
+    _avx2_life_row,
+    _avx2_rule_row,
+    _avx2_table_row,
+    _avx2_shift,
+};
+
+/*** AVX-512: 8 board words, 16 world_stores per register ***/
+
+// Three-input truth tables for _mm512_ternarylogic_epi64
+#define TERN_XOR3 0x96
+#define TERN_MAJ3 0xe8
+#define TERN_SELECT 0xca // a ? b : c
+#define TERN_AND_OR 0xea // (a & b) | c
+
+TARGET("avx512f")
+static void _avx512_gather(const world_store *data, board_word *lin, size_t n) {
+    const __m512i m1 = _mm512_set1_epi32(0x55555555),
+                  m2 = _mm512_set1_epi32(0x33333333),
+                  m4 = _mm512_set1_epi32(0x0f0f0f0f),
+                  m8 = _mm512_set1_epi32(0x00ff00ff),
+                  m16 = _mm512_set1_epi32(0x0000ffff);
+    size_t j;
+
+    for (j = 0; j + 16 <= n; j += 16) {
+        __m512i v = _mm512_loadu_si512((const void *) (data + j));
+        v = _mm512_and_si512(_mm512_srli_epi32(v, 1), m1);
+        v = _mm512_and_si512(_mm512_or_si512(v, _mm512_srli_epi32(v, 1)), m2);
+        v = _mm512_and_si512(_mm512_or_si512(v, _mm512_srli_epi32(v, 2)), m4);
+        v = _mm512_and_si512(_mm512_or_si512(v, _mm512_srli_epi32(v, 4)), m8);
+        v = _mm512_and_si512(_mm512_or_si512(v, _mm512_srli_epi32(v, 8)), m16);
+        _mm256_storeu_si256((__m256i *) (lin + j / STORE_CELLS_PER_WORD), _mm512_cvtepi32_epi16(v));
+    }
+    _gather_from(data, lin, j, n);
+}
+
+TARGET("avx512f")
+static void _avx512_scatter(const board_word *lin, world_store *data, size_t n) {
+    const __m512i m1 = _mm512_set1_epi32(0x55555555),
+                  m2 = _mm512_set1_epi32(0x33333333),
+                  m4 = _mm512_set1_epi32(0x0f0f0f0f),
+                  m8 = _mm512_set1_epi32(0x00ff00ff),
+                  curr = _mm512_set1_epi32((int) CURR_CELL_MASK);
+    size_t j;
+
+    for (j = 0; j + 16 <= n; j += 16) {
+        __m512i v = _mm512_cvtepu16_epi32(_mm256_loadu_si256((const __m256i *) (lin + j / STORE_CELLS_PER_WORD)));
+        v = _mm512_and_si512(_mm512_or_si512(v, _mm512_slli_epi32(v, 8)), m8);
+        v = _mm512_and_si512(_mm512_or_si512(v, _mm512_slli_epi32(v, 4)), m4);
+        v = _mm512_and_si512(_mm512_or_si512(v, _mm512_slli_epi32(v, 2)), m2);
+        v = _mm512_and_si512(_mm512_or_si512(v, _mm512_slli_epi32(v, 1)), m1);
+
+        __m512i d = _mm512_loadu_si512((const void *) (data + j));
+        d = _mm512_or_si512(_mm512_and_si512(d, curr), v);
+        _mm512_storeu_si512((void *) (data + j), d);
+    }
+    _scatter_from(lin, data, j, n);
+}
+
+TARGET("avx512f")
+static void _avx512_row_sums(const board_word *row, board_word *s0, board_word *s1, size_t words) {
+    size_t k;
+
+    for (k = 0; k + 8 <= words; k += 8) {
+        __m512i prev = _mm512_loadu_si512((const void *) (row + k)),
+                mid = _mm512_loadu_si512((const void *) (row + k + 1)),
+                next = _mm512_loadu_si512((const void *) (row + k + 2));
+        __m512i left = _mm512_or_si512(_mm512_slli_epi64(mid, 1), _mm512_srli_epi64(prev, BOARD_BITS - 1)),
+                right = _mm512_or_si512(_mm512_srli_epi64(mid, 1), _mm512_slli_epi64(next, BOARD_BITS - 1));
+
+        _mm512_storeu_si512((void *) (s0 + k), _mm512_ternarylogic_epi64(left, mid, right, TERN_XOR3));
+        _mm512_storeu_si512((void *) (s1 + k), _mm512_ternarylogic_epi64(left, mid, right, TERN_MAJ3));
+    }
+    _row_sums_from(row, s0, s1, k, words);
+}
+
+TARGET("avx512f")
+static void _avx512_life_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        board_word *out, size_t words) {
+    size_t k;
+
+    for (k = 0; k + 8 <= words; k += 8) {
+        __m512i a0 = _mm512_loadu_si512((const void *) (up->s0 + k)),
+                a1 = _mm512_loadu_si512((const void *) (up->s1 + k)),
+                b0 = _mm512_loadu_si512((const void *) (mid->s0 + k)),
+                b1 = _mm512_loadu_si512((const void *) (mid->s1 + k)),
+                c0 = _mm512_loadu_si512((const void *) (down->s0 + k)),
+                c1 = _mm512_loadu_si512((const void *) (down->s1 + k)),
+                alive = _mm512_loadu_si512((const void *) (mid->row + k + 1));
+
+        __m512i sum0 = _mm512_ternarylogic_epi64(a0, b0, c0, TERN_XOR3),
+                carry = _mm512_ternarylogic_epi64(a0, b0, c0, TERN_MAJ3),
+                t = _mm512_ternarylogic_epi64(a1, b1, c1, TERN_XOR3),
+                maj = _mm512_ternarylogic_epi64(a1, b1, c1, TERN_MAJ3),
+                sum1 = _mm512_xor_si512(t, carry),
+                z = _mm512_and_si512(t, carry),
+                sum2 = _mm512_xor_si512(maj, z),
+                sum3 = _mm512_and_si512(maj, z);
+
+        __m512i born = _mm512_and_si512(_mm512_andnot_si512(sum2, sum1), sum0),
+                keep = _mm512_and_si512(_mm512_andnot_si512(_mm512_or_si512(sum1, sum0), sum2), alive);
+        _mm512_storeu_si512((void *) (out + k), _mm512_andnot_si512(sum3, _mm512_or_si512(born, keep)));
+    }
+    _life_row_from(up, mid, down, out, k, words);
+}
+
+TARGET("avx512f")
+static inline __m512i _avx512_select(__m512i sel, __m512i a, __m512i b) {
+    return _mm512_ternarylogic_epi64(sel, b, a, TERN_SELECT);
+}
+
+TARGET("avx512f")
+static void _avx512_rule_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t words) {
+    unsigned int r[10];
+    __m512i leaf[4];
+    size_t k;
+
+    for (int n = 0; n < 10; ++n) {
+        r[n] = rule->sum9[n];
+    }
+    leaf[RULE_DEAD] = _mm512_setzero_si512();
+    leaf[RULE_ALIVE] = _mm512_set1_epi32(-1);
+
+    for (k = 0; k + 8 <= words; k += 8) {
+        __m512i a0 = _mm512_loadu_si512((const void *) (up->s0 + k)),
+                a1 = _mm512_loadu_si512((const void *) (up->s1 + k)),
+                b0 = _mm512_loadu_si512((const void *) (mid->s0 + k)),
+                b1 = _mm512_loadu_si512((const void *) (mid->s1 + k)),
+                c0 = _mm512_loadu_si512((const void *) (down->s0 + k)),
+                c1 = _mm512_loadu_si512((const void *) (down->s1 + k)),
+                alive = _mm512_loadu_si512((const void *) (mid->row + k + 1));
+
+        __m512i sum0 = _mm512_ternarylogic_epi64(a0, b0, c0, TERN_XOR3),
+                carry = _mm512_ternarylogic_epi64(a0, b0, c0, TERN_MAJ3),
+                t = _mm512_ternarylogic_epi64(a1, b1, c1, TERN_XOR3),
+                maj = _mm512_ternarylogic_epi64(a1, b1, c1, TERN_MAJ3),
+                sum1 = _mm512_xor_si512(t, carry),
+                z = _mm512_and_si512(t, carry),
+                sum2 = _mm512_xor_si512(maj, z),
+                sum3 = _mm512_and_si512(maj, z);
+
+        leaf[RULE_BORN] = _mm512_xor_si512(alive, leaf[RULE_ALIVE]);
+        leaf[RULE_KEPT] = alive;
+
+        __m512i low = _avx512_select(sum1,
+                        _avx512_select(sum0, leaf[r[0]], leaf[r[1]]),
+                        _avx512_select(sum0, leaf[r[2]], leaf[r[3]])),
+                high = _avx512_select(sum1,
+                        _avx512_select(sum0, leaf[r[4]], leaf[r[5]]),
+                        _avx512_select(sum0, leaf[r[6]], leaf[r[7]])),
+                top = _avx512_select(sum0, leaf[r[8]], leaf[r[9]]);
+        _mm512_storeu_si512((void *) (out + k),
+                _avx512_select(sum3, _avx512_select(sum2, low, high), top));
+    }
+    _rule_row_from(up, mid, down, rule, out, k, words);
+}
+
+/*
+ * 9-bit neighbourhood indices of 16 cells in 32-bit lanes, from windows
+ * of each row starting one cell left of the first, and the next states
+ * they map to through the table held in a register
+ */
+TARGET("avx512f")
+static void _avx512_table_row(const board_slot *up, const board_slot *mid, const board_slot *down,
+        const life_rule *rule, board_word *out, size_t words) {
+    const __m512i lane = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15),
+                  top = _mm512_set1_epi32(0x7),
+                  centre = _mm512_set1_epi32(0x38),
+                  bottom = _mm512_set1_epi32(0x1c0),
+                  low5 = _mm512_set1_epi32(31),
+                  one = _mm512_set1_epi32(1),
+                  table = _mm512_loadu_si512((const void *) rule->table);
+
+    for (size_t k = 0; k < words; ++k) {
+        const board_word *ur = up->row + k, *mr = mid->row + k, *dr = down->row + k;
+        board_word cells = 0;
+        for (unsigned int q = 0; q < BOARD_BITS / 16; ++q) {
+            // Cells 16q-1 to 16q+16
+            uint64_t u = q < 3 ? ((ur[1] << 1) | (ur[0] >> 63)) >> (16 * q) : (ur[1] >> 47) | (ur[2] << 17),
+                     m = q < 3 ? ((mr[1] << 1) | (mr[0] >> 63)) >> (16 * q) : (mr[1] >> 47) | (mr[2] << 17),
+                     d = q < 3 ? ((dr[1] << 1) | (dr[0] >> 63)) >> (16 * q) : (dr[1] >> 47) | (dr[2] << 17);
+            __m512i vu = _mm512_srlv_epi32(_mm512_set1_epi32((int) (uint32_t) u), lane),
+                    vm = _mm512_srlv_epi32(_mm512_set1_epi32((int) (uint32_t) (m << 3)), lane),
+                    vd = _mm512_srlv_epi32(_mm512_set1_epi32((int) (uint32_t) (d << 6)), lane);
+
+            __m512i idx = _mm512_and_si512(vu, top);
+            idx = _mm512_ternarylogic_epi32(vm, centre, idx, TERN_AND_OR);
+            idx = _mm512_ternarylogic_epi32(vd, bottom, idx, TERN_AND_OR);
+
+            __m512i word = _mm512_permutexvar_epi32(_mm512_srli_epi32(idx, 5), table),
+                    bit = _mm512_srlv_epi32(word, _mm512_and_si512(idx, low5));
+            cells |= (board_word) _mm512_test_epi32_mask(bit, one) << (16 * q);
+        }
+        out[k] = cells;
+    }
+}
+
+TARGET("avx512f")
+static void _avx512_shift(world_store *data, size_t start, size_t end, shift_sums *sums) {
+    _shift_from(data, start, end, sums, 1);
+}
+
+const bitwise_kernel AVX512_KERNEL = {
+    "avx512",
+    _avx512_gather,
+    _avx512_scatter,
+    _avx512_row_sums,
+    _avx512_life_row,
+    _avx512_rule_row,
+    _avx512_table_row,
+    _avx512_shift,
+};
+
+#endif
@@ -0,0 +1,653 @@
+#include <string.h>
+#include "soup.h"
+#include "pool.h"
+
+/*
+ * Soup search
+ *
+ * Random soups are run in batches, one per thread, until they die out
+ * or repeat. The ash of a repeating soup is then stepped through its
+ * period, the cells alive in any phase split into objects, and each
+ * object named by its apgcode: xs<population> for still lifes
+ * or xp<period> for oscillators, then the extended Wechsler format of
+ * its cells, as the shortest and then first of all its phases and the 8
+ * orientations. Periods above BATCH_HISTORY aren't found, and those soups
+ * end up unfinished. Worlds are bounded, so objects with cells on the
+ * edge, like what is left of spaceships, are only counted as edge
+ * objects.
+ *
+ * The census of a thread is merged into the search's after each round.
+ */
+
+#define NO_SOUP UINT64_MAX
+
+static const char WECHSLER_DIGITS[] = "0123456789abcdefghijklmnopqrstuv";
+
+static inline uint64_t _splitmix(uint64_t *state) {
+    uint64_t z = (*state += 0x9e3779b97f4a7c15ull);
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+static uint64_t _hash_code(const char *code) {
+    uint64_t h = 0xcbf29ce484222325ull;
+
+    for (; *code != '\0'; ++code) {
+        h = (h ^ (uint8_t) *code) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+static void _census_add(soup_census *c, const char *code, uint64_t count) {
+    size_t i;
+
+    if (2 * (c->count + 1) > c->capacity) {
+        soup_census grown = { calloc(c->capacity ? 2 * c->capacity : 64, sizeof(census_entry)),
+            c->capacity ? 2 * c->capacity : 64, 0 };
+        for (size_t j = 0; j < c->capacity; ++j) {
+            if (c->entries[j].code != NULL) {
+                for (i = _hash_code(c->entries[j].code) & (grown.capacity - 1);
+                        grown.entries[i].code != NULL; i = (i + 1) & (grown.capacity - 1));
+                grown.entries[i] = c->entries[j];
+                grown.count++;
+            }
+        }
+        free(c->entries);
+        *c = grown;
+    }
+
+    for (i = _hash_code(code) & (c->capacity - 1); c->entries[i].code != NULL;
+            i = (i + 1) & (c->capacity - 1)) {
+        if (strcmp(c->entries[i].code, code) == 0) {
+            c->entries[i].count += count;
+            return;
+        }
+    }
+    c->entries[i].code = malloc(strlen(code) + 1);
+    strcpy(c->entries[i].code, code);
+    c->entries[i].count = count;
+    c->count++;
+}
+
+static void _census_clear(soup_census *c) {
+    for (size_t i = 0; i < c->capacity; ++i) {
+        free(c->entries[i].code);
+    }
+    free(c->entries);
+    c->entries = NULL;
+    c->capacity = 0;
+    c->count = 0;
+}
+
+static size_t _code_len(soup_search *s) {
+    size_t side = s->xlim > s->ylim ? s->xlim : s->ylim;
+
+    // A strip of 5 rows takes at most a character per column and a 'z'
+    return (side / 5 + 1) * (side + 1) + 32;
+}
+
+soup_search *init_soup_search(uint32_t xlim, uint32_t ylim, const life_rule *rule,
+        uint64_t seed, unsigned int threads) {
+    soup_search *s;
+    size_t side = xlim > ylim ? xlim : ylim;
+
+    // Empty space has to stay empty for ash to settle
+    if (xlim == 0 || ylim == 0 || (rule->birth & 1) || rule->range > 1 || rule->states > 2) {
+        return NULL;
+    }
+
+    s = calloc(1, sizeof(soup_search));
+    s->xlim = xlim;
+    s->ylim = ylim;
+    s->rule = *rule;
+    s->seed = seed;
+
+    s->bands = threads > 0 ? threads : 1;
+    s->band = calloc(s->bands, sizeof(soup_band));
+    for (unsigned int band = 0; band < s->bands; ++band) {
+        soup_band *sb = &s->band[band];
+        sb->batch = init_batch(SOUP_LANES, xlim, ylim, BOUNDED, rule, 1);
+        sb->phases = malloc((size_t) BATCH_HISTORY * xlim * ylim);
+        sb->label = malloc((size_t) xlim * ylim * sizeof(uint32_t));
+        sb->parent = malloc(((size_t) xlim * ylim + 2) * sizeof(uint32_t));
+        sb->start = malloc(((size_t) xlim * ylim + 2) * sizeof(uint32_t));
+        sb->cells = malloc((size_t) xlim * ylim * sizeof(uint32_t));
+        sb->object = malloc((size_t) xlim * ylim * sizeof(uint32_t));
+        sb->grid = malloc(side * side);
+        sb->code = malloc(_code_len(s));
+        sb->best = malloc(_code_len(s));
+        sb->name = malloc(_code_len(s));
+        if (sb->batch == NULL || sb->phases == NULL || sb->label == NULL || sb->parent == NULL ||
+                sb->start == NULL || sb->cells == NULL || sb->object == NULL ||
+                sb->grid == NULL || sb->code == NULL || sb->best == NULL || sb->name == NULL) {
+            destroy_soup_search(s);
+            return NULL;
+        }
+    }
+    s->pool = s->bands > 1 ? init_pool(s->bands) : NULL;
+
+    return s;
+}
+
+void destroy_soup_search(soup_search *s) {
+    if (s->pool != NULL) {
+        destroy_pool(s->pool);
+    }
+    for (unsigned int band = 0; band < s->bands; ++band) {
+        soup_band *sb = &s->band[band];
+        if (sb->batch != NULL) {
+            destroy_batch(sb->batch);
+        }
+        _census_clear(&sb->census);
+        free(sb->phases);
+        free(sb->label);
+        free(sb->parent);
+        free(sb->start);
+        free(sb->cells);
+        free(sb->object);
+        free(sb->grid);
+        free(sb->code);
+        free(sb->best);
+        free(sb->name);
+    }
+    _census_clear(&s->census);
+    free(s->band);
+    free(s);
+}
+
+/*
+ * Fill world k of a band's batch with soup i
+ */
+static void _load_soup(soup_search *s, soup_band *sb, size_t k, uint64_t i) {
+    uint32_t side = SOUP_SIDE, x0, y0;
+    uint64_t state = s->seed ^ (i * 0xd1b54a32d192ed03ull), bits = 0;
+
+    side = side < s->xlim ? side : s->xlim;
+    side = side < s->ylim ? side : s->ylim;
+    x0 = (s->xlim - side) / 2;
+    y0 = (s->ylim - side) / 2;
+
+    batch_clear(sb->batch, k);
+    for (uint32_t c = 0; c < side * side; ++c) {
+        if (c % 64 == 0) {
+            bits = _splitmix(&state);
+        }
+        if ((bits >> (c % 64)) & 1) {
+            batch_set_cell(sb->batch, k, x0 + c % side, y0 + c / side, 1);
+        }
+    }
+    sb->soup[k] = i;
+}
+
+/*
+ * Extended Wechsler format of a w by h grid: strips of 5 rows split by
+ * 'z', each column of a strip a digit with the top row as bit 0, and
+ * runs of empty columns as 'w' (2), 'x' (3) or 'y' and a digit (4 up)
+ */
+static size_t _wechsler(const uint8_t *grid, uint32_t w, uint32_t h, char *out) {
+    size_t len = 0;
+
+    for (uint32_t y0 = 0; y0 < h; y0 += 5) {
+        uint32_t zeros = 0;
+        if (y0 > 0) {
+            out[len++] = 'z';
+        }
+        for (uint32_t x = 0; x < w; ++x) {
+            unsigned int v = 0;
+            for (uint32_t y = y0; y < y0 + 5 && y < h; ++y) {
+                v |= (unsigned int) grid[y * w + x] << (y - y0);
+            }
+            if (v == 0) {
+                zeros++;
+                continue;
+            }
+            while (zeros > 0) {
+                uint32_t run = zeros < 39 ? zeros : 39;
+                if (run == 1) {
+                    out[len++] = '0';
+                } else if (run == 2) {
+                    out[len++] = 'w';
+                } else if (run == 3) {
+                    out[len++] = 'x';
+                } else {
+                    out[len++] = 'y';
+                    out[len++] = WECHSLER_DIGITS[run - 4];
+                }
+                zeros -= run;
+            }
+            out[len++] = WECHSLER_DIGITS[v];
+        }
+    }
+    out[len] = '\0';
+    return len;
+}
+
+/*
+ * Name the n cells in object, alive in phases [0, period) of the band's
+ * phases, by its apgcode
+ */
+static void _name_object(soup_search *s, soup_band *sb, size_t n, uint32_t period, char *name) {
+    size_t cell_count = (size_t) s->xlim * s->ylim, best_len = SIZE_MAX;
+    uint64_t population = 0;
+
+    for (uint32_t g = 0; g < period; ++g) {
+        const uint8_t *phase = sb->phases + g * cell_count;
+        for (int t = 0; t < 8; ++t) {
+            int64_t x0 = INT64_MAX, y0 = INT64_MAX, x1 = INT64_MIN, y1 = INT64_MIN;
+            uint32_t w, h;
+            size_t len;
+
+            // Transposed if bit 2 is set, then mirrored by bits 0 and 1
+            for (size_t j = 0; j < n; ++j) {
+                uint32_t c = sb->object[j];
+                int64_t x = c % s->xlim, y = c / s->xlim, tx, ty;
+                if (!phase[c]) {
+                    continue;
+                }
+                tx = (t & 4) ? y : x;
+                ty = (t & 4) ? x : y;
+                tx = (t & 1) ? -tx : tx;
+                ty = (t & 2) ? -ty : ty;
+                x0 = tx < x0 ? tx : x0;
+                y0 = ty < y0 ? ty : y0;
+                x1 = tx > x1 ? tx : x1;
+                y1 = ty > y1 ? ty : y1;
+            }
+            w = x1 - x0 + 1;
+            h = y1 - y0 + 1;
+            memset(sb->grid, 0, (size_t) w * h);
+            for (size_t j = 0; j < n; ++j) {
+                uint32_t c = sb->object[j];
+                int64_t x = c % s->xlim, y = c / s->xlim, tx, ty;
+                if (!phase[c]) {
+                    continue;
+                }
+                tx = (t & 4) ? y : x;
+                ty = (t & 4) ? x : y;
+                tx = (t & 1) ? -tx : tx;
+                ty = (t & 2) ? -ty : ty;
+                sb->grid[(ty - y0) * w + (tx - x0)] = 1;
+                population += g == 0 && t == 0;
+            }
+
+            len = _wechsler(sb->grid, w, h, sb->code);
+            if (len < best_len || (len == best_len && strcmp(sb->code, sb->best) < 0)) {
+                memcpy(sb->best, sb->code, len + 1);
+                best_len = len;
+            }
+        }
+    }
+
+    if (period == 1) {
+        sprintf(name, "xs%llu_%s", (unsigned long long) population, sb->best);
+    } else {
+        sprintf(name, "xp%lu_%s", (unsigned long) period, sb->best);
+    }
+}
+
+static uint32_t _find(uint32_t *parent, uint32_t id) {
+    while (parent[id] != id) {
+        parent[id] = parent[parent[id]];
+        id = parent[id];
+    }
+    return id;
+}
+
+static inline int _in_group(soup_band *sb, size_t c, uint32_t r) {
+    return sb->label[c] != 0 && _find(sb->parent, sb->label[c]) == r;
+}
+
+/*
+ * Whether the pieces in group r go from each phase to the next by
+ * themselves, without the cells around them
+ */
+static int _independent(soup_search *s, soup_band *sb, uint32_t objects, uint32_t r, uint32_t period) {
+    size_t cell_count = (size_t) s->xlim * s->ylim;
+
+    for (uint32_t id = 1; id <= objects; ++id) {
+        if (_find(sb->parent, id) != r) {
+            continue;
+        }
+        for (uint32_t j = sb->start[id]; j < sb->start[id + 1]; ++j) {
+            int64_t x = sb->cells[j] % s->xlim, y = sb->cells[j] / s->xlim;
+            for (int64_t ny = y - 1; ny <= y + 1; ++ny) {
+                for (int64_t nx = x - 1; nx <= x + 1; ++nx) {
+                    size_t nc = (size_t) ny * s->xlim + nx;
+                    if (nx < 0 || ny < 0 || nx >= s->xlim || ny >= s->ylim) {
+                        continue;
+                    }
+                    for (uint32_t g = 0; g < period; ++g) {
+                        const uint8_t *phase = sb->phases + g * cell_count;
+                        unsigned int idx = 0;
+                        for (int dy = -1; dy <= 1; ++dy) {
+                            for (int dx = -1; dx <= 1; ++dx) {
+                                int64_t mx = nx + dx, my = ny + dy;
+                                size_t mc = (size_t) my * s->xlim + mx;
+                                if (mx >= 0 && my >= 0 && mx < s->xlim && my < s->ylim &&
+                                        phase[mc] && _in_group(sb, mc, r)) {
+                                    idx |= 1u << ((dy + 1) * 3 + dx + 1);
+                                }
+                            }
+                        }
+                        if (rule_lookup(&s->rule, idx) !=
+                                (_in_group(sb, nc, r) && sb->phases[(g + 1) % period * cell_count + nc])) {
+                            return 0;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    return 1;
+}
+
+/*
+ * Split the ash of world k, which repeats every period generations, into
+ * objects and count them. Pieces (8-connected cells alive in any phase)
+ * that only keep going with the help of the ones around them, like
+ * parts of a pulsar, are joined with every piece within 2 cells, whose
+ * cells share neighbours with theirs, until they do.
+ */
+static void _take_census(soup_search *s, soup_band *sb, size_t k, uint32_t period) {
+    size_t cell_count = (size_t) s->xlim * s->ylim;
+    uint32_t objects = 0, n = 0;
+    int joined;
+
+    memset(sb->label, 0, cell_count * sizeof(uint32_t));
+    for (uint32_t g = 0; g < period; ++g) {
+        uint8_t *phase = sb->phases + g * cell_count;
+        for (size_t c = 0; c < cell_count; ++c) {
+            phase[c] = batch_cell(sb->batch, k, c % s->xlim, c / s->xlim);
+            sb->label[c] = phase[c] ? UINT32_MAX : sb->label[c];
+        }
+        batch_advance(sb->batch, k, 1);
+    }
+
+    // Label the pieces, with their cells together in cells
+    for (size_t c = 0; c < cell_count; ++c) {
+        uint32_t todo = n;
+
+        if (sb->label[c] != UINT32_MAX) {
+            continue;
+        }
+        sb->start[++objects] = n;
+        sb->parent[objects] = objects;
+        sb->label[c] = objects;
+        sb->cells[n++] = c;
+        while (todo < n) {
+            int64_t x = sb->cells[todo] % s->xlim, y = sb->cells[todo] / s->xlim;
+            todo++;
+            for (int64_t ny = y - 1; ny <= y + 1; ++ny) {
+                for (int64_t nx = x - 1; nx <= x + 1; ++nx) {
+                    size_t nc = (size_t) ny * s->xlim + nx;
+                    if (nx >= 0 && ny >= 0 && nx < s->xlim && ny < s->ylim && sb->label[nc] == UINT32_MAX) {
+                        sb->label[nc] = objects;
+                        sb->cells[n++] = nc;
+                    }
+                }
+            }
+        }
+    }
+    sb->start[objects + 1] = n;
+
+    do {
+        joined = 0;
+        for (uint32_t r = 1; r <= objects; ++r) {
+            if (_find(sb->parent, r) != r || _independent(s, sb, objects, r, period)) {
+                continue;
+            }
+            for (uint32_t j = 0; j < n; ++j) {
+                int64_t x = sb->cells[j] % s->xlim, y = sb->cells[j] / s->xlim;
+                if (_find(sb->parent, sb->label[sb->cells[j]]) != r) {
+                    continue;
+                }
+                for (int64_t ny = y - 2; ny <= y + 2; ++ny) {
+                    for (int64_t nx = x - 2; nx <= x + 2; ++nx) {
+                        size_t nc = (size_t) ny * s->xlim + nx;
+                        if (nx >= 0 && ny >= 0 && nx < s->xlim && ny < s->ylim &&
+                                sb->label[nc] != 0 && _find(sb->parent, sb->label[nc]) != r) {
+                            sb->parent[_find(sb->parent, sb->label[nc])] = r;
+                            joined = 1;
+                        }
+                    }
+                }
+            }
+        }
+    } while (joined);
+
+    for (uint32_t r = 1; r <= objects; ++r) {
+        uint32_t object_period = period, m = 0;
+        int edge = 0;
+
+        if (_find(sb->parent, r) != r) {
+            continue;
+        }
+        for (uint32_t j = 0; j < n; ++j) {
+            uint32_t x = sb->cells[j] % s->xlim, y = sb->cells[j] / s->xlim;
+            if (_find(sb->parent, sb->label[sb->cells[j]]) == r) {
+                sb->object[m++] = sb->cells[j];
+                edge |= x == 0 || y == 0 || x == s->xlim - 1 || y == s->ylim - 1;
+            }
+        }
+
+        // Cells outside would have been born next to it on a plane
+        if (edge) {
+            sb->edge++;
+            continue;
+        }
+
+        // An object's own period divides the world's
+        for (uint32_t d = 1; d < period; ++d) {
+            int same = period % d == 0;
+            for (uint32_t j = 0; j < m && same; ++j) {
+                same = sb->phases[sb->object[j]] == sb->phases[d * cell_count + sb->object[j]];
+            }
+            if (same) {
+                object_period = d;
+                break;
+            }
+        }
+
+        _name_object(s, sb, m, object_period, sb->name);
+        _census_add(&sb->census, sb->name, 1);
+    }
+}
+
+/*
+ * Run the band's soups of the round, every bands-th one, SOUP_LANES at a
+ * time. A world that ends is counted and loaded with the next soup.
+ */
+static void _search_band(void *arg, unsigned int band, unsigned int bands) {
+    soup_search *s = arg;
+    soup_band *sb = &s->band[band];
+    uint64_t next = s->round_start + band;
+    size_t running = 0;
+
+    for (size_t k = 0; k < SOUP_LANES; ++k) {
+        sb->soup[k] = NO_SOUP;
+        if (next < s->round_end) {
+            _load_soup(s, sb, k, next);
+            next += bands;
+            running++;
+        }
+    }
+
+    while (running > 0) {
+        batch_step(sb->batch, SOUP_STEP);
+        for (size_t k = 0; k < SOUP_LANES; ++k) {
+            batch_result *r = &sb->batch->results[k];
+            if (sb->soup[k] == NO_SOUP) {
+                continue;
+            } else if (r->flags & BATCH_EXTINCT) {
+                sb->extinct++;
+            } else if (r->flags & BATCH_PERIODIC) {
+                _take_census(s, sb, k, r->period);
+            } else if (r->generation >= SOUP_MAX_GENERATIONS) {
+                sb->unfinished++;
+            } else {
+                continue;
+            }
+
+            sb->soup[k] = NO_SOUP;
+            running--;
+            if (next < s->round_end) {
+                _load_soup(s, sb, k, next);
+                next += bands;
+                running++;
+            }
+        }
+    }
+}
+
+/*
+ * Run the next soups soups of the search, on all its threads, and add
+ * what they left to the census
+ */
+void soup_run(soup_search *s, uint64_t soups) {
+    s->round_start = s->soups;
+    s->round_end = s->soups + soups;
+    if (s->pool != NULL) {
+        pool_run(s->pool, _search_band, s);
+    } else {
+        _search_band(s, 0, 1);
+    }
+
+    for (unsigned int band = 0; band < s->bands; ++band) {
+        soup_band *sb = &s->band[band];
+        for (size_t i = 0; i < sb->census.capacity; ++i) {
+            if (sb->census.entries[i].code != NULL) {
+                _census_add(&s->census, sb->census.entries[i].code, sb->census.entries[i].count);
+            }
+        }
+        _census_clear(&sb->census);
+        s->extinct += sb->extinct;
+        s->unfinished += sb->unfinished;
+        s->edge += sb->edge;
+        sb->extinct = 0;
+        sb->unfinished = 0;
+        sb->edge = 0;
+    }
+    s->soups += soups;
+}
+
+static int _compare_entries(const void *a, const void *b) {
+    const census_entry *ea = a, *eb = b;
+
+    if (ea->count != eb->count) {
+        return ea->count < eb->count ? 1 : -1;
+    }
+    return strcmp(ea->code, eb->code);
+}
+
+/*
+ * The census, most common objects first, in an array of census.count
+ * entries to free (but not their codes)
+ */
+census_entry *soup_sorted_census(soup_search *s) {
+    census_entry *sorted = malloc((s->census.count + 1) * sizeof(census_entry));
+    size_t n = 0;
+
+    for (size_t i = 0; i < s->census.capacity; ++i) {
+        if (s->census.entries[i].code != NULL) {
+            sorted[n++] = s->census.entries[i];
+        }
+    }
+    qsort(sorted, n, sizeof(census_entry), _compare_entries);
+    return sorted;
+}
+
+/*
+ * Write the census, with what is needed to resume the search after the
+ * soups done. Returns 0 on failure.
+ */
+int soup_save_census(soup_search *s, const char *filename) {
+    char rule_str[RULE_STRING_LEN];
+    census_entry *sorted;
+    FILE *file = fopen(filename, "w");
+
+    if (file == NULL) {
+        return 0;
+    }
+    rule_string(&s->rule, rule_str);
+    fprintf(file, "#%s soup census\n", PROGRAM_NAME);
+    fprintf(file, "#rule %s\n", rule_str);
+    fprintf(file, "#size %lux%lu\n", (unsigned long) s->xlim, (unsigned long) s->ylim);
+    fprintf(file, "#seed %llu\n", (unsigned long long) s->seed);
+    fprintf(file, "#soups %llu\n", (unsigned long long) s->soups);
+    fprintf(file, "#extinct %llu\n", (unsigned long long) s->extinct);
+    fprintf(file, "#unfinished %llu\n", (unsigned long long) s->unfinished);
+    fprintf(file, "#edge %llu\n", (unsigned long long) s->edge);
+
+    sorted = soup_sorted_census(s);
+    for (size_t i = 0; i < s->census.count; ++i) {
+        fprintf(file, "%s %llu\n", sorted[i].code, (unsigned long long) sorted[i].count);
+    }
+    free(sorted);
+
+    return fclose(file) == 0;
+}
+
+/*
+ * Resume a search from its census file. The search takes the file's
+ * seed, unless keep_seed is set, in which case they have to be the
+ * same, like the rule and size. Returns 1 if resumed, 0 if there is no
+ * file, and -1 if it is from a different search.
+ */
+int soup_resume(soup_search *s, const char *filename, int keep_seed) {
+    char rule_str[RULE_STRING_LEN], size_str[64];
+    size_t line_len = _code_len(s) + 64;
+    char *line;
+    unsigned long long seed = s->seed;
+    int matches = 1;
+    FILE *file = fopen(filename, "r");
+
+    if (file == NULL) {
+        return 0;
+    }
+    rule_string(&s->rule, rule_str);
+    snprintf(size_str, sizeof(size_str), "%lux%lu", (unsigned long) s->xlim, (unsigned long) s->ylim);
+
+    line = malloc(line_len);
+    _census_clear(&s->census);
+    s->soups = s->extinct = s->unfinished = s->edge = 0;
+    while (matches && fgets(line, line_len, file) != NULL) {
+        char *value = strchr(line, ' ');
+        unsigned long long count;
+
+        line[strcspn(line, "\n")] = '\0';
+        if (value == NULL) {
+            continue;
+        }
+        *value++ = '\0';
+        if (strcmp(line, "#rule") == 0) {
+            matches = strcmp(value, rule_str) == 0;
+        } else if (strcmp(line, "#size") == 0) {
+            matches = strcmp(value, size_str) == 0;
+        } else if (strcmp(line, "#seed") == 0) {
+            seed = strtoull(value, NULL, 10);
+            matches = !keep_seed || seed == s->seed;
+        } else if (strcmp(line, "#soups") == 0) {
+            s->soups = strtoull(value, NULL, 10);
+        } else if (strcmp(line, "#extinct") == 0) {
+            s->extinct = strtoull(value, NULL, 10);
+        } else if (strcmp(line, "#unfinished") == 0) {
+            s->unfinished = strtoull(value, NULL, 10);
+        } else if (strcmp(line, "#edge") == 0) {
+            s->edge = strtoull(value, NULL, 10);
+        } else if (line[0] != '#' && (count = strtoull(value, NULL, 10)) > 0) {
+            _census_add(&s->census, line, count);
+        }
+    }
+    free(line);
+    fclose(file);
+
+    if (!matches) {
+        _census_clear(&s->census);
+        s->soups = s->extinct = s->unfinished = s->edge = 0;
+        return -1;
+    }
+    s->seed = seed;
+    return 1;
+}
@@ -0,0 +1,100 @@
+#ifndef _SOUP_H
+#define _SOUP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+#include "batch.h"
+
+// Soups are random squares of this side in the middle of the world
+#define SOUP_SIDE 16
+// Worlds in each thread's batch, and generations per batch_step
+#define SOUP_LANES 64
+#define SOUP_STEP 256
+// Soups still running by then are counted as unfinished
+#define SOUP_MAX_GENERATIONS 20000
+// Soups between saves of the census
+#define SOUP_ROUND 4096
+
+#define SOUP_CENSUS_DEFAULT "census.txt"
+
+/*** TYPES ***/
+
+/*
+ * Objects counted by their code, in an open addressing hash table
+ */
+struct census_entry {
+    char *code;
+    uint64_t count;
+};
+typedef struct census_entry census_entry;
+
+struct soup_census {
+    census_entry *entries;
+    size_t capacity; // a power of two
+    size_t count;
+};
+typedef struct soup_census soup_census;
+
+/*
+ * A thread's share of a search: its batch of soups, which soup is in
+ * each world of it, what it found, and scratch space for the census
+ */
+struct soup_band {
+    world_batch *batch;
+    uint64_t soup[SOUP_LANES];
+    soup_census census;
+    uint64_t extinct;
+    uint64_t unfinished;
+    uint64_t edge; // objects on the edge of the world, not in the census
+
+    uint8_t *phases; // BATCH_HISTORY phases of the world, a byte per cell
+    uint32_t *label; // piece of each cell alive in any phase, or 0
+    uint32_t *parent; // pieces joined into objects, by label
+    uint32_t *start; // where the cells of each piece start in cells
+    uint32_t *cells;
+    uint32_t *object; // cells of the object being named
+    uint8_t *grid; // an object in one phase and orientation
+    char *code;
+    char *best;
+    char *name;
+};
+typedef struct soup_band soup_band;
+
+/*
+ * Soup search in bounded worlds: soup i is filled from seed and i alone,
+ * so a search can be repeated, and resumed from the number of soups
+ * done, on any number of threads
+ */
+struct soup_search {
+    uint32_t xlim;
+    uint32_t ylim;
+    life_rule rule;
+    uint64_t seed;
+
+    uint64_t soups;
+    uint64_t extinct;
+    uint64_t unfinished;
+    uint64_t edge;
+    soup_census census;
+
+    unsigned int bands;
+    struct pool *pool;
+    soup_band *band;
+    uint64_t round_start;
+    uint64_t round_end;
+};
+typedef struct soup_search soup_search;
+
+/*** FUNCTIONS ***/
+
+soup_search *init_soup_search(uint32_t xlim, uint32_t ylim, const life_rule *rule,
+        uint64_t seed, unsigned int threads);
+void destroy_soup_search(soup_search *s);
+void soup_run(soup_search *s, uint64_t soups);
+int soup_resume(soup_search *s, const char *filename, int keep_seed);
+int soup_save_census(soup_search *s, const char *filename);
+census_entry *soup_sorted_census(soup_search *s);
+
+#endif
+/* vim: set ft=c : */
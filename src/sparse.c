@@ -0,0 +1,455 @@
+#include <stdio.h>
+#include <string.h>
+#include "sparse.h"
+
+/*
+ * Sparse, unbounded world made of CHUNK_SIZE square chunks
+ *
+ * Each chunk holds its rows one bit per cell, twice: the current rows
+ * and the ones being calculated. A chunk is only calculated if it or one
+ * of its eight neighbours changed in the last step; a missing chunk is
+ * all dead. Before each step, changing chunks with live cells on their
+ * border get the neighbours those cells could spread into, and after it
+ * chunks that are empty and weren't calculated are freed. Memory then
+ * follows the live population rather than its bounding box.
+ *
+ * Rows are stepped with the same bit-sliced adders as the bitwise
+ * engine, with a chunk's left and right neighbours as its guard words.
+ * Rules where dead cells with no neighbours are born (B0) would fill the
+ * plane, so they can't be used.
+ *
+ * As the "sparse" engine, a world is a window onto a sparse world. Edits
+ * to the window replace what is under it, and the chunks outside of it
+ * go on evolving.
+ */
+
+#define SPARSE_MIN_TABLE 64
+
+/*
+ * Chunks are made in the middle of a step, which can't be undone, so
+ * running out of memory for one ends the program
+ */
+static void *_check_alloc(void *p) {
+    if (p == NULL) {
+        fprintf(stderr, "Out of memory for the sparse world\n");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+static inline uint64_t _key(int32_t cx, int32_t cy) {
+    return ((uint64_t) (uint32_t) cx << 32) | (uint32_t) cy;
+}
+
+static inline size_t _home(sparse_world *sw, uint64_t key) {
+    uint64_t h = key * 0x9e3779b97f4a7c15ull;
+    return (h ^ (h >> 32)) & (sw->table_size - 1);
+}
+
+static chunk *_find(sparse_world *sw, int32_t cx, int32_t cy) {
+    uint64_t key = _key(cx, cy);
+
+    for (size_t i = _home(sw, key); sw->table[i] != NULL; i = (i + 1) & (sw->table_size - 1)) {
+        if (sw->table[i]->key == key) {
+            return sw->table[i];
+        }
+    }
+    return NULL;
+}
+
+static void _table_insert(sparse_world *sw, chunk *c) {
+    size_t i = _home(sw, c->key);
+
+    while (sw->table[i] != NULL) {
+        i = (i + 1) & (sw->table_size - 1);
+    }
+    sw->table[i] = c;
+}
+
+/*
+ * Remove a chunk, moving later chunks of the probe sequence back into
+ * the gap so lookups never need tombstones
+ */
+static void _table_remove(sparse_world *sw, chunk *c) {
+    size_t mask = sw->table_size - 1, i = _home(sw, c->key), j, k;
+
+    while (sw->table[i] != c) {
+        i = (i + 1) & mask;
+    }
+    sw->table[i] = NULL;
+
+    for (j = (i + 1) & mask; sw->table[j] != NULL; j = (j + 1) & mask) {
+        k = _home(sw, sw->table[j]->key);
+        // Move it if its home isn't cyclically within (i, j]
+        if ((i <= j) ? (k <= i || k > j) : (k <= i && k > j)) {
+            sw->table[i] = sw->table[j];
+            sw->table[j] = NULL;
+            i = j;
+        }
+    }
+}
+
+static chunk *_create(sparse_world *sw, int32_t cx, int32_t cy) {
+    chunk *c = _check_alloc(calloc(1, sizeof(chunk)));
+    c->cx = cx;
+    c->cy = cy;
+    c->key = _key(cx, cy);
+
+    if (sw->chunk_count == sw->chunk_max) {
+        sw->chunk_max *= 2;
+        sw->chunks = _check_alloc(realloc(sw->chunks, sw->chunk_max * sizeof(chunk *)));
+    }
+    c->index = sw->chunk_count;
+    sw->chunks[sw->chunk_count++] = c;
+
+    // Keep the table at most half full
+    if (sw->chunk_count * 2 > sw->table_size) {
+        free(sw->table);
+        sw->table_size *= 2;
+        sw->table = _check_alloc(calloc(sw->table_size, sizeof(chunk *)));
+        for (size_t i = 0; i < sw->chunk_count - 1; ++i) {
+            _table_insert(sw, sw->chunks[i]);
+        }
+    }
+    _table_insert(sw, c);
+    return c;
+}
+
+static void _destroy_chunk(sparse_world *sw, chunk *c) {
+    chunk *last = sw->chunks[--sw->chunk_count];
+
+    _table_remove(sw, c);
+    sw->chunks[c->index] = last;
+    last->index = c->index;
+    free(c);
+}
+
+static inline chunk *_find_or_create(sparse_world *sw, int32_t cx, int32_t cy) {
+    chunk *c = _find(sw, cx, cy);
+    return c != NULL ? c : _create(sw, cx, cy);
+}
+
+static inline int _empty(const board_word *rows) {
+    board_word all = 0;
+    for (int r = 0; r < CHUNK_SIZE; ++r) {
+        all |= rows[r];
+    }
+    return all == 0;
+}
+
+sparse_world *init_sparse_world(void) {
+    sparse_world *sw = _check_alloc(malloc(sizeof(sparse_world)));
+    sw->table_size = SPARSE_MIN_TABLE;
+    sw->table = _check_alloc(calloc(sw->table_size, sizeof(chunk *)));
+    sw->chunk_max = SPARSE_MIN_TABLE / 2;
+    sw->chunk_count = 0;
+    sw->chunks = _check_alloc(malloc(sw->chunk_max * sizeof(chunk *)));
+    sw->phase = 0;
+    sw->generation = 0;
+    sw->rule = make_rule(CONWAY_BIRTH, CONWAY_SURVIVE);
+    return sw;
+}
+
+void destroy_sparse_world(sparse_world *sw) {
+    for (size_t i = 0; i < sw->chunk_count; ++i) {
+        free(sw->chunks[i]);
+    }
+    free(sw->chunks);
+    free(sw->table);
+    free(sw);
+}
+
+int sparse_get_cell(sparse_world *sw, int64_t x, int64_t y) {
+    chunk *c = _find(sw, x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+    if (c == NULL) {
+        return 0;
+    }
+    return (c->rows[sw->phase][y & (CHUNK_SIZE - 1)] >> (x & (CHUNK_SIZE - 1))) & 1;
+}
+
+void sparse_set_cell(sparse_world *sw, int64_t x, int64_t y, int alive) {
+    chunk *c = alive ? _find_or_create(sw, x >> CHUNK_SHIFT, y >> CHUNK_SHIFT)
+                     : _find(sw, x >> CHUNK_SHIFT, y >> CHUNK_SHIFT);
+    board_word bit = (board_word) 1 << (x & (CHUNK_SIZE - 1)), *row;
+
+    if (c == NULL) {
+        return;
+    }
+    row = &c->rows[sw->phase][y & (CHUNK_SIZE - 1)];
+    if (((*row & bit) != 0) != (alive != 0)) {
+        *row ^= bit;
+        c->changed = 1;
+    }
+}
+
+/*
+ * Copy the current state of a world in, with its top left cell at
+ * (x0, y0), and take its rule. Cells outside of it are left alone.
+ */
+void sparse_from_world(sparse_world *sw, world *w, int64_t x0, int64_t y0) {
+    // Settled chunks may not be settled under a new rule
+    if (!rule_equal(&sw->rule, &w->rule)) {
+        sw->rule = w->rule;
+        for (size_t i = 0; i < sw->chunk_count; ++i) {
+            sw->chunks[i]->changed = 1;
+        }
+    }
+    for (uint32_t y = 0; y < w->ylim; ++y) {
+        int64_t gy = y0 + y;
+        size_t c = (size_t) y * w->xlim;
+
+        for (uint32_t xs = 0, xe; xs < w->xlim; xs = xe) {
+            int64_t gx = x0 + xs;
+            unsigned int off = gx & (CHUNK_SIZE - 1);
+            board_word bits = 0, mask, *row;
+            chunk *ch;
+
+            xe = xs + (CHUNK_SIZE - off) < w->xlim ? xs + (CHUNK_SIZE - off) : w->xlim;
+            mask = (xe - xs == CHUNK_SIZE ? ~(board_word) 0 : (((board_word) 1 << (xe - xs)) - 1)) << off;
+            for (uint32_t x = xs; x < xe; ++x, ++c) {
+                bits |= (board_word) ((w->data[c >> IDX_DIV] >> ((c & OFFSET_MASK) * BITS_PER_CELL + 1)) & 1)
+                    << (off + x - xs);
+            }
+
+            ch = bits ? _find_or_create(sw, gx >> CHUNK_SHIFT, gy >> CHUNK_SHIFT)
+                      : _find(sw, gx >> CHUNK_SHIFT, gy >> CHUNK_SHIFT);
+            if (ch == NULL) {
+                continue;
+            }
+            row = &ch->rows[sw->phase][gy & (CHUNK_SIZE - 1)];
+            if ((*row & mask) != bits) {
+                *row = (*row & ~mask) | bits;
+                ch->changed = 1;
+            }
+        }
+    }
+    sw->generation = w->generation;
+}
+
+/*
+ * Set both state bits of the live cells of the xlim by ylim region with
+ * its top left cell at (x0, y0) in data, laid out like world data
+ */
+void sparse_export(sparse_world *sw, int64_t x0, int64_t y0, uint32_t xlim, uint32_t ylim,
+        world_store *data) {
+    for (size_t i = 0; i < sw->chunk_count; ++i) {
+        chunk *ch = sw->chunks[i];
+        int64_t left = (int64_t) ch->cx * CHUNK_SIZE - x0,
+                top = (int64_t) ch->cy * CHUNK_SIZE - y0;
+
+        if (left >= xlim || top >= ylim || left + CHUNK_SIZE <= 0 || top + CHUNK_SIZE <= 0) {
+            continue;
+        }
+        for (int r = 0; r < CHUNK_SIZE; ++r) {
+            board_word bits = ch->rows[sw->phase][r];
+            int64_t y = top + r;
+
+            if (y < 0 || y >= ylim) {
+                continue;
+            }
+            for (int b = 0; bits != 0; ++b, bits >>= 1) {
+                int64_t x = left + b;
+                if ((bits & 1) && x >= 0 && x < xlim) {
+                    size_t c = (size_t) y * xlim + x;
+                    data[c >> IDX_DIV] |= (world_store) SINGLE_CELL_MASK << ((c & OFFSET_MASK) * BITS_PER_CELL);
+                }
+            }
+        }
+    }
+}
+
+/*
+ * Make sure the neighbours that a chunk's border cells could spread into
+ * exist
+ */
+static void _grow(sparse_world *sw, chunk *c) {
+    const board_word *rows = c->rows[sw->phase];
+    board_word top = rows[0], bottom = rows[CHUNK_SIZE - 1], all = 0;
+    int left, right;
+
+    for (int r = 0; r < CHUNK_SIZE; ++r) {
+        all |= rows[r];
+    }
+    left = all & 1;
+    right = all >> (CHUNK_SIZE - 1);
+
+    if (top) {
+        _find_or_create(sw, c->cx, c->cy - 1);
+    }
+    if (bottom) {
+        _find_or_create(sw, c->cx, c->cy + 1);
+    }
+    if (left) {
+        _find_or_create(sw, c->cx - 1, c->cy);
+    }
+    if (right) {
+        _find_or_create(sw, c->cx + 1, c->cy);
+    }
+    if (top & 1) {
+        _find_or_create(sw, c->cx - 1, c->cy - 1);
+    }
+    if (top >> (CHUNK_SIZE - 1)) {
+        _find_or_create(sw, c->cx + 1, c->cy - 1);
+    }
+    if (bottom & 1) {
+        _find_or_create(sw, c->cx - 1, c->cy + 1);
+    }
+    if (bottom >> (CHUNK_SIZE - 1)) {
+        _find_or_create(sw, c->cx + 1, c->cy + 1);
+    }
+}
+
+/*
+ * Next rows of the middle chunk of nb, missing chunks being dead
+ */
+static void _calc_chunk(sparse_world *sw, chunk *nb[3][3], board_word *next) {
+    board_word row[CHUNK_SIZE + 2][3], s0[CHUNK_SIZE + 2], s1[CHUNK_SIZE + 2];
+
+    // Rows -1 to CHUNK_SIZE, each with its left and right neighbour words
+    for (int r = 0; r < CHUNK_SIZE + 2; ++r) {
+        int dy = r == 0 ? 0 : (r == CHUNK_SIZE + 1 ? 2 : 1);
+        int src = (r + CHUNK_SIZE - 1) % CHUNK_SIZE;
+
+        for (int dx = 0; dx < 3; ++dx) {
+            row[r][dx] = nb[dy][dx] != NULL ? nb[dy][dx]->rows[sw->phase][src] : 0;
+        }
+        _row_sums_from(row[r], s0 + r, s1 + r, 0, 1);
+    }
+
+    for (int r = 0; r < CHUNK_SIZE; ++r) {
+        board_slot up = { row[r], s0 + r, s1 + r },
+                   mid = { row[r + 1], s0 + r + 1, s1 + r + 1 },
+                   down = { row[r + 2], s0 + r + 2, s1 + r + 2 };
+        if (rule_is_conway(&sw->rule)) {
+            _life_row_from(&up, &mid, &down, next + r, 0, 1);
+        } else if (!sw->rule.totalistic) {
+            _table_row_from(&up, &mid, &down, &sw->rule, next + r, 0, 1);
+        } else {
+            _rule_row_from(&up, &mid, &down, &sw->rule, next + r, 0, 1);
+        }
+    }
+}
+
+void sparse_step(sparse_world *sw) {
+    int cur = sw->phase, nxt = !sw->phase;
+    size_t count = sw->chunk_count;
+
+    for (size_t i = 0; i < count; ++i) {
+        if (sw->chunks[i]->changed) {
+            _grow(sw, sw->chunks[i]);
+        }
+    }
+
+    for (size_t i = 0; i < sw->chunk_count; ++i) {
+        chunk *c = sw->chunks[i], *nb[3][3];
+
+        c->active = 0;
+        for (int dy = 0; dy < 3; ++dy) {
+            for (int dx = 0; dx < 3; ++dx) {
+                nb[dy][dx] = (dx == 1 && dy == 1) ? c : _find(sw, c->cx + dx - 1, c->cy + dy - 1);
+                c->active |= nb[dy][dx] != NULL && nb[dy][dx]->changed;
+            }
+        }
+
+        if (c->active) {
+            _calc_chunk(sw, nb, c->rows[nxt]);
+            c->changing = memcmp(c->rows[nxt], c->rows[cur], sizeof(c->rows[cur])) != 0;
+        } else {
+            memcpy(c->rows[nxt], c->rows[cur], sizeof(c->rows[cur]));
+            c->changing = 0;
+        }
+    }
+
+    // Backwards, as freeing moves the last chunk into the gap
+    sw->phase = nxt;
+    for (size_t i = sw->chunk_count; i-- > 0;) {
+        chunk *c = sw->chunks[i];
+        c->changed = c->changing;
+        if (!c->active && _empty(c->rows[nxt])) {
+            _destroy_chunk(sw, c);
+        }
+    }
+    sw->generation++;
+}
+
+uint64_t sparse_population(sparse_world *sw) {
+    uint64_t pop = 0;
+
+    for (size_t i = 0; i < sw->chunk_count; ++i) {
+        for (int r = 0; r < CHUNK_SIZE; ++r) {
+            for (board_word bits = sw->chunks[i]->rows[sw->phase][r]; bits != 0; bits &= bits - 1) {
+                pop++;
+            }
+        }
+    }
+    return pop;
+}
+
+size_t sparse_memory(sparse_world *sw) {
+    return sizeof(sparse_world) + sw->chunk_count * sizeof(chunk) +
+        (sw->table_size + sw->chunk_max) * sizeof(chunk *);
+}
+
+static void _init_sparse(world *w) {
+    w->engine_data = init_sparse_world();
+}
+
+static void _destroy_sparse(world *w) {
+    destroy_sparse_world(w->engine_data);
+}
+
+/*
+ * The world is a window onto the sparse world at (0, 0), taken in when
+ * it was edited, which leaves the cells outside of it alone
+ */
+static void _take_window(world *w) {
+    sparse_world *sw = w->engine_data;
+
+    if (w->edited || !rule_equal(&sw->rule, &w->rule)) {
+        sparse_from_world(sw, w, 0, 0);
+    }
+}
+
+static void _calc_sparse(world *w) {
+    _take_window(w);
+    sparse_step(w->engine_data);
+}
+
+static int _step_n_sparse(world *w, unsigned int n) {
+    sparse_world *sw = w->engine_data;
+
+    if ((uint64_t) w->generation + n > UINT32_MAX) {
+        return 0;
+    }
+    _take_window(w);
+    for (unsigned int i = 0; i < n; ++i) {
+        sparse_step(sw);
+    }
+    world_take_pattern(w, (uint32_t) sw->generation);
+    return 1;
+}
+
+static int _get_cell_sparse(world *w, int64_t x, int64_t y) {
+    return sparse_get_cell(w->engine_data, x, y);
+}
+
+static int _set_cell_sparse(world *w, int64_t x, int64_t y, int alive) {
+    sparse_set_cell(w->engine_data, x, y, alive);
+    return 1;
+}
+
+static void _export_sparse(world *w, int64_t x0, int64_t y0, uint32_t xlim, uint32_t ylim,
+        world_store *data) {
+    sparse_export(w->engine_data, x0, y0, xlim, ylim, data);
+}
+
+static void _stats_sparse(world *w, engine_stats *stats) {
+    stats->population = sparse_population(w->engine_data);
+    stats->memory = sparse_memory(w->engine_data);
+}
+
+const world_engine_ops SPARSE_ENGINE = {
+    "sparse", "Unbounded plane of 64x64 cell chunks, the world a window onto it",
+    _calc_sparse, _init_sparse, _step_n_sparse, NULL, _destroy_sparse,
+    engine_refuses_unbounded, _get_cell_sparse, _set_cell_sparse, _export_sparse, _stats_sparse, NULL
+};
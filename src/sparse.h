@@ -0,0 +1,71 @@
+#ifndef _SPARSE_H
+#define _SPARSE_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include "world.h"
+#include "engine.h"
+#include "kernels.h"
+
+// Chunks are CHUNK_SIZE cells square, one board_word per row
+#define CHUNK_SIZE BOARD_BITS
+#define CHUNK_SHIFT 6 // log2 CHUNK_SIZE
+
+/*** TYPES ***/
+
+struct chunk {
+    // Chunk coordinates, packed into key
+    int32_t cx;
+    int32_t cy;
+    uint64_t key;
+    size_t index;
+
+    // Current rows are rows[phase], the next ones rows[!phase]
+    board_word rows[2][CHUNK_SIZE];
+
+    // Changed in the last step, and while stepping: calculated and
+    // changing in this one
+    uint8_t changed;
+    uint8_t active;
+    uint8_t changing;
+};
+typedef struct chunk chunk;
+
+/*
+ * An unbounded world. Only chunks with live cells, or next to ones that
+ * are changing, are kept, in an open addressing table keyed by their
+ * coordinates.
+ */
+struct sparse_world {
+    chunk **table;
+    size_t table_size;
+
+    // Every chunk, for stepping in a stable order
+    chunk **chunks;
+    size_t chunk_count;
+    size_t chunk_max;
+
+    int phase;
+    uint64_t generation;
+    life_rule rule;
+};
+typedef struct sparse_world sparse_world;
+
+/*** FUNCTIONS ***/
+
+// Registered as the "sparse" engine
+extern const world_engine_ops SPARSE_ENGINE;
+
+sparse_world *init_sparse_world(void);
+void destroy_sparse_world(sparse_world *sw);
+int sparse_get_cell(sparse_world *sw, int64_t x, int64_t y);
+void sparse_set_cell(sparse_world *sw, int64_t x, int64_t y, int alive);
+void sparse_from_world(sparse_world *sw, world *w, int64_t x0, int64_t y0);
+void sparse_export(sparse_world *sw, int64_t x0, int64_t y0, uint32_t xlim, uint32_t ylim,
+        world_store *data);
+void sparse_step(sparse_world *sw);
+uint64_t sparse_population(sparse_world *sw);
+size_t sparse_memory(sparse_world *sw);
+
+#endif
+/* vim: set ft=c : */
@@ -0,0 +1,273 @@
+#include <string.h>
+#include "stats.h"
+
+/*
+ * Per-generation statistics
+ *
+ * These come out of the shift that makes the next states current, which
+ * every engine and rule goes through and which already reads each store
+ * it changes. Births and deaths are counted from the stores' old and
+ * new states, with the popcnt instruction where the CPU has it (see
+ * kernels.h), so the population follows from the last one's. Tiles that
+ * changed are marked as having live cells, and marks are only cleared
+ * when a tile is found empty, so a marked tile can turn out to be empty,
+ * but a tile with live cells is always marked.
+ *
+ * The live bounding box is found from the outermost marked tiles, by
+ * looking at the cells of only those, in time of the number of tiles and
+ * the box's edges rather than of cells. Edge tiles found empty on the way
+ * are unmarked. The whole world is only counted after it was changed
+ * directly.
+ *
+ * Generations stepped in blocks (world_step_n) are only counted at the
+ * end of each block, and their births and deaths are the net change in
+ * population over it, one of them 0.
+ */
+
+void stats_reset(world *w) {
+    w->stats_history->count = 0;
+    w->stats_history->next = 0;
+    w->stats_history->recorded = 0;
+    w->stats_valid = 0;
+}
+
+/*
+ * Count the live cells of rows [y0, y1), a whole tile row, and mark its
+ * tiles. Returns the count.
+ */
+uint64_t stats_count_tiles(world *w, uint32_t y0, uint32_t y1) {
+    uint8_t *live = w->tile_live + (size_t) (y0 / TILE_ROWS) * w->tile_cols;
+    size_t start = ((size_t) y0 * w->xlim) >> IDX_DIV,
+           end = ((size_t) y1 * w->xlim + OFFSET_MASK) >> IDX_DIV;
+    uint64_t population = 0;
+    uint32_t x = 0;
+
+    // Tile rows start on a store of their own
+    memset(live, 0, w->tile_cols);
+    for (size_t i = start; i < end; ++i, x += CELLS_PER_ELEM) {
+        world_store v = w->data[i] & CURR_CELL_MASK;
+
+        x = x < w->xlim ? x : x - w->xlim;
+        if (v) {
+            population += stats_popcount(v);
+            live[x / TILE_COLS] = 1;
+            if (x + OFFSET_MASK < w->xlim) {
+                live[(x + OFFSET_MASK) / TILE_COLS] = 1;
+            } else {
+                live[w->tile_cols - 1] = live[0] = 1;
+            }
+        }
+    }
+    return population;
+}
+
+/*
+ * First live cell of row y from x0 up to x1, x1 if there is none
+ */
+static uint32_t _first_live(world *w, uint32_t y, uint32_t x0, uint32_t x1) {
+    size_t row = (size_t) y * w->xlim;
+
+    for (uint32_t x = x0; x < x1; ) {
+        size_t c = row + x;
+        unsigned int j = c & OFFSET_MASK;
+        world_store v = (w->data[c >> IDX_DIV] & CURR_CELL_MASK) >> j * BITS_PER_CELL;
+
+        if (v == 0) {
+            x += CELLS_PER_ELEM - j;
+            continue;
+        }
+        while (!(v & 2)) {
+            v >>= BITS_PER_CELL;
+            ++x;
+        }
+        return x < x1 ? x : x1;
+    }
+    return x1;
+}
+
+/*
+ * Last live cell of row y from x1 down to x0, both included, x1 + 1 if
+ * there is none
+ */
+static uint32_t _last_live(world *w, uint32_t y, uint32_t x0, uint32_t x1) {
+    size_t row = (size_t) y * w->xlim;
+
+    for (int64_t x = x1; x >= x0; ) {
+        size_t c = row + x;
+        unsigned int j = c & OFFSET_MASK;
+        world_store v = w->data[c >> IDX_DIV] & CURR_CELL_MASK &
+            ((world_store) CURR_CELL_MASK >> (OFFSET_MASK - j) * BITS_PER_CELL);
+
+        if (v == 0) {
+            x -= j + 1;
+            continue;
+        }
+        while (!((v >> j * BITS_PER_CELL) & 2)) {
+            --j;
+            --x;
+        }
+        return x >= x0 ? x : x1 + 1;
+    }
+    return x1 + 1;
+}
+
+static inline int _marked(world *w, uint32_t y, uint32_t c) {
+    return w->tile_live[(size_t) (y / TILE_ROWS) * w->tile_cols + c];
+}
+
+static void _unmark_column(world *w, uint32_t c) {
+    for (uint32_t r = 0; r < w->tile_rows; ++r) {
+        w->tile_live[(size_t) r * w->tile_cols + c] = 0;
+    }
+}
+
+/*
+ * Bounding box of the live cells, from the tiles marked as having any.
+ * Marked tiles that are empty are looked past, and unmarked if they are
+ * in a whole row or column of tiles found empty.
+ */
+static void _bounding_box(world *w, world_stats *s) {
+    uint32_t tr0 = w->tile_rows, tr1 = 0, tc0 = w->tile_cols, tc1 = 0;
+    uint32_t x0, x1, y;
+
+    s->x0 = s->y0 = s->x1 = s->y1 = 0;
+    if (s->population == 0) {
+        memset(w->tile_live, 0, (size_t) w->tile_rows * w->tile_cols);
+        return;
+    }
+    for (uint32_t r = 0; r < w->tile_rows; ++r) {
+        const uint8_t *live = w->tile_live + (size_t) r * w->tile_cols;
+        for (uint32_t c = 0; c < w->tile_cols; ++c) {
+            if (live[c]) {
+                tr0 = r < tr0 ? r : tr0;
+                tr1 = r;
+                tc0 = c < tc0 ? c : tc0;
+                tc1 = c > tc1 ? c : tc1;
+            }
+        }
+    }
+
+    // Rows first, across the columns of the marked tiles, which have
+    // every live cell in them
+    x0 = tc0 * TILE_COLS;
+    x1 = (tc1 + 1) * TILE_COLS < w->xlim ? (tc1 + 1) * TILE_COLS : w->xlim;
+    for (y = tr0 * TILE_ROWS; _first_live(w, y, x0, x1) == x1; ++y) {
+        if (y % TILE_ROWS == TILE_ROWS - 1) {
+            memset(w->tile_live + (size_t) (y / TILE_ROWS) * w->tile_cols, 0, w->tile_cols);
+        }
+    }
+    s->y0 = y;
+    y = (tr1 + 1) * TILE_ROWS < w->ylim ? (tr1 + 1) * TILE_ROWS : w->ylim;
+    while (_first_live(w, --y, x0, x1) == x1) {
+        if (y % TILE_ROWS == 0) {
+            memset(w->tile_live + (size_t) (y / TILE_ROWS) * w->tile_cols, 0, w->tile_cols);
+        }
+    }
+    s->y1 = y + 1;
+
+    // Then the columns, a column of tiles at a time from either side
+    s->x0 = x1;
+    for (uint32_t c = tc0; s->x0 == x1; ++c) {
+        uint32_t cx0 = c * TILE_COLS,
+                 cx1 = cx0 + TILE_COLS < x1 ? cx0 + TILE_COLS : x1;
+        for (y = s->y0; y < s->y1 && s->x0 > cx0; ++y) {
+            if (_marked(w, y, c)) {
+                uint32_t x = _first_live(w, y, cx0, cx1 < s->x0 ? cx1 : s->x0);
+                s->x0 = x < cx1 && x < s->x0 ? x : s->x0;
+            }
+        }
+        if (s->x0 == x1) {
+            _unmark_column(w, c);
+        }
+    }
+    s->x1 = x0;
+    for (uint32_t c = tc1 + 1; s->x1 == x0; --c) {
+        uint32_t cx0 = (c - 1) * TILE_COLS,
+                 cx1 = c * TILE_COLS < x1 ? c * TILE_COLS : x1;
+        for (y = s->y0; y < s->y1 && s->x1 < cx1; ++y) {
+            if (_marked(w, y, c - 1)) {
+                uint32_t x = _last_live(w, y, cx0 > s->x1 ? cx0 : s->x1, cx1 - 1);
+                s->x1 = x < cx1 ? x + 1 : s->x1;
+            }
+        }
+        if (s->x1 == x0) {
+            _unmark_column(w, c - 1);
+        }
+    }
+}
+
+/*
+ * Record the statistics of the current generation, once the marks of
+ * every tile are up to date. A generation recorded again, after the
+ * world was changed directly, replaces the one it had, without counting
+ * as recorded again.
+ */
+void stats_record(world *w, uint64_t population, uint64_t births, uint64_t deaths) {
+    stats_history *h = w->stats_history;
+    world_stats *s = &w->stats;
+    unsigned int newest = (h->next + STATS_HISTORY - 1) % STATS_HISTORY;
+
+    s->generation = w->generation;
+    s->population = population;
+    s->births = births;
+    s->deaths = deaths;
+    _bounding_box(w, s);
+    w->stats_valid = 1;
+
+    if (h->count > 0 && h->entries[newest].generation == s->generation) {
+        h->entries[newest] = *s;
+        return;
+    }
+    h->entries[h->next] = *s;
+    h->next = (h->next + 1) % STATS_HISTORY;
+    h->count += h->count < STATS_HISTORY;
+    ++h->recorded;
+}
+
+/*
+ * Record the current generation after stepping several at once, with
+ * the change in population since the last one as its births or deaths
+ */
+void stats_record_net(world *w, uint64_t population) {
+    uint64_t before = w->stats_valid ? w->stats.population : population;
+
+    stats_record(w, population, population > before ? population - before : 0,
+            population < before ? before - population : 0);
+}
+
+/*
+ * Statistics recorded ago generations before the newest, NULL if they
+ * are no longer kept
+ */
+const world_stats *stats_get(world *w, unsigned int ago) {
+    const stats_history *h = w->stats_history;
+
+    if (ago >= h->count) {
+        return NULL;
+    }
+    return &h->entries[(h->next + STATS_HISTORY - 1 - ago) % STATS_HISTORY];
+}
+
+void stats_csv_header(FILE *out) {
+    fputs("generation,population,births,deaths,x0,y0,x1,y1\n", out);
+}
+
+/*
+ * Write the statistics recorded since from, a count of recorded ones,
+ * as CSV rows, those still kept anyway. Returns the count to write from
+ * next time.
+ */
+uint64_t stats_write_csv(world *w, FILE *out, uint64_t from) {
+    const stats_history *h = w->stats_history;
+    uint64_t ago = h->recorded - from;
+
+    for (ago = ago < h->count ? ago : h->count; ago > 0; --ago) {
+        const world_stats *s = stats_get(w, ago - 1);
+        fprintf(out, "%lu,%llu,%llu,%llu,%lu,%lu,%lu,%lu\n",
+                (unsigned long) s->generation, (unsigned long long) s->population,
+                (unsigned long long) s->births, (unsigned long long) s->deaths,
+                (unsigned long) s->x0, (unsigned long) s->y0,
+                (unsigned long) s->x1, (unsigned long) s->y1);
+    }
+    return h->recorded;
+}
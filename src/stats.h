@@ -0,0 +1,61 @@
+#ifndef _STATS_H
+#define _STATS_H
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include "world.h"
+
+// Generations of statistics kept
+#define STATS_HISTORY 1024
+
+/*** TYPES ***/
+
+/*
+ * A band's share of a step: cells born and died as its stores were
+ * shifted, or its live cells when counted whole
+ */
+struct stats_band {
+    uint64_t births;
+    uint64_t deaths;
+    uint64_t population;
+};
+typedef struct stats_band stats_band;
+
+/*
+ * Statistics of the last STATS_HISTORY recorded generations, a ring with
+ * the newest at next - 1. recorded counts every one ever recorded, so a
+ * reader can tell which it hasn't seen yet.
+ */
+struct stats_history {
+    world_stats entries[STATS_HISTORY];
+    unsigned int count;
+    unsigned int next;
+    uint64_t recorded;
+};
+typedef struct stats_history stats_history;
+
+/*** INLINE HELPERS ***/
+
+/*
+ * Live cells of a store, those with their current state bit set in v
+ */
+static inline unsigned int stats_popcount(world_store v) {
+    v = (v >> 1) & NEXT_CELL_MASK;
+    v = (v & 0x33333333) + ((v >> 2) & 0x33333333);
+    v = (v + (v >> 4)) & 0x0f0f0f0f;
+    return (v * 0x01010101) >> 24;
+}
+
+/*** FUNCTIONS ***/
+
+void stats_reset(world *w);
+uint64_t stats_count_tiles(world *w, uint32_t y0, uint32_t y1);
+void stats_record(world *w, uint64_t population, uint64_t births, uint64_t deaths);
+void stats_record_net(world *w, uint64_t population);
+const world_stats *stats_get(world *w, unsigned int ago);
+void stats_csv_header(FILE *out);
+uint64_t stats_write_csv(world *w, FILE *out, uint64_t from);
+
+#endif
+/* vim: set ft=c : */
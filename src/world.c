@@ -1,8 +1,28 @@
+#include <string.h>
 #include "world.h"
+#include "engine.h"
+#include "bitwise.h"
+#include "ltl.h"
+#include "generations.h"
+#include "cycle.h"
+#include "stats.h"
+#include "pool.h"
+#include "numa.h"
+#include "pages.h"
+#include "fsutil.h"
 
 static const uint16_t MAGIC = 0xf0de;
+static const uint16_t MAGIC_V2 = 0xf0df;
+
+static world_engine default_engine = BITWISE;
+static unsigned int default_threads = 1;
+static int default_numa = 0;
+static life_rule default_rule;
+static int default_rule_set = 0;
 
 static const char DISPLAY_CHARS[4] = { '.', 'o', '*', 'O' };
+// Dying states of Generations rules, from 2 on, any after these as the last
+static const char DYING_CHARS[] = "23456789+";
 /*
  * Number of set bits in the lowest 3 'even' bit positions.
  * Using a number masked by 0x2a as an index to this array,
@@ -21,40 +41,340 @@ static const char BIT_COUNTS[BIT_COUNT_LEN] = {
     2,   2,   3,   3,   2,   2,   3,   3
 };
 
-world* init_world(uint32_t xlim, uint32_t ylim) {
-    world *w = malloc(sizeof(world));
+/*
+ * First row of a band. Bands are aligned so that no world_store is
+ * shared between two of them.
+ */
+static inline uint32_t _band_row(world *w, unsigned int band) {
+    if (band >= w->bands) {
+        return w->ylim;
+    }
+    uint32_t y = (uint64_t) w->ylim * band / w->bands;
+    return y - y % BAND_ALIGN;
+}
+
+static inline void _run_bands(world *w, pool_func_type func) {
+    if (w->pool != NULL) {
+        pool_run(w->pool, func, w);
+    } else {
+        func(w, 0, 1);
+    }
+}
+
+static inline size_t _band_store(world *w, unsigned int band) {
+    if (band >= w->bands) {
+        return w->data_size;
+    }
+    return ((size_t) _band_row(w, band) * w->xlim) >> IDX_DIV;
+}
+
+static inline size_t _data_bytes(world *w) {
+    return (w->data_size + 1) * sizeof(world_store);
+}
+
+static inline size_t _board_bytes(world *w) {
+    return w->bands * bitwise_board_size(w->xlim) * sizeof(board_word);
+}
+
+static inline size_t _block_bytes(world *w) {
+    return w->bands * bitwise_block_size(w->xlim) * sizeof(board_word);
+}
+
+static inline size_t _decay_bytes(world *w) {
+    return (w->data_size + 1) * w->decay_planes * sizeof(world_store);
+}
+
+static inline board_word *_band_board(world *w, unsigned int band) {
+    return w->board + band * bitwise_board_size(w->xlim);
+}
+
+static inline board_word *_band_block(world *w, unsigned int band) {
+    return w->block + band * bitwise_block_size(w->xlim);
+}
+
+static inline int _band_node(world *w, unsigned int band) {
+    return (uint64_t) band * numa_count_nodes() / w->bands;
+}
+
+/*
+ * First touch of a band's memory, from the thread that steps it, so
+ * its pages are placed on that thread's node. Band 0 is run by the
+ * calling thread, which only visits its node and keeps its own CPUs.
+ */
+static void _place_band(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    size_t start = _band_store(w, band),
+           end = band + 1 < bands ? _band_store(w, band + 1) : w->data_size + 1;
+    void *saved = band == 0 ? numa_save_affinity() : NULL;
+
+    numa_pin_thread(_band_node(w, band));
+    memset(w->data + start, 0, (end - start) * sizeof(world_store));
+    memset(w->temp_calc + start, 0, (end - start) * sizeof(world_store));
+    memset(_band_board(w, band), 0, bitwise_board_size(w->xlim) * sizeof(board_word));
+    numa_restore_affinity(saved);
+}
+
+/*
+ * Memory split between the bands. With NUMA placement it is untouched
+ * until written, so _place_band decides which node it is on.
+ */
+static inline void *_alloc_bands(world *w, size_t size) {
+    return w->numa ? pages_alloc_placed(size) : pages_alloc(size);
+}
+
+/*
+ * Dying planes for the world's rule, all dead, unless it already has
+ * them. Rules with 2 states have none.
+ */
+static void _alloc_decay(world *w) {
+    unsigned int planes = generations_planes(w->rule.states);
+
+    if (planes == w->decay_planes && (w->decay != NULL || planes == 0)) {
+        return;
+    }
+    pages_free(w->decay, _decay_bytes(w));
+    w->decay_planes = planes;
+    w->decay = planes ? pages_alloc(_decay_bytes(w)) : NULL;
+    if (planes && w->decay == NULL) {
+        exit(EXIT_FAILURE);
+    }
+}
+
+/*
+ * A world of xlim by ylim dead cells. Returns NULL, saying why, if it
+ * is too big for memory.
+ */
+world* init_world(uint32_t xlim, uint32_t ylim, world_topology topology) {
+    uint64_t cells = (uint64_t) xlim * ylim;
+    world *w;
+
+    if (xlim == 0 || ylim == 0 || cells > WORLD_MAX_CELLS) {
+        fprintf(stderr, "Can't make a %ux%u world\n", xlim, ylim);
+        return NULL;
+    }
+
+    w = malloc(sizeof(world));
     w->xlim = xlim;
     w->ylim = ylim;
     w->generation = 0;
     w->state = CALC;
+    w->engine = get_engine(default_engine) != NULL ? default_engine : BITWISE;
+    w->engine_data = NULL;
+    w->edited = 1;
+    w->topology = topology;
+    w->rule = default_rule_set ? default_rule : make_rule(CONWAY_BIRTH, CONWAY_SURVIVE);
+    w->numa = default_numa;
+
+    w->cell_count = cells;
+    w->data_size = (cells + CELLS_PER_ELEM - 1) / CELLS_PER_ELEM;
+
+    // Split rows into bands for the worker threads, each band gets its
+    // own board
+    w->bands = ylim / BAND_MIN_ROWS;
+    if (w->bands > default_threads) {
+        w->bands = default_threads;
+    } else if (w->bands == 0) {
+        w->bands = 1;
+    }
 
-    // TODO: Check if xlim and ylim are >= sqrt(SIZE_MAX/2)
-
-    w->cell_count = xlim * ylim;
-    w->data_size = ( w->cell_count * (float) BITS_PER_CELL ) / ( sizeof(world_store) * CHAR_BIT ) + .969;
+    w->data = _alloc_bands(w, _data_bytes(w));
+    w->temp_calc = w->data != NULL ? _alloc_bands(w, _data_bytes(w)) : NULL;
+    w->board = w->temp_calc != NULL ? _alloc_bands(w, _board_bytes(w)) : NULL;
+    if (w->board == NULL) {
+        pages_free(w->data, _data_bytes(w));
+        pages_free(w->temp_calc, _data_bytes(w));
+        pages_free(w->board, _board_bytes(w));
+        free(w);
+        return NULL;
+    }
 
-    w->data = calloc(w->data_size + 1, sizeof(world_store));
-    w->temp_calc = calloc(w->data_size + 1, sizeof(world_store));
+    // Only allocated once a range rule is stepped
+    w->range_cells = NULL;
+    w->decay = NULL;
+    w->decay_planes = 0;
+    w->block = NULL;
+    w->block_depth = 0;
+
+    // Pick the SIMD kernel before any worker needs it
+    get_kernel();
+    w->pool = w->bands > 1 ? init_pool(w->bands) : NULL;
+    w->edges_valid = 0;
+
+    w->tile_cols = (xlim + TILE_COLS - 1) / TILE_COLS;
+    w->tile_rows = (ylim + TILE_ROWS - 1) / TILE_ROWS;
+    w->tile_changed = calloc((size_t) w->tile_cols * w->tile_rows, sizeof(uint8_t));
+    w->tile_active = calloc((size_t) w->tile_cols * w->tile_rows, sizeof(uint8_t));
+    w->active_tiles = (size_t) w->tile_cols * w->tile_rows;
+    w->tiles_valid = 0;
+
+    w->hash = 0;
+    w->hash_valid = 0;
+    w->band_hash = calloc(w->bands, sizeof(uint64_t));
+    w->history = malloc(sizeof(cycle_history));
+    cycle_reset(w);
+
+    w->tile_live = calloc((size_t) w->tile_cols * w->tile_rows, sizeof(uint8_t));
+    w->band_stats = calloc(w->bands, sizeof(stats_band));
+    w->stats_history = malloc(sizeof(stats_history));
+    stats_reset(w);
+
+    if (w->numa) {
+        _run_bands(w, _place_band);
+    }
+    _alloc_decay(w);
+    if (get_engine(w->engine)->init != NULL) {
+        get_engine(w->engine)->init(w);
+    }
     return w;
 }
 
 void destroy_world(world *w) {
-    free(w->data);
-    free(w->temp_calc);
+    if (get_engine(w->engine)->destroy != NULL) {
+        get_engine(w->engine)->destroy(w);
+    }
+    pages_free(w->data, _data_bytes(w));
+    pages_free(w->temp_calc, _data_bytes(w));
+    pages_free(w->board, _board_bytes(w));
+    if (w->pool != NULL) {
+        destroy_pool(w->pool);
+    }
+    pages_free(w->range_cells, w->data_size * CELLS_PER_ELEM);
+    pages_free(w->decay, _decay_bytes(w));
+    pages_free(w->block, _block_bytes(w));
+    free(w->tile_changed);
+    free(w->tile_active);
+    free(w->band_hash);
+    free(w->history);
+    free(w->tile_live);
+    free(w->band_stats);
+    free(w->stats_history);
     free(w);
 }
 
+/*
+ * Step a world with another engine from now on, finishing a step that
+ * was left half done first. The new engine takes the world in as if it
+ * was edited.
+ */
+void world_set_engine(world *w, world_engine engine) {
+    if (w->state == SHIFT) {
+        world_half_step(w);
+    }
+    if (get_engine(w->engine)->destroy != NULL) {
+        get_engine(w->engine)->destroy(w);
+    }
+    w->engine = get_engine(engine) != NULL ? engine : BITWISE;
+    w->engine_data = NULL;
+    world_invalidate(w);
+    if (get_engine(w->engine)->init != NULL) {
+        get_engine(w->engine)->init(w);
+    }
+}
+
+/*
+ * Whether the world is a window onto a pattern its engine keeps, which
+ * can go on past its edges (see engine.h)
+ */
+int world_is_window(world *w) {
+    return get_engine(w->engine)->export_region != NULL;
+}
+
+/*
+ * Engine used by worlds created from now on
+ */
+void set_default_engine(world_engine engine) {
+    default_engine = engine;
+}
+
+/*
+ * Worker threads per world for worlds created from now on
+ */
+void set_default_threads(unsigned int threads) {
+    default_threads = threads > 0 ? threads : 1;
+}
+
+/*
+ * Place world memory and worker threads by NUMA node, for worlds
+ * created from now on
+ */
+void set_default_numa(int numa) {
+    default_numa = numa;
+}
+
+/*
+ * Rule of worlds created from now on, unless they are read from a file
+ * that has its own
+ */
+void set_default_rule(const life_rule *rule) {
+    default_rule = *rule;
+    default_rule_set = 1;
+}
+
+/*
+ * Forget cached stepping state after world data was changed directly,
+ * which also starts looking for cycles anew
+ */
+void world_invalidate(world *w) {
+    w->edited = 1;
+    w->edges_valid = 0;
+    w->tiles_valid = 0;
+    w->hash_valid = 0;
+    w->stats_valid = 0;
+    cycle_reset(w);
+}
+
+/*
+ * Make all dying cells dead, for when the world is filled anew
+ */
+void world_clear_dying(world *w) {
+    if (w->decay != NULL) {
+        memset(w->decay, 0, (w->data_size + 1) * w->decay_planes * sizeof(world_store));
+    }
+}
+
 void invert_cell(world_cell_pos *p) {
-    size_t i;
-    int j;
-    size_t cell_idx = (p->y * p->w->xlim) + p->x;
+    world_set_cell(p->w, p->x, p->y, !world_get_cell(p->w, p->x, p->y));
+}
+
+/*
+ * Whether the cell at (x, y) is alive. With an engine that keeps its own
+ * pattern, that is the pattern's cell, even outside the world, unless
+ * the pattern is a step ahead of it.
+ */
+int world_get_cell(world *w, int64_t x, int64_t y) {
+    const world_engine_ops *ops = get_engine(w->engine);
+    size_t c;
+
+    if (ops->get_cell != NULL && !w->edited && w->state == CALC) {
+        return ops->get_cell(w, x, y);
+    }
+    if (x < 0 || x >= w->xlim || y < 0 || y >= w->ylim) {
+        return 0;
+    }
+    c = (size_t) y * w->xlim + (size_t) x;
+    return (w->data[c >> IDX_DIV] >> ((c & OFFSET_MASK) * BITS_PER_CELL + 1)) & 1;
+}
 
-    i = cell_idx >> IDX_DIV;
-    j = cell_idx & OFFSET_MASK;
+/*
+ * Make the cell at (x, y) alive or dead. Cells outside the world are
+ * only kept by engines that keep their own pattern, which take in the
+ * one cell rather than the whole world, unless it is a step ahead.
+ */
+void world_set_cell(world *w, int64_t x, int64_t y, int alive) {
+    const world_engine_ops *ops = get_engine(w->engine);
+    int edited = w->edited;
+
+    if (x >= 0 && x < w->xlim && y >= 0 && y < w->ylim) {
+        size_t c = (size_t) y * w->xlim + (size_t) x;
+        int j = (c & OFFSET_MASK) * BITS_PER_CELL;
 
-    world_store cell_mask = (world_store) SINGLE_CELL_MASK << j*BITS_PER_CELL;
-    world_store cell_val = (p->w->data[i] >> j*BITS_PER_CELL) & SINGLE_CELL_MASK;
-    p->w->data[i] = (p->w->data[i] & ~cell_mask) | ((~cell_val << j*BITS_PER_CELL) & cell_mask);
+        w->data[c >> IDX_DIV] = (w->data[c >> IDX_DIV] & ~((world_store) SINGLE_CELL_MASK << j)) |
+            (world_store) (alive ? SINGLE_CELL_MASK : 0) << j;
+        world_invalidate(w);
+    }
+    if (ops->set_cell != NULL && !edited && w->state == CALC && ops->set_cell(w, x, y, alive)) {
+        w->edited = 0;
+    }
 }
 
 void iter_world(world *w, iter_world_func_type itf) {
@@ -62,6 +382,7 @@ void iter_world(world *w, iter_world_func_type itf) {
     world_store cell_val, cell_mask;
     world_cell_pos wcp;
     wcp.w = w;
+    world_invalidate(w);
 
     for (size_t i = 0; i < w->data_size; i++) {
         for (int j = 0; j < CELLS_PER_ELEM; j++) {
@@ -88,28 +409,79 @@ void iter_world(world *w, iter_world_func_type itf) {
 
 static void _print_world_it(world_cell_pos *wcp) {
     size_t index = wcp->w->state ? *(wcp->cell_val) : (*(wcp->cell_val) & 2) | (*(wcp->cell_val) >> 1);
-    putchar(DISPLAY_CHARS[index]);
+    unsigned int age = index ? 0 : generations_age(wcp->w, wcp->y * (size_t) wcp->w->xlim + wcp->x);
+    if (age) {
+        putchar(DYING_CHARS[age - 1 < sizeof(DYING_CHARS) - 2 ? age - 1 : sizeof(DYING_CHARS) - 2]);
+    } else {
+        putchar(DISPLAY_CHARS[index]);
+    }
     if (wcp->x == wcp->w->xlim-1) {
         putchar('\n');
     }
 }
 
 void print_world(world *w) {
-    printf("World %ux%u, state: %s, gen %u:\n",
+    char rule[RULE_STRING_LEN];
+    rule_string(&w->rule, rule);
+    printf("World %ux%u%s %s, state: %s, gen %u:\n",
             w->xlim,
             w->ylim,
+            w->topology == TORUS ? " torus" : "",
+            rule,
             w->state ? "SHIFT" : "CALC",
             w->generation);
     iter_world(w, _print_world_it);
 }
 
+/*
+ * Where world memory ended up: bytes per node, and the share of each
+ * band's world data that isn't on the node its thread is pinned to
+ */
+void print_numa_report(world *w) {
+    size_t node_bytes[NUMA_MAX_NODES] = { 0 };
+    size_t band_bytes[NUMA_MAX_NODES];
+    size_t total = 0, remote = 0, missing;
+    int nodes = numa_count_nodes();
+
+    printf("NUMA: %s, %d node%s\n", w->numa ? "on" : "off", nodes, nodes == 1 ? "" : "s");
+
+    for (unsigned int band = 0; band < w->bands; ++band) {
+        size_t start = _band_store(w, band),
+               end = _band_store(w, band + 1);
+        int node = _band_node(w, band);
+
+        memset(band_bytes, 0, sizeof(band_bytes));
+        missing = numa_page_usage(w->data + start, (end - start) * sizeof(world_store), band_bytes);
+        for (int n = 0; n < nodes; ++n) {
+            total += band_bytes[n];
+            if (n != node) {
+                remote += band_bytes[n];
+            }
+        }
+        total += missing;
+    }
+
+    numa_page_usage(w->data, _data_bytes(w), node_bytes);
+    numa_page_usage(w->temp_calc, _data_bytes(w), node_bytes);
+    numa_page_usage(w->board, _board_bytes(w), node_bytes);
+    for (int n = 0; n < nodes; ++n) {
+        printf("  Node %d: %lu bytes\n", n, (unsigned long) node_bytes[n]);
+    }
+    printf("  Remote band data: %.1f%%\n", total ? 100.0 * remote / total : 0.0);
+}
+
 /*
  * Byte stream into world
- *   - Check magic number
+ *   - Check magic number (version 1 or 2)
  *   - Read xlim, ylim
  *   - Read state
  *   - Read generation
+ *   - Version 2: read flags, then birth and survive if there is a rule,
+ *     then born and kept by count if it is isotropic, or the range
+ *     parameters if it is a range rule, then the number of states of a
+ *     Generations rule
  *   - Read all world data
+ *   - Generations rules: read each dying plane, laid out like world data
  */
 world *deserialize_world(char *data, size_t len) {
     if (len < MINSIZE) {
@@ -120,7 +492,7 @@ world *deserialize_world(char *data, size_t len) {
     size_t offset = 0;
 
     uint16_t magic = _dser_uint16(data, offset);
-    if (magic != MAGIC) {
+    if (magic != MAGIC && magic != MAGIC_V2) {
         printf("%04x\n", magic);
         puts("INVALID FILE!");
         return NULL;
@@ -128,7 +500,8 @@ world *deserialize_world(char *data, size_t len) {
     offset += sizeof(magic);
 
     uint32_t xlim, ylim, generation;
-    uint16_t state;
+    uint16_t state, flags = 0, birth = CONWAY_BIRTH, survive = CONWAY_SURVIVE;
+    uint16_t born[9], kept[9], range[6], states = 2;
 
     xlim = _dser_uint32(data, offset);
     offset += sizeof(uint32_t);
@@ -141,15 +514,94 @@ world *deserialize_world(char *data, size_t len) {
     state = _dser_uint16(data, offset);
     offset += sizeof(uint16_t);
 
-    world *w = init_world(xlim, ylim);
+    if (magic == MAGIC_V2) {
+        if (len < MINSIZE_V2) {
+            puts("INVALID FILE SIZE!");
+            return NULL;
+        }
+        flags = _dser_uint16(data, offset);
+        offset += sizeof(uint16_t);
+    }
+
+    if (flags & WORLD_FLAG_RULE) {
+        if (len < offset + 2 * sizeof(uint16_t)) {
+            puts("INVALID FILE SIZE!");
+            return NULL;
+        }
+        birth = _dser_uint16(data, offset);
+        offset += sizeof(uint16_t);
+        survive = _dser_uint16(data, offset);
+        offset += sizeof(uint16_t);
+    }
+
+    if (flags & WORLD_FLAG_ISOTROPIC) {
+        if (!(flags & WORLD_FLAG_RULE) || len < offset + 18 * sizeof(uint16_t)) {
+            puts("INVALID FILE!");
+            return NULL;
+        }
+        for (int n = 0; n <= 8; ++n) {
+            born[n] = _dser_uint16(data, offset);
+            offset += sizeof(uint16_t);
+        }
+        for (int n = 0; n <= 8; ++n) {
+            kept[n] = _dser_uint16(data, offset);
+            offset += sizeof(uint16_t);
+        }
+    }
+
+    if (flags & WORLD_FLAG_RANGE) {
+        if (!(flags & WORLD_FLAG_RULE) || len < offset + 6 * sizeof(uint16_t)) {
+            puts("INVALID FILE!");
+            return NULL;
+        }
+        for (int i = 0; i < 6; ++i) {
+            range[i] = _dser_uint16(data, offset);
+            offset += sizeof(uint16_t);
+        }
+    }
+
+    if (flags & WORLD_FLAG_STATES) {
+        if (len < offset + sizeof(uint16_t)) {
+            puts("INVALID FILE SIZE!");
+            return NULL;
+        }
+        states = _dser_uint16(data, offset);
+        offset += sizeof(uint16_t);
+        if (states < 2 || states > RULE_STATES_MAX) {
+            puts("INVALID FILE!");
+            return NULL;
+        }
+    }
+
+    world *w = init_world(xlim, ylim, flags & WORLD_FLAG_TORUS ? TORUS : BOUNDED);
+    if (w == NULL) {
+        return NULL;
+    }
+    if (flags & WORLD_FLAG_RANGE) {
+        w->rule = make_range_rule(range[0], range[1], range[2], range[3], range[4], range[5]);
+    } else if (flags & WORLD_FLAG_ISOTROPIC) {
+        w->rule = make_isotropic_rule(born, kept);
+    } else {
+        w->rule = make_rule(birth, survive);
+    }
+    w->rule.states = states;
     w->generation = generation;
     w->state = state;
+    _alloc_decay(w);
 
-    for (int i = 0; offset < len; ++i) {
+    for (size_t i = 0; i < w->data_size && offset + sizeof(world_store) <= len; ++i) {
         w->data[i] = _dser_uint32(data, offset);
         offset += sizeof(world_store);
     }
 
+    for (size_t p = 0; p < w->decay_planes; ++p) {
+        world_store *plane = w->decay + p * (w->data_size + 1);
+        for (size_t i = 0; i < w->data_size && offset + sizeof(world_store) <= len; ++i) {
+            plane[i] = _dser_uint32(data, offset);
+            offset += sizeof(world_store);
+        }
+    }
+
     return w;
 }
 
@@ -168,25 +620,43 @@ world *deserialize_world_b64(char *enc_data, size_t enc_len) {
 
 /*
  * World into byte stream
- *   - begin stream magic number
+ *   - begin stream magic number, version 2 if there are flags
  *   - xlim, ylim
  *   - generation
  *   - state
+ *   - version 2: flags, then birth and survive if not Conway's Life,
+ *     then born and kept by count if not totalistic, or the range
+ *     parameters of a range rule, then the number of states of a
+ *     Generations rule
  *   - world_data
+ *   - Generations rules: each dying plane, laid out like world data
  */
 char *serialize_world(world *w, size_t *ser_len) {
+    uint16_t flags = (w->topology == TORUS ? WORLD_FLAG_TORUS : 0) |
+        (rule_is_conway(&w->rule) ? 0 : WORLD_FLAG_RULE) |
+        (w->rule.totalistic ? 0 : WORLD_FLAG_ISOTROPIC) |
+        (w->rule.range > 1 ? WORLD_FLAG_RANGE : 0) |
+        (w->rule.states > 2 ? WORLD_FLAG_STATES : 0);
+    size_t planes = w->decay != NULL ? w->decay_planes : 0;
     size_t out_size =
         sizeof(MAGIC) +
         sizeof(uint32_t) +
         sizeof(uint32_t) +
         sizeof(uint32_t) +
         sizeof(uint16_t) +
-        (w->data_size * sizeof(world_store));
+        (flags ? sizeof(uint16_t) : 0) +
+        (flags & WORLD_FLAG_RULE ? 2 * sizeof(uint16_t) : 0) +
+        (flags & WORLD_FLAG_ISOTROPIC ? 18 * sizeof(uint16_t) : 0) +
+        (flags & WORLD_FLAG_RANGE ? 6 * sizeof(uint16_t) : 0) +
+        (flags & WORLD_FLAG_STATES ? sizeof(uint16_t) : 0) +
+        (w->data_size * sizeof(world_store)) +
+        (w->data_size * planes * sizeof(world_store));
 
     size_t offset = 0;
     char *s_w = calloc(out_size, sizeof(char));
 
-    _ser_uint16(s_w, offset, MAGIC);
+    // Plain worlds stay readable by older versions
+    _ser_uint16(s_w, offset, flags ? MAGIC_V2 : MAGIC);
     offset += sizeof(MAGIC);
 
     _ser_uint32(s_w, offset, w->xlim);
@@ -201,11 +671,56 @@ char *serialize_world(world *w, size_t *ser_len) {
     _ser_uint16(s_w, offset, (uint16_t) w->state);
     offset += sizeof(uint16_t);
 
+    if (flags) {
+        _ser_uint16(s_w, offset, flags);
+        offset += sizeof(uint16_t);
+    }
+
+    if (flags & WORLD_FLAG_RULE) {
+        _ser_uint16(s_w, offset, w->rule.birth);
+        offset += sizeof(uint16_t);
+        _ser_uint16(s_w, offset, w->rule.survive);
+        offset += sizeof(uint16_t);
+    }
+
+    if (flags & WORLD_FLAG_ISOTROPIC) {
+        for (int n = 0; n <= 8; ++n) {
+            _ser_uint16(s_w, offset, w->rule.born[n]);
+            offset += sizeof(uint16_t);
+        }
+        for (int n = 0; n <= 8; ++n) {
+            _ser_uint16(s_w, offset, w->rule.kept[n]);
+            offset += sizeof(uint16_t);
+        }
+    }
+
+    if (flags & WORLD_FLAG_RANGE) {
+        uint16_t range[6] = { w->rule.range, w->rule.middle, w->rule.birth_min,
+            w->rule.birth_max, w->rule.survive_min, w->rule.survive_max };
+        for (int i = 0; i < 6; ++i) {
+            _ser_uint16(s_w, offset, range[i]);
+            offset += sizeof(uint16_t);
+        }
+    }
+
+    if (flags & WORLD_FLAG_STATES) {
+        _ser_uint16(s_w, offset, w->rule.states);
+        offset += sizeof(uint16_t);
+    }
+
     for (size_t i = 0; i < w->data_size; ++i) {
         _ser_uint32(s_w, offset, w->data[i]);
         offset += sizeof(uint32_t);
     }
 
+    for (size_t p = 0; p < planes; ++p) {
+        const world_store *plane = w->decay + p * (w->data_size + 1);
+        for (size_t i = 0; i < w->data_size; ++i) {
+            _ser_uint32(s_w, offset, plane[i]);
+            offset += sizeof(uint32_t);
+        }
+    }
+
     *ser_len = out_size;
 
     return s_w;
@@ -261,8 +776,11 @@ world *read_from_file(const char *filename, world_file_type enc) {
     return w;
 }
 
+/*
+ * Save w to filename, replacing the file whole (see write_file). Returns
+ * the bytes written, 0 if it couldn't be.
+ */
 size_t write_to_file(const char *filename, world *w, world_file_type enc) {
-    FILE *fp;
     char *world_ser;
     size_t world_ser_size, write_size = 0;
 
@@ -279,114 +797,495 @@ size_t write_to_file(const char *filename, world *w, world_file_type enc) {
         world_ser_size = size;
     }
 
-    fp = fopen(filename, "wb");
-    if (fp != NULL) {
-        write_size = fwrite(world_ser, sizeof(char), world_ser_size, fp);
-        fclose(fp);
+    if (write_file(filename, world_ser, world_ser_size)) {
+        write_size = world_ser_size;
     }
 
     free(world_ser);
     return write_size;
 }
 
-static void _shift_next_state(world *w) {
-    for (size_t i = 0; i < w->data_size; i++) {
-        w->data[i] = (w->data[i] << 1) & CURR_CELL_MASK;
+static void _edges_band(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    (void) bands;
+
+    bitwise_pack_edges(w, _band_board(w, band), _band_row(w, band), _band_row(w, band + 1));
+}
+
+/*
+ * Make the next states of cells c0 to c1 current (see _shift_from), and
+ * add the change to the world's hash and the cells born and died to the
+ * band's
+ */
+static inline void _shift_cells(world *w, size_t c0, size_t c1, unsigned int band) {
+    shift_sums sums = { 0, 0, 0 };
+
+    get_kernel()->shift(w->data, c0 >> IDX_DIV, ((c1 - 1) >> IDX_DIV) + 1, &sums);
+    w->band_hash[band] ^= sums.hash;
+    w->band_stats[band].births += sums.births;
+    w->band_stats[band].deaths += sums.deaths;
+}
+
+/*
+ * Whole hash of a band's stores, and of its dying planes, which are
+ * hashed as words past the end of the states
+ */
+static void _hash_band(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    size_t start = _band_store(w, band),
+           end = _band_store(w, band + 1);
+    uint64_t hash = 0;
+    (void) bands;
+
+    for (size_t i = start; i < end; ++i) {
+        hash ^= cycle_hash(i, w->data[i] & CURR_CELL_MASK);
+    }
+    for (unsigned int p = 0; w->decay != NULL && p < w->decay_planes; ++p) {
+        const world_store *plane = w->decay + p * (w->data_size + 1);
+        for (size_t i = start; i < end; ++i) {
+            hash ^= cycle_hash(i + (p + 1) * (w->data_size + 1), plane[i]);
+        }
+    }
+    w->band_hash[band] = hash;
+}
+
+/*
+ * Add up the bands' hashes, the whole of them or what changed in the
+ * last step, and record the generation
+ */
+static void _record_generation(world *w, int whole) {
+    if (whole) {
+        w->hash = 0;
+    }
+    for (unsigned int band = 0; band < w->bands; ++band) {
+        w->hash ^= w->band_hash[band];
+    }
+    w->hash_valid = 1;
+    // A window repeating doesn't mean the pattern does
+    if (!world_is_window(w)) {
+        cycle_record(w);
+    }
+}
+
+static void _count_band(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    uint32_t y1 = _band_row(w, band + 1);
+    (void) bands;
+
+    w->band_stats[band].population = 0;
+    for (uint32_t ty = _band_row(w, band); ty < y1; ty += TILE_ROWS) {
+        w->band_stats[band].population +=
+            stats_count_tiles(w, ty, ty + TILE_ROWS < y1 ? ty + TILE_ROWS : y1);
+    }
+}
+
+/*
+ * Live cells of the whole world, counted anew, marking the tiles that
+ * have any
+ */
+static uint64_t _count_live(world *w) {
+    uint64_t population = 0;
+
+    _run_bands(w, _count_band);
+    for (unsigned int band = 0; band < w->bands; ++band) {
+        population += w->band_stats[band].population;
     }
+    return population;
+}
+
+/*
+ * Count the live cells of the whole world, after it was changed
+ * directly, and record the statistics of its generation with no births
+ * or deaths. Stepping does this itself when it has to.
+ */
+void world_census(world *w) {
+    stats_record(w, _count_live(w), 0, 0);
+}
+
+/*
+ * Hash and count a world that was changed directly before stepping it,
+ * so the generation it starts from is recorded too
+ */
+static void _record_start(world *w) {
+    if (!w->hash_valid) {
+        _run_bands(w, _hash_band);
+        _record_generation(w, 1);
+    }
+    if (!w->stats_valid) {
+        world_census(w);
+    }
+}
+
+static void _shift_band(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    uint32_t y0 = _band_row(w, band),
+             y1 = _band_row(w, band + 1);
+    (void) bands;
+
+    w->band_hash[band] = 0;
+    w->band_stats[band].births = 0;
+    w->band_stats[band].deaths = 0;
+
+    // Dying cells age before the next states they were born from go
+    if (w->rule.states > 2 && w->decay != NULL) {
+        generations_decay(w, _band_store(w, band), _band_store(w, band + 1));
+    }
+
+    if (!w->tiles_valid) {
+        size_t start = _band_store(w, band),
+               end = _band_store(w, band + 1);
+        if (start < end) {
+            _shift_cells(w, start << IDX_DIV, end << IDX_DIV, band);
+        }
+        // Cells could have been born in any tile
+        memset(w->tile_live + (size_t) (y0 / TILE_ROWS) * w->tile_cols, 1,
+                (size_t) ((y1 - y0 + TILE_ROWS - 1) / TILE_ROWS) * w->tile_cols);
+    }
+
+    // Only the tiles that were calculated can have changed
+    for (uint32_t ty = y0; w->tiles_valid && ty < y1; ty += TILE_ROWS) {
+        uint32_t ty1 = ty + TILE_ROWS < y1 ? ty + TILE_ROWS : y1;
+        size_t t = (size_t) (ty / TILE_ROWS) * w->tile_cols;
+        const uint8_t *active = w->tile_active + t;
+
+        // Cells can only have been born in tiles that changed
+        for (uint32_t c = 0; c < w->tile_cols; ++c) {
+            w->tile_live[t + c] |= w->tile_changed[t + c];
+        }
+
+        for (uint32_t p = 0, q; p < w->tile_cols; p = q) {
+            if (!active[p]) {
+                q = p + 1;
+                continue;
+            }
+            for (q = p; q < w->tile_cols && active[q]; ++q);
+
+            size_t x0 = (size_t) p * TILE_COLS,
+                   x1 = q < w->tile_cols ? (size_t) q * TILE_COLS : w->xlim;
+            if (x0 == 0 && x1 == w->xlim) {
+                _shift_cells(w, (size_t) ty * w->xlim, (size_t) ty1 * w->xlim, band);
+                continue;
+            }
+            for (uint32_t y = ty; y < ty1; ++y) {
+                _shift_cells(w, (size_t) y * w->xlim + x0, (size_t) y * w->xlim + x1, band);
+            }
+        }
+    }
+
+    // Dying planes change everywhere each step, so are hashed whole
+    if (!w->hash_valid || w->decay != NULL) {
+        _hash_band(w, band, bands);
+    }
+
+    if (get_engine(w->engine)->shift_band != NULL) {
+        get_engine(w->engine)->shift_band(w, band, bands);
+    }
+}
+
+static void _shift_next_state(world *w) {
+    int whole = !w->hash_valid || w->decay != NULL;
+    uint64_t births = 0, deaths = 0;
+
+    _run_bands(w, _shift_band);
 
     w->generation++;
     w->state = CALC;
+    w->edges_valid = get_engine(w->engine)->shift_band != NULL;
+    _record_generation(w, whole);
+
+    for (unsigned int band = 0; band < w->bands; ++band) {
+        births += w->band_stats[band].births;
+        deaths += w->band_stats[band].deaths;
+    }
+    if (w->stats_valid) {
+        stats_record(w, w->stats.population + births - deaths, births, deaths);
+    } else {
+        stats_record(w, _count_live(w), births, deaths);
+    }
 }
 
-static void _calc_next_state(world *w) {
-    size_t x, c, cc, i, j, ci, cj;
-    world_store cell_val, cell_mask, cell_count_val;
-    unsigned char three_cells, row_cell_count;
-
-    x = 0;
-    i = 0;
-    // This contains the current cell and the two cells surrounding it
-    // We start off with the first cell
-    three_cells = w->data[i] & SINGLE_CELL_MASK;
-
-    for (cc = 0, c = 1; cc < w->cell_count; ++cc, ++c) {
-        // The next cell's index and offset (for reading)
-        i = c >> IDX_DIV;
-        j = c & OFFSET_MASK;
-        // Current cell's index and offset (for writing)
-        ci = cc >> IDX_DIV;
-        cj = cc & OFFSET_MASK;
-
-        // Shift the next cell into our cell buffer
-        three_cells = (three_cells << BITS_PER_CELL) |
-            ((w->data[i] >> j*BITS_PER_CELL) & SINGLE_CELL_MASK);
-        // We only care about the current 3 cells
-        cell_count_val = three_cells & MULTI_CELL_MASK;
-
-        // Don't use the left cell if the row has started
-        // Don't use the right cell if the row has ended
-        if (x == 0) {
-            cell_count_val &= START_ROW_MASK;
-        } else if (x == w->xlim-1) {
-            cell_count_val &= END_ROW_MASK;
-        }
+/*
+ * Both state bits of the cell at index c, and the three-cell count
+ * stored for it in temp_calc
+ */
+static inline world_store _cell_at(const world_store *data, size_t c) {
+    return (data[c >> IDX_DIV] >> (c & OFFSET_MASK) * BITS_PER_CELL) & SINGLE_CELL_MASK;
+}
+
+static inline void _set_count(world *w, size_t c, unsigned char three_cells) {
+    size_t ci = c >> IDX_DIV,
+           cj = (c & OFFSET_MASK) * BITS_PER_CELL;
+    world_store cell_mask = (world_store) SINGLE_CELL_MASK << cj;
 
-        // Get the bit count of the three cells
-        row_cell_count = BIT_COUNTS[cell_count_val];
-        cell_mask = (world_store) SINGLE_CELL_MASK << cj*BITS_PER_CELL;
+    w->temp_calc[ci] = (w->temp_calc[ci] & ~cell_mask) |
+        ((world_store) BIT_COUNTS[three_cells & MULTI_CELL_MASK] << cj);
+}
 
-        // Set the surrounding cell count to our scratch area
-        w->temp_calc[ci] = (w->temp_calc[ci] & ~cell_mask) |
-            ((world_store) row_cell_count << cj*BITS_PER_CELL);
+/*
+ * Current state of the cell at (x, y), which can be one past any edge:
+ * dead, or the cell at the other end on a torus
+ */
+static inline unsigned int _curr_at(world *w, int64_t x, int64_t y) {
+    if (w->topology == TORUS) {
+        x = (x + w->xlim) % w->xlim;
+        y = (y + w->ylim) % w->ylim;
+    } else if (x < 0 || x >= w->xlim || y < 0 || y >= w->ylim) {
+        return 0;
+    }
+    return _cell_at(w->data, (size_t) y * w->xlim + (size_t) x) >> 1;
+}
 
-        ++x;
-        if (x >= w->xlim) {
-            x = 0;
+/*
+ * Cellwise step for rules that aren't totalistic, which need the whole
+ * 3x3 neighbourhood of each cell rather than a count
+ */
+static void _calc_next_state_isotropic(world *w) {
+    for (uint32_t y = 0; y < w->ylim; ++y) {
+        for (uint32_t x = 0; x < w->xlim; ++x) {
+            size_t c = (size_t) y * w->xlim + x,
+                   ci = c >> IDX_DIV,
+                   cj = (c & OFFSET_MASK) * BITS_PER_CELL;
+            unsigned int idx = 0;
+
+            for (int n = 0; n < 9; ++n) {
+                idx |= _curr_at(w, (int64_t) x + n % 3 - 1, (int64_t) y + n / 3 - 1) << n;
+            }
+            w->data[ci] = (w->data[ci] & ~((world_store) NEXT_STATE_MASK << cj)) |
+                (world_store) rule_lookup(&w->rule, idx) << cj;
         }
     }
 
-    char sum9;
-    for (c = 0; c < w->cell_count; ++c) {
-        sum9 = 0;
+    w->state = SHIFT;
+    w->tiles_valid = 0;
+    w->active_tiles = (size_t) w->tile_cols * w->tile_rows;
+}
 
-        // Previous row three-count
-        if (c >= w->xlim) {
-            cc = c - w->xlim;
-            ci = cc >> IDX_DIV;
-            cj = (cc & OFFSET_MASK) * BITS_PER_CELL;
-            sum9 += (w->temp_calc[ci] >> cj) & SINGLE_CELL_MASK;
+static void _calc_next_state(world *w) {
+    size_t c, ci, cj, row, up, down;
+    world_store cell_val, cell_mask, up_mask, down_mask;
+    unsigned char three_cells;
+    int torus = w->topology == TORUS;
+
+    // Three-cell count of every cell into temp_calc, a row at a time.
+    // Each row has a ghost cell at either end, dead or the cell at the
+    // other end on a torus, so the loop needs no edge checks.
+    for (row = 0; row < w->cell_count; row += w->xlim) {
+        // This contains the current cell and the two cells surrounding it
+        three_cells = torus ? _cell_at(w->data, row + w->xlim - 1) : 0;
+        three_cells = (three_cells << BITS_PER_CELL) | _cell_at(w->data, row);
+
+        for (c = row; c + 1 < row + w->xlim; ++c) {
+            // Shift the next cell into our cell buffer
+            three_cells = (three_cells << BITS_PER_CELL) | _cell_at(w->data, c + 1);
+            _set_count(w, c, three_cells);
         }
+        three_cells = (three_cells << BITS_PER_CELL) | (torus ? _cell_at(w->data, row) : 0);
+        _set_count(w, c, three_cells);
+    }
 
-        // Next row three-count
-        cc = c + w->xlim;
-        if (cc < w->cell_count) {
-            ci = cc >> IDX_DIV;
-            cj = (cc & OFFSET_MASK) * BITS_PER_CELL;
-            sum9 += (w->temp_calc[ci] >> cj) & SINGLE_CELL_MASK;
+    unsigned char sum9;
+    for (row = 0; row < w->cell_count; row += w->xlim) {
+        // Rows above and below, with ghost rows past the top and bottom:
+        // dead, or the opposite row on a torus
+        up = row >= w->xlim ? row - w->xlim : (torus ? w->cell_count - w->xlim : row);
+        down = row + w->xlim < w->cell_count ? row + w->xlim : (torus ? 0 : row);
+        up_mask = row >= w->xlim || torus ? SINGLE_CELL_MASK : 0;
+        down_mask = row + w->xlim < w->cell_count || torus ? SINGLE_CELL_MASK : 0;
+
+        for (size_t x = 0; x < w->xlim; ++x) {
+            c = row + x;
+            ci = c >> IDX_DIV;
+            cj = (c & OFFSET_MASK) * BITS_PER_CELL;
+
+            // Previous, current and next row three-counts
+            sum9 = (_cell_at(w->temp_calc, up + x) & up_mask) +
+                _cell_at(w->temp_calc, c) +
+                (_cell_at(w->temp_calc, down + x) & down_mask);
+
+            cell_mask = (world_store) NEXT_STATE_MASK << cj;
+            // Set cell state based on the current cell and all surrounding
+            // by the world's rule
+            cell_val = (world_store) rule_next(&w->rule, (w->data[ci] >> (cj + 1)) & 1, sum9) << cj;
+            w->data[ci] = (w->data[ci] & (~cell_mask)) | cell_val;
         }
+    }
+
+    w->state = SHIFT;
+    w->tiles_valid = 0;
+    w->active_tiles = (size_t) w->tile_cols * w->tile_rows;
+}
+
+static void _unpack_band_range(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    (void) bands;
+
+    ltl_unpack_rows(w, w->range_cells, _band_row(w, band), _band_row(w, band + 1));
+}
+
+static void _calc_band_range(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    (void) bands;
+
+    ltl_calc_rows(w, w->range_cells, _band_row(w, band), _band_row(w, band + 1));
+}
+
+/*
+ * Range rules take the same path whatever the engine. Every band reads
+ * well past its own rows, so all of them are unpacked before any next
+ * state is written.
+ */
+static void _calc_next_state_range(world *w) {
+    if (w->range_cells == NULL) {
+        w->range_cells = pages_alloc(w->data_size * CELLS_PER_ELEM);
+        if (w->range_cells == NULL) {
+            exit(EXIT_FAILURE);
+        }
+    }
+    _run_bands(w, _unpack_band_range);
+    _run_bands(w, _calc_band_range);
+
+    w->state = SHIFT;
+    w->tiles_valid = 0;
+    w->active_tiles = (size_t) w->tile_cols * w->tile_rows;
+}
+
+static void _mask_band(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    (void) bands;
+
+    generations_mask(w, _band_store(w, band), _band_store(w, band + 1));
+}
+
+/*
+ * Generations rules: dying cells can't be born, whatever the engine
+ * calculated. Their ages change every step with nothing around them
+ * changing, so every tile is shifted and calculated next time.
+ */
+static void _mask_dying(world *w) {
+    _alloc_decay(w);
+    _run_bands(w, _mask_band);
+    w->tiles_valid = 0;
+}
+
+static void _calc_band_bitwise(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    const board_word *halo_top = NULL, *halo_bottom = NULL;
+
+    // On a torus the first and last bands are neighbours too
+    if (band > 0 || (w->topology == TORUS && bands > 1)) {
+        halo_top = bitwise_edge_row(w, _band_board(w, (band + bands - 1) % bands), 1);
+    }
+    if (band + 1 < bands || (w->topology == TORUS && bands > 1)) {
+        halo_bottom = bitwise_edge_row(w, _band_board(w, (band + 1) % bands), 0);
+    }
+
+    bitwise_calc_rows(w, _band_board(w, band),
+            _band_row(w, band), _band_row(w, band + 1), halo_top, halo_bottom);
+}
+
+/*
+ * Tile row or column i of n, wrapped on a torus, -1 if there is none
+ */
+static inline int64_t _tile_index(world *w, int64_t i, uint32_t n) {
+    if (i >= 0 && i < n) {
+        return i;
+    }
+    return w->topology == TORUS ? (i + n) % n : -1;
+}
+
+/*
+ * A tile is calculated if it or any of its neighbours changed last time.
+ * If the world was changed outside of stepping every tile is.
+ */
+static void _update_active_tiles(world *w) {
+    size_t tiles = (size_t) w->tile_cols * w->tile_rows;
 
-        // Current row three-count
-        ci = c >> IDX_DIV;
-        cj = (c & OFFSET_MASK) * BITS_PER_CELL;
-        sum9 += (w->temp_calc[ci] >> cj) & SINGLE_CELL_MASK;
-
-        cell_mask = (world_store) NEXT_STATE_MASK << cj;
-        // Set cell state based on the current cell and all surrounding
-        // Conway's Life rules
-        switch(sum9) {
-            case 3: cell_val = (world_store) 1 << cj; break;
-            case 4: cell_val = (w->data[ci] >> 1) & cell_mask; break;
-            default: cell_val = 0; break;
+    if (!w->tiles_valid) {
+        memset(w->tile_active, 1, tiles);
+        w->active_tiles = tiles;
+        return;
+    }
+
+    w->active_tiles = 0;
+    for (uint32_t r = 0; r < w->tile_rows; ++r) {
+        for (uint32_t c = 0; c < w->tile_cols; ++c) {
+            uint8_t a = 0;
+            for (int dy = -1; dy <= 1; ++dy) {
+                int64_t y = _tile_index(w, (int64_t) r + dy, w->tile_rows);
+                for (int dx = -1; dx <= 1 && y >= 0; ++dx) {
+                    int64_t x = _tile_index(w, (int64_t) c + dx, w->tile_cols);
+                    a |= x >= 0 && w->tile_changed[y * w->tile_cols + x];
+                }
+            }
+            w->tile_active[(size_t) r * w->tile_cols + c] = a;
+            w->active_tiles += a;
         }
-        w->data[ci] = (w->data[ci] & (~cell_mask)) | cell_val;
     }
+}
 
+static void _calc_next_state_bitwise(world *w) {
+    if (w->pool != NULL && !w->edges_valid) {
+        // The world was changed outside of stepping
+        _run_bands(w, _edges_band);
+        w->edges_valid = 1;
+    }
+    _update_active_tiles(w);
+    _run_bands(w, _calc_band_bitwise);
     w->state = SHIFT;
+    w->tiles_valid = 1;
+}
+
+/*
+ * The engine to step a world with: its own, or the bitwise engine if
+ * its own can't, after which an engine that keeps its own pattern takes
+ * the world in anew
+ */
+static const world_engine_ops *_stepping_engine(world *w) {
+    const world_engine_ops *ops = get_engine(w->engine);
+
+    if (ops->refuses != NULL && ops->refuses(w) != NULL) {
+        w->edited = 1;
+        return &BITWISE_ENGINE;
+    }
+    return ops;
+}
+
+/*
+ * An engine that keeps its own pattern has stepped it: the world's next
+ * states are the window of it, exported through temp_calc
+ */
+static void _export_next_state(world *w, const world_engine_ops *ops) {
+    memset(w->temp_calc, 0, _data_bytes(w));
+    ops->export_region(w, 0, 0, w->xlim, w->ylim, w->temp_calc);
+    for (size_t i = 0; i < w->data_size; ++i) {
+        w->data[i] = (w->data[i] & CURR_CELL_MASK) | (w->temp_calc[i] & NEXT_CELL_MASK);
+    }
+
+    w->edited = 0;
+    w->state = SHIFT;
+    w->tiles_valid = 0;
+    w->active_tiles = (size_t) w->tile_cols * w->tile_rows;
 }
 
 void world_half_step(world *w) {
+    const world_engine_ops *ops;
+
     switch (w->state) {
-        case CALC:  _calc_next_state(w); break;
+        case CALC:
+            _record_start(w);
+            ops = _stepping_engine(w);
+            if (w->rule.range > 1) {
+                _calc_next_state_range(w);
+            } else if (ops->export_region != NULL) {
+                ops->calc(w);
+                _export_next_state(w, ops);
+            } else {
+                ops->calc(w);
+            }
+            if (w->rule.states > 2) {
+                _mask_dying(w);
+            }
+            break;
         case SHIFT: _shift_next_state(w); break;
     }
 }
@@ -397,3 +1296,201 @@ void world_step(world *w) {
     }
     world_half_step(w);
 }
+
+static void _save_halos_band(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    (void) bands;
+
+    bitwise_save_halos(w, _band_block(w, band), _band_row(w, band), _band_row(w, band + 1),
+            w->block_depth);
+}
+
+static void _step_block_band(void *arg, unsigned int band, unsigned int bands) {
+    world *w = arg;
+    const board_word *halo_top = NULL, *halo_bottom = NULL;
+
+    // On a torus every band has neighbours, if only itself
+    if (band > 0 || w->topology == TORUS) {
+        halo_top = bitwise_halo_rows(w, _band_block(w, (band + bands - 1) % bands), 1);
+    }
+    if (band + 1 < bands || w->topology == TORUS) {
+        halo_bottom = bitwise_halo_rows(w, _band_block(w, (band + 1) % bands), 0);
+    }
+
+    bitwise_step_block(w, _band_block(w, band), _band_row(w, band), _band_row(w, band + 1),
+            w->block_depth, halo_top, halo_bottom);
+}
+
+/*
+ * Bitwise engine: up to BLOCK_DEPTH_MAX generations at a time with
+ * temporal blocking (see bitwise.c), which reads and writes world data
+ * once per pass rather than twice per generation. It calculates every
+ * cell though, so for a mostly settled world tile skipping in world_step
+ * can be faster.
+ */
+static int _step_n_bitwise(world *w, unsigned int n) {
+    uint32_t rows = w->ylim;
+
+    for (unsigned int band = 0; band < w->bands; ++band) {
+        uint32_t r = _band_row(w, band + 1) - _band_row(w, band);
+        rows = r < rows ? r : rows;
+    }
+    if (rows < 2) {
+        return 0;
+    }
+
+    if (w->block == NULL) {
+        w->block = pages_alloc(_block_bytes(w));
+        if (w->block == NULL) {
+            return 0;
+        }
+    }
+    _record_start(w);
+    while (n > 1) {
+        // Once the outcome is known, only what is left of a period is stepped
+        n -= world_fast_forward(w, w->generation + n);
+        if (n <= 1) {
+            continue;
+        }
+        // A period found between blocks may be a multiple of the real one
+        if (w->cycle.period == 0 && w->history->candidate != 0) {
+            world_step(w);
+            --n;
+            continue;
+        }
+
+        w->block_depth = n < BLOCK_DEPTH_MAX ? n : BLOCK_DEPTH_MAX;
+        w->block_depth = w->block_depth < rows ? w->block_depth : rows;
+        _run_bands(w, _save_halos_band);
+        _run_bands(w, _step_block_band);
+        w->generation += w->block_depth;
+        n -= w->block_depth;
+
+        w->edges_valid = 0;
+        w->tiles_valid = 0;
+        w->active_tiles = (size_t) w->tile_cols * w->tile_rows;
+        _run_bands(w, _hash_band);
+        _record_generation(w, 1);
+        stats_record_net(w, _count_live(w));
+    }
+    if (n == 1) {
+        world_step(w);
+    }
+    return 1;
+}
+
+/*
+ * Advance the world by n generations, the same as n calls to world_step.
+ * Engines that can step many generations at once do, for rules with a
+ * range of 1 and 2 states. Others are stepped one generation at a time.
+ */
+void world_step_n(world *w, unsigned int n) {
+    const world_engine_ops *ops;
+
+    // Finish a step that was left half done
+    if (n > 0 && w->state == SHIFT) {
+        world_half_step(w);
+        --n;
+    }
+    ops = _stepping_engine(w);
+
+    if (w->rule.range <= 1 && w->rule.states <= 2 && ops->step_n != NULL && ops->step_n(w, n)) {
+        return;
+    }
+    while (n > 0) {
+        n -= world_fast_forward(w, w->generation + n);
+        if (n > 0) {
+            world_step(w);
+            --n;
+        }
+    }
+}
+
+static void _calc_next_state_cell(world *w) {
+    if (w->rule.totalistic) {
+        _calc_next_state(w);
+    } else {
+        _calc_next_state_isotropic(w);
+    }
+}
+
+static void _report_bitwise(world *w, FILE *out) {
+    (void) w;
+    fprintf(out, "Kernel: %s\n", get_kernel()->name);
+}
+
+/*
+ * Neighbouring bands read a band's edge rows in the next calculation
+ */
+static void _shift_band_bitwise(world *w, unsigned int band, unsigned int bands) {
+    if (w->pool != NULL) {
+        _edges_band(w, band, bands);
+    }
+}
+
+const world_engine_ops CELL_ENGINE = {
+    "cell", "Reference engine, one cell at a time",
+    _calc_next_state_cell, NULL, NULL, NULL, NULL,
+    NULL, NULL, NULL, NULL, NULL, NULL
+};
+
+const world_engine_ops BITWISE_ENGINE = {
+    "bitwise", "Bit-parallel engine, 64 cells at a time (default)",
+    _calc_next_state_bitwise, NULL, _step_n_bitwise, _report_bitwise, NULL,
+    NULL, NULL, NULL, NULL, NULL, _shift_band_bitwise
+};
+
+/*
+ * Jump to the latest generation up to the given one that is a whole
+ * number of periods on, once a cycle is known, without stepping. The
+ * states are the same there, and its statistics are recorded as such.
+ * Returns the generations skipped.
+ */
+uint32_t world_fast_forward(world *w, uint32_t generation) {
+    uint32_t skip;
+
+    if (w->cycle.period == 0 || generation <= w->generation || w->generation < w->cycle.first) {
+        return 0;
+    }
+    skip = (generation - w->generation) / w->cycle.period * w->cycle.period;
+    w->generation += skip;
+
+    // The recorded generations no longer line up, but the cycle is known
+    w->history->count = 0;
+    w->history->candidate = 0;
+    // The states are as they were, so is the population, with no net
+    // change over the periods skipped
+    if (w->stats_valid) {
+        stats_record(w, w->stats.population, 0, 0);
+    } else {
+        world_census(w);
+    }
+    return skip;
+}
+
+/*
+ * Live cells of a world, counted store by store
+ */
+uint64_t world_population(world *w) {
+    uint64_t population = 0;
+
+    for (size_t i = 0; i < w->data_size; ++i) {
+        population += stats_popcount(w->data[i]);
+    }
+    return population;
+}
+
+/*
+ * For engines that keep their own pattern, once they have stepped it
+ * more than a generation (see step_n): make the world the window of it
+ * at generation, and record its statistics
+ */
+void world_take_pattern(world *w, uint32_t generation) {
+    memset(w->data, 0, w->data_size * sizeof(world_store));
+    get_engine(w->engine)->export_region(w, 0, 0, w->xlim, w->ylim, w->data);
+    w->generation = generation;
+    w->state = CALC;
+    world_invalidate(w);
+    w->edited = 0;
+    world_census(w);
+}
@@ -7,9 +7,18 @@
 #include <limits.h>
 #include "base64.h"
 #include "serialization.h"
+#include "rules.h"
 
 #define PROGRAM_NAME "YALS2"
 #define MINSIZE 17
+#define MINSIZE_V2 19
+
+// World file flags, in the header of version 2 files
+#define WORLD_FLAG_TORUS 0x1
+#define WORLD_FLAG_RULE 0x2 // birth and survive follow the flags
+#define WORLD_FLAG_ISOTROPIC 0x4 // then born and kept, 9 counts each
+#define WORLD_FLAG_RANGE 0x8 // then range, middle, birth and survive min, max
+#define WORLD_FLAG_STATES 0x10 // then states, and the dying planes after the data
 
 #define WORLD_STORE_TYPE uint32_t
 #define BITS_PER_CELL 2
@@ -17,13 +26,24 @@
 #define IDX_DIV 4 // log2 CELLS_PER_ELEM
 #define OFFSET_MASK 0xf // (1 << IDX_DIV) - 1
 #define CURR_CELL_MASK 0xaaaaaaaa
+#define NEXT_CELL_MASK 0x55555555
 
 #define BIT_COUNT_LEN 64 // 2^6
 #define NEXT_STATE_MASK 0x1
 #define SINGLE_CELL_MASK 0x3
 #define MULTI_CELL_MASK 0x3f
-#define START_ROW_MASK 0xf
-#define END_ROW_MASK 0x3c
+
+// Worlds have up to this many cells, so that the size in bytes of every
+// buffer of one fits in a size_t
+#define WORLD_MAX_CELLS (SIZE_MAX / CELLS_PER_ELEM)
+
+// Bands start on a row whose first cell begins a world_store
+#define BAND_ALIGN CELLS_PER_ELEM
+#define BAND_MIN_ROWS 64
+
+// Tiles for activity tracking, a tile row never spans two bands
+#define TILE_ROWS BAND_ALIGN
+#define TILE_COLS 64
 
 /*** TYPES ***/
 
@@ -35,6 +55,44 @@ typedef enum world_file_type world_file_type;
 enum world_state { CALC=0, SHIFT=1 };
 typedef enum world_state world_state;
 
+// The built-in engines, others are registered after them (see engine.h)
+enum world_engine { CELLWISE=0, BITWISE=1 };
+typedef enum world_engine world_engine;
+
+// BOUNDED: cells outside the world are dead, TORUS: edges wrap around
+enum world_topology { BOUNDED=0, TORUS=1 };
+typedef enum world_topology world_topology;
+
+/*
+ * How a run ends, as found by cycle detection: from generation first on,
+ * the world repeats every period generations. Extinct worlds have a
+ * period of 1.
+ */
+struct world_cycle {
+    uint32_t period; // 0 until a cycle is confirmed
+    uint32_t first;
+    int extinct;
+};
+typedef struct world_cycle world_cycle;
+
+/*
+ * Statistics of a generation, gathered while stepping to it (see
+ * stats.c). Births and deaths are since the generation recorded before.
+ * The live cells are in columns x0 to x1 and rows y0 to y1, the ends
+ * excluded, an empty box if there are none. Dying cells aren't live.
+ */
+struct world_stats {
+    uint32_t generation;
+    uint64_t population;
+    uint64_t births;
+    uint64_t deaths;
+    uint32_t x0;
+    uint32_t y0;
+    uint32_t x1;
+    uint32_t y1;
+};
+typedef struct world_stats world_stats;
+
 struct world {
     uint32_t xlim;
     uint32_t ylim;
@@ -42,8 +100,50 @@ struct world {
     size_t data_size;
     uint32_t generation;
     world_state state;
+    world_engine engine;
+    void *engine_data; // state of a registered engine
+    int edited; // changed directly since the engine last took it in
+    world_topology topology;
+    life_rule rule;
+    int numa;
     world_store *data;
     world_store *temp_calc;
+    uint8_t *range_cells; // current states a byte each, for range rules
+    world_store *decay; // ages of dying cells, for Generations rules
+    unsigned int decay_planes;
+    uint64_t *board;
+    uint64_t *block; // strips for world_step_n, per band
+    unsigned int block_depth;
+    unsigned int bands;
+    struct pool *pool;
+    int edges_valid;
+
+    // Tiles that changed in the last calculation and the ones to
+    // calculate next, one byte each in row order
+    uint32_t tile_cols;
+    uint32_t tile_rows;
+    uint8_t *tile_changed;
+    uint8_t *tile_active;
+    size_t active_tiles;
+    int tiles_valid;
+
+    // Hash of the current states, updated as stores change, with each
+    // band's share of a step, and the recent hashes cycles are found in
+    // (see cycle.c)
+    uint64_t hash;
+    int hash_valid;
+    uint64_t *band_hash;
+    struct cycle_history *history;
+    world_cycle cycle;
+
+    // Tiles that can have live cells (a superset), each band's share of a step's
+    // births and deaths, and the statistics of the current and recent
+    // generations, valid until the world is changed directly
+    uint8_t *tile_live;
+    struct stats_band *band_stats;
+    world_stats stats;
+    int stats_valid;
+    struct stats_history *stats_history;
 };
 typedef struct world world;
 
@@ -59,11 +159,24 @@ typedef void (*iter_world_func_type) (world_cell_pos *wcp);
 
 /*** FUNCTIONS ***/
 
-world *init_world(uint32_t xlim, uint32_t ylim);
+world *init_world(uint32_t xlim, uint32_t ylim, world_topology topology);
+void set_default_engine(world_engine engine);
+void set_default_threads(unsigned int threads);
+void set_default_numa(int numa);
+void set_default_rule(const life_rule *rule);
+int parse_engine(const char *name, world_engine *engine);
+const char *engine_name(world_engine engine);
 void destroy_world(world *w);
 void print_world(world *w);
+void print_numa_report(world *w);
 void iter_world(world *w, iter_world_func_type itf);
 void invert_cell(world_cell_pos *p);
+int world_get_cell(world *w, int64_t x, int64_t y);
+void world_set_cell(world *w, int64_t x, int64_t y, int alive);
+void world_set_engine(world *w, world_engine engine);
+int world_is_window(world *w);
+void world_invalidate(world *w);
+void world_clear_dying(world *w);
 world *deserialize_world(char *data, size_t len);
 world *deserialize_world_b64(char *enc_data, size_t enc_len);
 char *serialize_world(world *w, size_t *len);
@@ -73,6 +186,11 @@ size_t write_to_file(const char *filename, world *w, world_file_type enc);
 
 void world_half_step(world *w);
 void world_step(world *w);
+void world_step_n(world *w, unsigned int n);
+uint32_t world_fast_forward(world *w, uint32_t generation);
+uint64_t world_population(world *w);
+void world_census(world *w);
+void world_take_pattern(world *w, uint32_t generation);
 
 #endif
 /* vim: set ft=c : */